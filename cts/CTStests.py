@@ -1828,6 +1828,103 @@ class SpecialTest1(CTSTest):
 AllTestClasses.append(SpecialTest1)
 
 
+class CIBJournalCrash(CTSTest):
+    '''Check that a node recovers from a CIB journal checkpoint interrupted
+    between writing cib.xml and starting the new journal'''
+    def __init__(self, cm):
+        CTSTest.__init__(self,cm)
+        self.name = "CIBJournalCrash"
+        self.start = StartTest(cm)
+        self.stop = StopTest(cm)
+        self.cib = CTSvars.CRM_CONFIG_DIR + "/cib.xml"
+        self.journal = self.cib + ".journal"
+        self.old = self.journal + ".old"
+        self.saved = "/tmp/cts-cib-journal"
+
+    def capture(self, node):
+        '''Save a checkpoint and a journal holding one change on top of it'''
+
+        # The first write after start-up is a checkpoint, so wait for that
+        rc = self.rsh(node, "for i in $(seq 1 30); do test -f %s && exit 0; sleep 1; done; exit 1"
+                      % self.journal)
+        if rc != 0:
+            return None
+
+        for attempt in range(3):
+            self.rsh(node, "rm -rf %s; mkdir -p %s; cp -p %s %s.sig %s"
+                     % (self.saved, self.saved, self.cib, self.cib, self.saved))
+            self.rsh(node, "crm_attribute -t crm_config -n cts-journal-test -v %s-%d"
+                     % (self.name, self.Stats["calls"] * 10 + attempt))
+
+            # Wait for the change to be journaled, then keep the journal
+            rc = self.rsh(node, "for i in $(seq 1 30); do test $(wc -l < %s) -gt 1 && exit 0; sleep 1; done; exit 1"
+                          % self.journal)
+            self.rsh(node, "cp -p %s %s/journal" % (self.journal, self.saved))
+
+            # Only usable if no checkpoint happened in the meantime
+            if rc == 0 and self.rsh(node, "head -n 1 %s/journal | grep -q \"$(cat %s/cib.xml.sig)\""
+                                    % (self.saved, self.saved)) == 0:
+                return 1
+        return None
+
+    def start_interrupted(self, node, pattern):
+        '''Start a node with the saved journal left by an interrupted checkpoint'''
+        self.rsh(node, "cp -p %s/journal %s; rm -f %s" % (self.saved, self.old, self.journal))
+
+        watch = self.create_watch([pattern], self.Env["DeadTime"])
+        watch.setwatch()
+        if not self.start(node):
+            return "Could not start " + node
+        watch.lookforall()
+        if watch.unmatched:
+            return "Patterns not found: " + repr(watch.unmatched)
+
+        if self.rsh(node, "ls %s/cib.journal.* >/dev/null 2>&1" % CTSvars.CRM_CONFIG_DIR) == 0:
+            return "CIB journal was preserved as a conflict"
+        return None
+
+    def __call__(self, node):
+        '''Perform the 'CIBJournalCrash' test. '''
+        self.incr("calls")
+
+        if self.CM.ShouldBeStatus[node] != "up" and not self.start(node):
+            return self.failure("Could not start " + node)
+
+        if self.rsh(node, "test -f %s" % self.journal) != 0:
+            # PCMK_cib_journal is not enabled on this node
+            return self.skipped()
+
+        if not self.capture(node):
+            return self.failure("Could not capture a journaled change on " + node)
+
+        # Stopping checkpoints the change into cib.xml
+        if not self.stop(node):
+            return self.failure("Could not stop " + node)
+
+        # Interrupted after writing cib.xml: the old journal is superseded
+        reason = self.start_interrupted(node,
+            r"pacemaker-based.*Removing CIB journal %s left by an interrupted checkpoint" % self.old)
+        if reason:
+            return self.failure(reason)
+
+        if not self.stop(node):
+            return self.failure("Could not stop " + node)
+
+        # Interrupted before writing cib.xml: the old journal is replayed
+        self.rsh(node, "cp -p %s/cib.xml %s/cib.xml.sig %s"
+                 % (self.saved, self.saved, CTSvars.CRM_CONFIG_DIR))
+        reason = self.start_interrupted(node,
+            r"pacemaker-based.*Applied [0-9]+ changes? from CIB journal %s" % self.old)
+        if reason:
+            return self.failure(reason)
+
+        self.rsh(node, "rm -rf %s" % self.saved)
+        self.rsh(node, "crm_attribute -t crm_config -n cts-journal-test -D")
+        return self.success()
+
+AllTestClasses.append(CIBJournalCrash)
+
+
 class HAETest(CTSTest):
     '''Set up a custom test to cause quorum failure issues for Andrew'''
     def __init__(self, cm):
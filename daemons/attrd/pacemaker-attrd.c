@@ -158,6 +158,12 @@ attrd_erase_attrs()
                                           free);
 }
 
+// CIB paths whose changes attrd_cib_updated_cb() cares about
+static const char *attrd_cib_filter[] = {
+    "/" XML_TAG_CIB "/" XML_CIB_TAG_CONFIGURATION "/" XML_CIB_TAG_ALERTS,
+    NULL
+};
+
 static int
 attrd_cib_connect(int max_retry)
 {
@@ -207,6 +213,14 @@ attrd_cib_connect(int max_retry)
         goto cleanup;
     }
 
+    // We only care about changes to alerts, so don't wake for anything else
+    rc = cib__set_diff_notify_filter(the_cib, attrd_cib_filter);
+    if (rc != pcmk_ok) {
+        // Not fatal, the callback checks changes itself anyway
+        crm_debug("Could not filter CIB notifications: %s " CRM_XS " rc=%d",
+                  pcmk_strerror(rc), rc);
+    }
+
     return pcmk_ok;
 
   cleanup:
@@ -114,6 +114,7 @@ cib_ipc_closed(qb_ipcs_connection_t * c)
         return 0;
     }
     crm_trace("Connection %p", c);
+    cib_notify_remove_client(client);
     crm_client_destroy(client);
     return 0;
 }
@@ -195,6 +196,11 @@ cib_common_callback_worker(uint32_t id, uint32_t flags, xmlNode * op_request,
             clear_bit(cib_client->options, bit);
         }
 
+        if (bit == cib_notify_diff) {
+            // A (re-)registration replaces any previous filter
+            cib_notify_set_filter(cib_client, (on_off? op_request : NULL));
+        }
+
         if (flags & crm_ipc_client_response) {
             /* TODO - include rc */
             crm_ipcs_send_ack(cib_client, id, flags, "ack", __FUNCTION__, __LINE__);
@@ -682,7 +688,8 @@ parse_peer_options_v2(int call_type, xmlNode * request,
 
     gboolean is_reply = safe_str_eq(reply_to, cib_our_uname);
 
-    if(safe_str_eq(op, CIB_OP_REPLACE)) {
+    if (safe_str_eq(op, CIB_OP_REPLACE)
+        || safe_str_eq(op, CIB_OP_APPLY_DELTA)) {
         /* sync_our_cib() sets F_CIB_ISREPLY */
         if (reply_to) {
             delegated = reply_to;
@@ -909,6 +916,7 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
     xmlNode *result_diff = NULL;
 
     int rc = pcmk_ok;
+    long long started = 0;
     const char *op = crm_element_value(request, F_CIB_OPERATION);
     const char *originator = crm_element_value(request, F_ORIG);
     const char *host = crm_element_value(request, F_CIB_HOST);
@@ -922,6 +930,8 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
         from_peer = FALSE;
     }
 
+    cib_stats_start();
+
     crm_element_value_int(request, F_CIB_CALLOPTS, &call_options);
     if (force_synchronous) {
         call_options |= cib_sync_call;
@@ -967,6 +977,15 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
 
     is_update = cib_op_modifies(call_type);
 
+    if (!from_peer && process && !needs_forward && local_notify) {
+        started = cib_now_us();
+        if (cib_snapshot_query(cib_client, request, call_options)) {
+            cib_stats_add(cib_phase_reply, started);
+            cib_stats_finish(op, client_name, pcmk_ok, FALSE);
+            return;
+        }
+    }
+
     if (call_options & cib_discard_reply) {
         needs_reply = is_update;
         local_notify = FALSE;
@@ -989,7 +1008,18 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
                    originator ? originator : "local",
                    client_name, call_id);
 
+        if (safe_str_eq(op, CIB_OP_SYNC_ONE)
+            && (get_message_xml(request, F_CIB_CALLDATA) != NULL)) {
+            /* The client wants only the changes we are missing, so tell the
+             * peer where we are now
+             */
+            add_sync_version(request, the_cib);
+        }
+
+        started = cib_now_us();
         forward_request(request, cib_client, call_options);
+        cib_stats_add(cib_phase_broadcast, started);
+        cib_stats_finish(op, client_name, pcmk_ok, TRUE);
         return;
     }
 
@@ -1083,7 +1113,9 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
 
         cib_local_bcast_num++;
         crm_xml_add_int(request, F_CIB_LOCAL_NOTIFY_ID, cib_local_bcast_num);
+        started = cib_now_us();
         broadcast = send_peer_reply(request, result_diff, originator, TRUE);
+        cib_stats_add(cib_phase_broadcast, started);
 
         if (broadcast && client_id && local_notify && op_reply) {
 
@@ -1115,17 +1147,25 @@ cib_process_request(xmlNode *request, gboolean force_synchronous,
             crm_trace("Directing reply to %s", originator);
         }
 
+        started = cib_now_us();
         send_peer_reply(op_reply, result_diff, originator, FALSE);
+        cib_stats_add(cib_phase_broadcast, started);
     }
 
     if (local_notify && client_id) {
         crm_trace("Performing local %ssync notification for %s",
                   (call_options & cib_sync_call) ? "" : "a-", client_id);
+        started = cib_now_us();
         if (process == FALSE) {
             do_local_notify(request, client_id, call_options & cib_sync_call, from_peer);
         } else {
             do_local_notify(op_reply, client_id, call_options & cib_sync_call, from_peer);
         }
+        cib_stats_add(cib_phase_reply, started);
+    }
+
+    if (process) {
+        cib_stats_finish(op, client_name, rc, FALSE);
     }
 
     free_xml(op_reply);
@@ -1151,6 +1191,7 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
 
     int rc = pcmk_ok;
     int rc2 = pcmk_ok;
+    long long started = 0;
 
     gboolean send_r_notify = FALSE;
     gboolean global_update = FALSE;
@@ -1188,9 +1229,11 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         goto done;
 
     } else if (cib_op_modifies(call_type) == FALSE) {
+        started = cib_now_us();
         rc = cib_perform_op(op, call_options, cib_op_func(call_type), TRUE,
                             section, request, input, FALSE, &config_changed,
                             current_cib, &result_cib, NULL, &output);
+        cib_stats_perform(started);
 
         CRM_CHECK(result_cib == NULL, free_xml(result_cib));
         goto done;
@@ -1204,7 +1247,9 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         call_options |= cib_force_diff;
         crm_trace("Global update detected");
 
-        CRM_CHECK(call_type == 3 || call_type == 4, crm_err("Call type: %d", call_type);
+        CRM_CHECK(call_type == 3 || call_type == 4
+                  || safe_str_eq(op, CIB_OP_APPLY_DELTA),
+                  crm_err("Call type: %d", call_type);
                   crm_log_xml_err(request, "bad op"));
     }
 
@@ -1224,9 +1269,12 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         }
 
         /* result_cib must not be modified after cib_perform_op() returns */
+        started = cib_now_us();
         rc = cib_perform_op(op, call_options, cib_op_func(call_type), FALSE,
                             section, request, input, manage_counters, &config_changed,
                             current_cib, &result_cib, cib_diff, &output);
+        cib_stats_perform(started);
+        cib_status_index_update(rc);
 
         if (manage_counters == FALSE) {
             int format = 1;
@@ -1262,10 +1310,22 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
                       crm_element_value(current_cib, XML_ATTR_NUMUPDATES), rc);
         }
 
+        cib_snapshot_invalidate();
+
         if (rc == pcmk_ok && cib_internal_config_changed(*cib_diff)) {
             cib_read_config(config_hash, result_cib);
         }
 
+        /* Remember recent changes for delta syncs, unless the whole CIB was
+         * replaced (its patchset wouldn't chain onto what came before)
+         */
+        if (crm_str_eq(CIB_OP_REPLACE, op, TRUE)
+            && ((section == NULL) || safe_str_eq(section, XML_TAG_CIB))) {
+            cib_history_clear();
+        } else if (rc == pcmk_ok) {
+            cib_history_add(*cib_diff);
+        }
+
         if (crm_str_eq(CIB_OP_REPLACE, op, TRUE)) {
             if (section == NULL) {
                 send_r_notify = TRUE;
@@ -1304,6 +1364,7 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         }
     }
 
+    started = cib_now_us();
     if ((call_options & (cib_inhibit_notify|cib_dryrun)) == 0) {
         const char *client = crm_element_value(request, F_CIB_CLIENTNAME);
 
@@ -1316,6 +1377,7 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
 
         cib_replace_notify(origin, the_cib, rc, *cib_diff);
     }
+    cib_stats_add(cib_phase_notify, started);
 
     xml_log_patchset(LOG_TRACE, "cib:diff", *cib_diff);
   done:
@@ -1521,6 +1583,7 @@ terminate_cib(const char *caller, int fast)
         remote_tls_fd = 0;
     }
 
+    cib_stop_disk_writer();
     uninitializeCib();
 
     if (fast > 0) {
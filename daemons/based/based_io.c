@@ -14,11 +14,15 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
 
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 
 #include <crm/crm.h>
 
@@ -26,6 +30,7 @@
 #include <crm/common/util.h>
 #include <crm/msg_xml.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include <crm/cib/internal.h>
 #include <crm/cluster.h>
 
@@ -203,6 +208,9 @@ readCibXmlFile(const char *dir, const char *file, gboolean discard_status)
 
     cib_status = pcmk_ok;
     root = retrieveCib(filename, sigfile);
+    if (root != NULL) {
+        root = cib_journal_replay(root, dir, file);
+    }
     free(filename);
     free(sigfile);
 
@@ -346,6 +354,8 @@ activateCibXml(xmlNode * new_cib, gboolean to_disk, const char *op)
 
         CRM_ASSERT(new_cib != saved_cib);
         the_cib = new_cib;
+        cib_snapshot_invalidate();
+        cib_status_index_reset();
         free_xml(saved_cib);
         if (cib_writes_enabled && cib_status == pcmk_ok && to_disk) {
             crm_debug("Triggering CIB write for %s op", op);
@@ -363,6 +373,413 @@ activateCibXml(xmlNode * new_cib, gboolean to_disk, const char *op)
     return -ENODATA;
 }
 
+/* Asynchronous disk writes are handed to a long-lived helper process over a
+ * socket pair, rather than forking a child per write. The helper is forked by
+ * cib_start_disk_writer() at start-up, before the daemon has read the CIB or
+ * opened any cluster or IPC connections, so it holds no descriptors other than
+ * its end of the socket pair and the logging targets it needs, and it does not
+ * keep a copy-on-write image of the daemon's memory alive.
+ *
+ * The daemon sends a binary-encoded snapshot of the CIB, without blocking the
+ * main loop if the socket buffer fills up, and the helper writes it out with
+ * cib_journal_write() and replies with the result and how long the write took.
+ * Only one write is in flight at a time; cib_writer is not completed until the
+ * reply arrives, so any number of changes made meanwhile coalesce into a
+ * single write of the newest CIB.
+ *
+ * If the helper is lost, or was never started because writes were disabled at
+ * start-up (and later enabled by signal), writes fall back to a short-lived
+ * child per write, as before the helper existed, rather than forking a new
+ * helper from the fully initialized daemon.
+ *
+ * With PCMK_cib_journal, the helper tells us how many changes it holds only in
+ * the journal, and we ask it to compact them into cib.xml within
+ * CIB_JOURNAL_COMPACT_S, and once more (from the daemon itself) at shutdown.
+ */
+
+// Set in the length prefix to ask for the journal to be compacted
+#define DISK_WRITE_CHECKPOINT   0x80000000U
+
+// Longest time a change may stay only in the journal
+#define CIB_JOURNAL_COMPACT_S   60
+
+typedef struct disk_write_result_s {
+    int32_t rc;
+    uint32_t ms;
+    uint32_t pending;   // journal records not yet compacted into cib.xml
+} disk_write_result_t;
+
+static pid_t disk_writer_pid = 0;
+static int disk_writer_fd = -1;
+static mainloop_io_t *disk_writer_source = NULL;
+static gboolean disk_write_in_flight = FALSE;
+static gboolean disk_writer_stopping = FALSE;
+static gboolean disk_write_checkpoint = FALSE;
+static guint journal_compact_timer = 0;
+
+// Snapshot being sent to the helper (length prefix plus binary CIB)
+static char *disk_write_buf = NULL;
+static size_t disk_write_len = 0;
+static size_t disk_write_sent = 0;
+static guint disk_write_watch = 0;
+
+// Reply being received from the helper
+static disk_write_result_t disk_write_reply;
+static size_t disk_write_reply_len = 0;
+
+static unsigned int disk_writes = 0;
+static unsigned long long disk_write_ms_total = 0;
+static unsigned int disk_write_ms_max = 0;
+
+static gboolean
+disk_writer_io(int fd, void *buffer, size_t len, gboolean reading)
+{
+    char *p = buffer;
+
+    while (len > 0) {
+        ssize_t rc = reading? read(fd, p, len) : send(fd, p, len, MSG_NOSIGNAL);
+
+        if ((rc < 0) && (errno == EINTR)) {
+            continue;
+        } else if (rc <= 0) {
+            return FALSE;
+        }
+        p += rc;
+        len -= rc;
+    }
+    return TRUE;
+}
+
+static unsigned int
+disk_writer_now_ms(void)
+{
+    struct timespec ts = { 0, 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int) ((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+/* Runs in the helper process until the daemon closes its end */
+static void
+disk_writer_main(int fd)
+{
+    uint32_t len = 0;
+
+    signal(SIGTERM, SIG_DFL);
+
+    while (disk_writer_io(fd, &len, sizeof(len), TRUE)) {
+        disk_write_result_t result = { pcmk_err_cib_save, 0, 0 };
+        unsigned int start = disk_writer_now_ms();
+        gboolean checkpoint = ((len & DISK_WRITE_CHECKPOINT) != 0);
+        char *data = NULL;
+        xmlNode *cib_local = NULL;
+
+        len &= ~DISK_WRITE_CHECKPOINT;
+        data = malloc(len);
+
+        if ((data == NULL) || !disk_writer_io(fd, data, len, TRUE)) {
+            free(data);
+            break;
+        }
+
+        cib_local = pcmk__xml_binary_parse(data, len);
+        free(data);
+        if (cib_local != NULL) {
+            result.rc = cib_journal_write(cib_local, cib_root, "cib.xml",
+                                          checkpoint);
+        }
+        result.ms = disk_writer_now_ms() - start;
+        result.pending = cib_journal_pending();
+
+        if (!disk_writer_io(fd, &result, sizeof(result), FALSE)) {
+            break;
+        }
+    }
+
+    /* Use _exit() because exit() could affect the parent adversely */
+    _exit(CRM_EX_OK);
+}
+
+static void
+disk_write_failed(const char *reason)
+{
+    if (cib_writes_enabled) {
+        crm_err("Disabling disk writes after %s", reason);
+        cib_writes_enabled = FALSE;
+    }
+}
+
+static void
+disk_write_done(void)
+{
+    if (disk_write_in_flight) {
+        disk_write_in_flight = FALSE;
+        mainloop_trigger_complete(cib_writer);
+    }
+}
+
+static gboolean
+journal_compact_cb(gpointer data)
+{
+    journal_compact_timer = 0;
+    if (cib_writes_enabled && (cib_status == pcmk_ok)) {
+        crm_debug("Compacting CIB journal into %s/cib.xml", cib_root);
+        disk_write_checkpoint = TRUE;
+        mainloop_set_trigger(cib_writer);
+    }
+    return FALSE;
+}
+
+static void
+disk_write_buf_free(void)
+{
+    if (disk_write_watch != 0) {
+        g_source_remove(disk_write_watch);
+        disk_write_watch = 0;
+    }
+    free(disk_write_buf);
+    disk_write_buf = NULL;
+    disk_write_len = 0;
+    disk_write_sent = 0;
+}
+
+static int
+disk_writer_dispatch(gpointer user_data)
+{
+    while (disk_write_reply_len < sizeof(disk_write_reply)) {
+        ssize_t rc = recv(disk_writer_fd,
+                          ((char *) &disk_write_reply) + disk_write_reply_len,
+                          sizeof(disk_write_reply) - disk_write_reply_len,
+                          MSG_DONTWAIT);
+
+        if (rc > 0) {
+            disk_write_reply_len += rc;
+        } else if ((rc < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((rc < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+    disk_write_reply_len = 0;
+
+    disk_writes++;
+    disk_write_ms_total += disk_write_reply.ms;
+    disk_write_ms_max = QB_MAX(disk_write_ms_max, disk_write_reply.ms);
+    do_crm_log((disk_write_reply.ms >= 1000)? LOG_NOTICE : LOG_DEBUG,
+               "CIB disk write completed in %ums: %s "
+               CRM_XS " rc=%d writes=%u avg=%llums max=%ums",
+               disk_write_reply.ms, pcmk_strerror(disk_write_reply.rc),
+               disk_write_reply.rc, disk_writes,
+               disk_write_ms_total / disk_writes, disk_write_ms_max);
+
+    if (disk_write_reply.rc != pcmk_ok) {
+        disk_write_failed("write failure");
+
+    } else if (disk_write_reply.pending == 0) {
+        if (journal_compact_timer != 0) {
+            g_source_remove(journal_compact_timer);
+            journal_compact_timer = 0;
+        }
+
+    } else if (journal_compact_timer == 0) {
+        journal_compact_timer = g_timeout_add_seconds(CIB_JOURNAL_COMPACT_S,
+                                                      journal_compact_cb, NULL);
+    }
+    disk_write_done();
+    return 0;
+}
+
+static void
+disk_writer_destroy(gpointer user_data)
+{
+    if (disk_writer_stopping) {
+        crm_trace("Connection to disk writer closed");
+    } else {
+        crm_notice("Lost connection to disk writer, "
+                   "falling back to a new process per write");
+    }
+    disk_write_buf_free();
+    close(disk_writer_fd);
+    disk_writer_fd = -1;
+    disk_writer_source = NULL;
+    disk_write_reply_len = 0;
+    if (disk_write_in_flight) {
+        // We don't know whether it completed, so write it again
+        disk_write_done();
+        mainloop_set_trigger(cib_writer);
+    }
+}
+
+static void
+disk_writer_exited(mainloop_child_t * p, pid_t pid, int core, int signo, int exitcode)
+{
+    if (signo) {
+        crm_notice("Disk writer terminated with signal %d (pid=%d, core=%d)",
+                   signo, pid, core);
+    } else {
+        do_crm_log((exitcode == 0)? LOG_DEBUG : LOG_ERR,
+                   "Disk writer exited (pid=%d, rc=%d)", pid, exitcode);
+    }
+    if (pid == disk_writer_pid) {
+        disk_writer_pid = 0;
+        mainloop_del_fd(disk_writer_source);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Start the disk writer helper process
+ *
+ * \note This must be called before the CIB is read and before any cluster or
+ *       IPC connections are opened, so that the helper inherits none of them.
+ */
+void
+cib_start_disk_writer(void)
+{
+    static struct mainloop_fd_callbacks disk_writer_callbacks = {
+        .dispatch = disk_writer_dispatch,
+        .destroy = disk_writer_destroy,
+    };
+
+    int sv[2] = { -1, -1 };
+    int bb_state = qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_STATE_GET, 0);
+
+    CRM_CHECK(disk_writer_source == NULL, return);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        crm_perror(LOG_WARNING,
+                   "Could not create disk writer socket, will use a new process per write");
+        return;
+    }
+
+    /* Turn it off before the fork() to avoid:
+     * - 2 processes writing to the same shared mem
+     * - the child needing to disable it
+     *   (which would close it from underneath the parent)
+     * This way, the shared mem files are already closed
+     */
+    qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_FALSE);
+
+    disk_writer_pid = fork();
+    if (disk_writer_pid == 0) {
+        close(sv[0]);
+        disk_writer_main(sv[1]);
+    }
+
+    if (bb_state == QB_LOG_STATE_ENABLED) {
+        /* Re-enable now that it it safe */
+        qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_TRUE);
+    }
+    close(sv[1]);
+
+    if (disk_writer_pid < 0) {
+        crm_perror(LOG_WARNING,
+                   "Could not fork disk writer, will use a new process per write");
+        disk_writer_pid = 0;
+        close(sv[0]);
+        return;
+    }
+
+    crm_debug("Started disk writer (pid=%d)", disk_writer_pid);
+    mainloop_child_add(disk_writer_pid, 0, "disk-writer", NULL, disk_writer_exited);
+    disk_writer_fd = sv[0];
+    disk_writer_source = mainloop_add_fd("disk-writer", G_PRIORITY_LOW,
+                                         disk_writer_fd, NULL,
+                                         &disk_writer_callbacks);
+}
+
+/*!
+ * \internal
+ * \brief Send as much of the pending CIB snapshot as the socket will take
+ *
+ * \return FALSE if the helper could not be written to, otherwise TRUE
+ */
+static gboolean
+disk_writer_flush(void)
+{
+    while (disk_write_sent < disk_write_len) {
+        ssize_t rc = send(disk_writer_fd, disk_write_buf + disk_write_sent,
+                          disk_write_len - disk_write_sent,
+                          MSG_NOSIGNAL|MSG_DONTWAIT);
+
+        if (rc > 0) {
+            disk_write_sent += rc;
+        } else if ((rc < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((rc < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return TRUE;
+        } else {
+            return FALSE;
+        }
+    }
+    crm_trace("Sent %llu-byte CIB snapshot to disk writer",
+              (unsigned long long) disk_write_len);
+    free(disk_write_buf);
+    disk_write_buf = NULL;
+    disk_write_len = 0;
+    disk_write_sent = 0;
+    return TRUE;
+}
+
+static gboolean
+disk_writer_writable(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    if (disk_writer_flush() == FALSE) {
+        crm_perror(LOG_ERR, "Could not send CIB to disk writer");
+        disk_write_watch = 0;
+        mainloop_del_fd(disk_writer_source);
+        return FALSE;
+    }
+    if (disk_write_buf == NULL) {
+        disk_write_watch = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+send_to_disk_writer(xmlNode *cib)
+{
+    unsigned int len = 0;
+    uint32_t len32 = 0;
+    char *data = pcmk__xml_binary_dump(cib, &len);
+
+    if (data == NULL) {
+        return FALSE;
+    }
+
+    len32 = len;
+    if (disk_write_checkpoint) {
+        len32 |= DISK_WRITE_CHECKPOINT;
+        disk_write_checkpoint = FALSE;
+    }
+    disk_write_len = sizeof(len32) + len;
+    disk_write_sent = 0;
+    disk_write_buf = malloc(disk_write_len);
+    CRM_ASSERT(disk_write_buf != NULL);
+    memcpy(disk_write_buf, &len32, sizeof(len32));
+    memcpy(disk_write_buf + sizeof(len32), data, len);
+    free(data);
+
+    if (disk_writer_flush() == FALSE) {
+        disk_write_buf_free();
+        return FALSE;
+    }
+
+    if (disk_write_buf != NULL) {
+        // Socket buffer is full, send the rest when the helper catches up
+        GIOChannel *channel = g_io_channel_unix_new(disk_writer_fd);
+
+        disk_write_watch = g_io_add_watch_full(channel, G_PRIORITY_LOW,
+                                               G_IO_OUT, disk_writer_writable,
+                                               NULL, NULL);
+        g_io_channel_unref(channel);
+    }
+    return TRUE;
+}
+
 static void
 cib_diskwrite_complete(mainloop_child_t * p, pid_t pid, int core, int signo, int exitcode)
 {
@@ -375,89 +792,132 @@ cib_diskwrite_complete(mainloop_child_t * p, pid_t pid, int core, int signo, int
                    pid, exitcode);
     }
 
-    if (exitcode != 0 && cib_writes_enabled) {
-        crm_err("Disabling disk writes after write failure");
-        cib_writes_enabled = FALSE;
+    if (exitcode != 0) {
+        disk_write_failed("write failure");
     }
 
     mainloop_trigger_complete(cib_writer);
 }
 
-int
-write_cib_contents(gpointer p)
+/*!
+ * \internal
+ * \brief Write the CIB from a short-lived child (if there is no helper)
+ *
+ * \return -1 if the write is in progress, otherwise TRUE
+ */
+static int
+fork_disk_write(void)
 {
-    int exit_rc = pcmk_ok;
-    xmlNode *cib_local = NULL;
-
-    /* Make a copy of the CIB to write (possibly in a forked child) */
-    if (p) {
-        /* Synchronous write out */
-        cib_local = copy_xml(p);
+    int pid = 0;
+    int bb_state = qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_STATE_GET, 0);
+
+    /* Turn it off before the fork() to avoid:
+     * - 2 processes writing to the same shared mem
+     * - the child needing to disable it
+     *   (which would close it from underneath the parent)
+     * This way, the shared mem files are already closed
+     */
+    qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_FALSE);
+
+    pid = fork();
+    if (pid < 0) {
+        crm_perror(LOG_ERR, "Disabling disk writes after fork failure");
+        cib_writes_enabled = FALSE;
+        return TRUE;
+    }
 
-    } else {
-        int pid = 0;
-        int bb_state = qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_STATE_GET, 0);
-
-        /* Turn it off before the fork() to avoid:
-         * - 2 processes writing to the same shared mem
-         * - the child needing to disable it
-         *   (which would close it from underneath the parent)
-         * This way, the shared mem files are already closed
-         */
-        qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_FALSE);
-
-        pid = fork();
-        if (pid < 0) {
-            crm_perror(LOG_ERR, "Disabling disk writes after fork failure");
-            cib_writes_enabled = FALSE;
-            return FALSE;
+    if (pid) {
+        /* Parent */
+        mainloop_child_add(pid, 0, "disk-writer", NULL, cib_diskwrite_complete);
+        if (bb_state == QB_LOG_STATE_ENABLED) {
+            /* Re-enable now that it it safe */
+            qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_TRUE);
         }
+        return -1;          /* -1 means 'still work to do' */
+    }
 
-        if (pid) {
-            /* Parent */
-            mainloop_child_add(pid, 0, "disk-writer", NULL, cib_diskwrite_complete);
-            if (bb_state == QB_LOG_STATE_ENABLED) {
-                /* Re-enable now that it it safe */
-                qb_log_ctl(QB_LOG_BLACKBOX, QB_LOG_CONF_ENABLED, QB_TRUE);
-            }
+    /* In theory, we can scribble on the_cib here and not affect the parent,
+     * but let's be safe anyway. Use _exit() because exit() could affect the
+     * parent adversely.
+     */
+    if (cib_journal_write(copy_xml(the_cib), cib_root, "cib.xml",
+                          TRUE) != pcmk_ok) {
+        _exit(CRM_EX_ERROR);
+    }
+    _exit(CRM_EX_OK);
+}
+
+/*!
+ * \internal
+ * \brief Stop the disk writer, and compact any CIB journal into cib.xml
+ *
+ * \note This is called at shutdown, so that tools reading cib.xml directly
+ *       while the cluster is stopped see the latest configuration, and so
+ *       that such tools' changes are not in conflict with the journal at the
+ *       next start-up.
+ */
+void
+cib_stop_disk_writer(void)
+{
+    int rc = pcmk_ok;
 
-            return -1;          /* -1 means 'still work to do' */
+    if (journal_compact_timer != 0) {
+        g_source_remove(journal_compact_timer);
+        journal_compact_timer = 0;
+    }
+
+    if (disk_writer_source != NULL) {
+        pid_t pid = disk_writer_pid;
+
+        disk_writer_stopping = TRUE;
+        mainloop_del_fd(disk_writer_source);
+
+        // Closing the socket makes it exit once any write in progress is done
+        if (pid > 0) {
+            crm_debug("Waiting for disk writer (pid=%d) to exit", pid);
+            while ((waitpid(pid, NULL, 0) < 0) && (errno == EINTR)) {
+                continue;
+            }
+            disk_writer_pid = 0;
         }
+    }
 
-        /* Asynchronous write-out after a fork() */
+    if (!crm_is_true(daemon_option("cib_journal")) || !cib_writes_enabled
+        || (cib_status != pcmk_ok) || (the_cib == NULL)) {
+        return;
+    }
 
-        /* In theory, we can scribble on the_cib here and not affect the parent,
-         * but let's be safe anyway.
-         */
-        cib_local = copy_xml(the_cib);
+    rc = cib_journal_write(copy_xml(the_cib), cib_root, "cib.xml", TRUE);
+    if (rc == pcmk_ok) {
+        crm_info("Compacted CIB journal into %s/cib.xml", cib_root);
+    } else {
+        crm_err("Could not compact CIB journal into %s/cib.xml: %s "
+                CRM_XS " rc=%d", cib_root, pcmk_strerror(rc), rc);
     }
+}
 
-    /* Write the CIB */
-    exit_rc = cib_file_write_with_digest(cib_local, cib_root, "cib.xml");
+int
+write_cib_contents(gpointer p)
+{
+    int exit_rc = pcmk_ok;
+    xmlNode *cib_local = NULL;
 
-    /* A nonzero exit code will cause further writes to be disabled */
-    free_xml(cib_local);
     if (p == NULL) {
-        crm_exit_t exit_code = CRM_EX_OK;
-
-        switch (exit_rc) {
-            case pcmk_ok:
-                exit_code = CRM_EX_OK;
-                break;
-            case pcmk_err_cib_modified:
-                exit_code = CRM_EX_DIGEST; // Existing CIB doesn't match digest
-                break;
-            case pcmk_err_cib_backup: // Existing CIB couldn't be backed up
-            case pcmk_err_cib_save:   // New CIB couldn't be saved
-                exit_code = CRM_EX_CANTCREAT;
-                break;
-            default:
-                exit_code = CRM_EX_ERROR;
-                break;
+        if (disk_writer_source == NULL) {
+            return fork_disk_write();
         }
-
-        /* Use _exit() because exit() could affect the parent adversely */
-        _exit(exit_code);
+        if (!send_to_disk_writer(the_cib)) {
+            crm_perror(LOG_ERR, "Could not send CIB to disk writer");
+            mainloop_del_fd(disk_writer_source);
+            return fork_disk_write();
+        }
+        disk_write_in_flight = TRUE;
+        return -1;          /* -1 means 'still work to do' */
     }
+
+    /* Synchronous write out */
+    cib_local = copy_xml(p);
+    exit_rc = cib_file_write_with_digest(cib_local, cib_root, "cib.xml");
+    free_xml(cib_local);
     return exit_rc;
 }
@@ -0,0 +1,657 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/cib/internal.h>
+
+#include <pacemaker-based.h>
+
+/*
+ * CIB journal
+ *
+ * When PCMK_cib_journal is enabled, the disk writer does not rewrite cib.xml
+ * for every change. Instead, cib.xml (and its signature) serves as a
+ * checkpoint, and each later write appends the v2 patchset from the previously
+ * written CIB to cib.xml.journal. The journal is compacted into a new
+ * checkpoint once it grows larger than the checkpoint itself, and whenever the
+ * daemon asks for it (periodically, and at shutdown), so that tools reading
+ * cib.xml directly never see a copy that is more than a bounded time old.
+ *
+ * The journal starts with a header line naming the digest of the checkpoint it
+ * belongs to, so that a journal left over from an older checkpoint (or a
+ * cib.xml modified by hand) is never applied:
+ *
+ *    pacemaker-cib-journal 1 <checkpoint digest>\n
+ *
+ * followed by one record per write:
+ *
+ *    <payload length> <payload MD5>\n<patchset XML>\n
+ *
+ * Each patchset carries the digest of its result, so replay also verifies
+ * that the reconstructed CIB is exactly the one that was written. Replay stops
+ * at the first incomplete or corrupted record, which can only be the result
+ * of a write interrupted before it was synced (and thus never reported as
+ * complete).
+ *
+ * A checkpoint first moves the current journal aside as cib.xml.journal.old,
+ * then writes cib.xml, then starts the new journal, and only then removes the
+ * old one. If the checkpoint is interrupted, replay finds the old journal:
+ * if it still belongs to cib.xml, the new cib.xml was never written, and the
+ * old journal is replayed (and kept until the next checkpoint succeeds);
+ * otherwise cib.xml already has everything in it, and it is removed. Either
+ * way, a journal left by an interrupted checkpoint is never mistaken for a
+ * conflict.
+ *
+ * Anything else means the journal and cib.xml disagree: either cib.xml was
+ * rewritten (for example, offline via CIB_file) while the journal still held
+ * changes, or an intact record does not apply. Neither is resolved silently.
+ * The journal is not replayed at all, but is preserved alongside cib.xml for
+ * manual recovery, and an error explains what happened.
+ */
+
+#define CIB_JOURNAL_MAGIC       "pacemaker-cib-journal"
+#define CIB_JOURNAL_VERSION     1
+
+// Don't compact journals smaller than this, however small the CIB
+#define CIB_JOURNAL_MIN_BYTES   (64 * 1024)
+
+// State kept by the disk writer between writes
+static xmlNode *journal_base = NULL;    // CIB as of the last write
+static char *journal_digest = NULL;     // digest of current checkpoint
+static int journal_fd = -1;
+static size_t journal_bytes = 0;
+static size_t checkpoint_bytes = 0;
+static unsigned int journal_records = 0;   // records since checkpoint
+
+static char *
+journal_path(const char *dir, const char *file)
+{
+    return crm_strdup_printf("%s/%s.journal", dir, file);
+}
+
+// Where a journal is kept while a checkpoint replacing it is being written
+static char *
+journal_old_path(const char *dir, const char *file)
+{
+    return crm_strdup_printf("%s/%s.journal.old", dir, file);
+}
+
+static char *
+checkpoint_digest(const char *dir, const char *file)
+{
+    char *sigfile = crm_strdup_printf("%s/%s.sig", dir, file);
+    char *digest = crm_read_contents(sigfile);
+
+    free(sigfile);
+    if (digest != NULL) {
+        g_strstrip(digest);
+    }
+    return digest;
+}
+
+static gboolean
+journal_write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = write(fd, data, len);
+
+        if ((rc < 0) && (errno == EINTR)) {
+            continue;
+        } else if (rc <= 0) {
+            return FALSE;
+        }
+        data += rc;
+        len -= rc;
+    }
+    return TRUE;
+}
+
+static void
+journal_close(void)
+{
+    if (journal_fd >= 0) {
+        close(journal_fd);
+        journal_fd = -1;
+    }
+    free_xml(journal_base);
+    journal_base = NULL;
+    free(journal_digest);
+    journal_digest = NULL;
+}
+
+/*!
+ * \internal
+ * \brief Write a full checkpoint and start a new, empty journal for it
+ *
+ * \param[in] cib   CIB to write (ownership is taken)
+ * \param[in] dir   CIB directory
+ * \param[in] file  CIB file name within \p dir
+ *
+ * \return pcmk_ok on success, pcmk_err_cib_* code otherwise
+ */
+static int
+journal_checkpoint(xmlNode *cib, const char *dir, const char *file)
+{
+    int rc = pcmk_ok;
+    int fd = -1;
+    char *path = journal_path(dir, file);
+    char *old_path = journal_old_path(dir, file);
+    char *tmp = crm_strdup_printf("%s/cib.XXXXXX", dir);
+    char *header = NULL;
+    struct stat st;
+
+    journal_close();
+
+    /* Move the current journal aside first, so that if we are interrupted
+     * before the new journal is in place, replay can tell that it belonged to
+     * the previous checkpoint rather than being in conflict with this one. If
+     * there is no current journal, keep any old one, which may still hold
+     * changes that are not in cib.xml (see cib_journal_replay()).
+     */
+    if (rename(path, old_path) == 0) {
+        crm_sync_directory(dir);
+
+    } else if (errno != ENOENT) {
+        crm_perror(LOG_ERR, "Could not move CIB journal %s aside", path);
+        free_xml(cib);
+        rc = pcmk_err_cib_save;
+        goto done;
+    }
+
+    rc = cib_file_write_with_digest(cib, dir, file);
+    if (rc != pcmk_ok) {
+        free_xml(cib);
+        goto done;
+    }
+
+    journal_digest = checkpoint_digest(dir, file);
+    if (journal_digest == NULL) {
+        crm_perror(LOG_ERR, "Could not read digest of new CIB checkpoint");
+        free_xml(cib);
+        rc = pcmk_err_cib_save;
+        goto done;
+    }
+
+    fd = mkstemp(tmp);
+    if ((fd < 0) || (fchmod(fd, S_IRUSR | S_IWUSR) < 0)) {
+        crm_perror(LOG_ERR, "Could not create temporary file %s for CIB journal",
+                   tmp);
+        free_xml(cib);
+        rc = pcmk_err_cib_save;
+        goto done;
+    }
+
+    header = crm_strdup_printf(CIB_JOURNAL_MAGIC " %d %s\n",
+                               CIB_JOURNAL_VERSION, journal_digest);
+    if (!journal_write_all(fd, header, strlen(header)) || (fsync(fd) < 0)
+        || (rename(tmp, path) < 0)) {
+        crm_perror(LOG_ERR, "Could not start CIB journal %s", path);
+        free_xml(cib);
+        rc = pcmk_err_cib_save;
+        goto done;
+    }
+    if ((unlink(old_path) < 0) && (errno != ENOENT)) {
+        crm_perror(LOG_WARNING, "Could not remove old CIB journal %s",
+                   old_path);
+    }
+    crm_sync_directory(dir);
+
+    // Track changes made relative to this checkpoint from now on
+    journal_base = cib;
+    journal_fd = fd;
+    fd = -1;
+    journal_bytes = strlen(header);
+    journal_records = 0;
+    checkpoint_bytes = 0;
+    {
+        char *cib_path = crm_concat(dir, file, '/');
+
+        if (stat(cib_path, &st) == 0) {
+            checkpoint_bytes = st.st_size;
+        }
+        free(cib_path);
+    }
+    crm_debug("Started CIB journal %s after %llu-byte checkpoint (digest: %s)",
+              path, (unsigned long long) checkpoint_bytes, journal_digest);
+
+  done:
+    if (fd >= 0) {
+        close(fd);
+        unlink(tmp);
+    }
+    if (rc != pcmk_ok) {
+        journal_close();
+    }
+    free(header);
+    free(tmp);
+    free(old_path);
+    free(path);
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Append the changes since the last write to the CIB journal
+ *
+ * \param[in] cib   CIB to write (ownership is taken)
+ *
+ * \return pcmk_ok on success, pcmk_err_cib_save otherwise
+ */
+static int
+journal_append(xmlNode *cib)
+{
+    int rc = pcmk_ok;
+    xmlNode *patchset = NULL;
+    char *payload = NULL;
+    char *digest = NULL;
+    char *record = NULL;
+    size_t len = 0;
+
+    xml_track_changes(cib, NULL, NULL, FALSE);
+    xml_calculate_changes(journal_base, cib);
+    patchset = xml_create_patchset(2, journal_base, cib, NULL, FALSE);
+    if (patchset == NULL) {
+        crm_trace("CIB unchanged since last write");
+        xml_accept_changes(cib);
+        free_xml(journal_base);
+        journal_base = cib;
+        return pcmk_ok;
+    }
+    patchset_process_digest(patchset, journal_base, cib, TRUE);
+    xml_accept_changes(cib);
+
+    payload = dump_xml_unformatted(patchset);
+    free_xml(patchset);
+    digest = crm_md5sum(payload);
+    len = strlen(payload);
+    record = crm_strdup_printf("%llu %s\n%s\n", (unsigned long long) len,
+                               digest, payload);
+
+    if (!journal_write_all(journal_fd, record, strlen(record))
+        || (fsync(journal_fd) < 0)) {
+        crm_perror(LOG_ERR, "Could not append to CIB journal");
+        rc = pcmk_err_cib_save;
+        free_xml(cib);
+        journal_close();
+
+    } else {
+        crm_info("Journaled version %s.%s.0 of the CIB (%llu bytes)",
+                 crm_element_value(cib, XML_ATTR_GENERATION_ADMIN),
+                 crm_element_value(cib, XML_ATTR_GENERATION),
+                 (unsigned long long) len);
+        journal_bytes += strlen(record);
+        journal_records++;
+        free_xml(journal_base);
+        journal_base = cib;
+    }
+
+    free(record);
+    free(digest);
+    free(payload);
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Write the CIB to disk, via the journal if enabled
+ *
+ * \param[in] cib         CIB to write (ownership is taken)
+ * \param[in] dir         CIB directory
+ * \param[in] file        CIB file name within \p dir
+ * \param[in] checkpoint  If TRUE, compact the journal into \p file
+ *
+ * \return As for cib_file_write_with_digest()
+ * \note This is intended to be called only from the disk writer process, or
+ *       from the daemon once the disk writer has exited.
+ */
+int
+cib_journal_write(xmlNode *cib, const char *dir, const char *file,
+                  gboolean checkpoint)
+{
+    int rc = pcmk_ok;
+    char *digest = NULL;
+
+    if (!crm_is_true(daemon_option("cib_journal"))) {
+        char *path = journal_path(dir, file);
+        char *old_path = journal_old_path(dir, file);
+
+        rc = cib_file_write_with_digest(cib, dir, file);
+        free_xml(cib);
+        if ((rc == pcmk_ok) && (unlink(path) == 0)) {
+            crm_info("Removed CIB journal %s since journaling is disabled", path);
+        }
+        if (rc == pcmk_ok) {
+            unlink(old_path);
+        }
+        free(old_path);
+        free(path);
+        return rc;
+    }
+
+    /* Start a new checkpoint if asked, we don't have one, someone else
+     * rewrote cib.xml since, or the journal has grown too large to replay
+     * quickly
+     */
+    if (journal_base != NULL) {
+        digest = checkpoint_digest(dir, file);
+    }
+    if (checkpoint || (journal_base == NULL)
+        || safe_str_neq(digest, journal_digest)
+        || (journal_bytes > QB_MAX(checkpoint_bytes, CIB_JOURNAL_MIN_BYTES))) {
+
+        crm_debug("Compacting CIB journal (%llu bytes, checkpoint %llu bytes)",
+                  (unsigned long long) journal_bytes,
+                  (unsigned long long) checkpoint_bytes);
+        rc = journal_checkpoint(cib, dir, file);
+
+    } else {
+        cib_file_prepare_xml(cib);
+        rc = journal_append(cib);
+    }
+    free(digest);
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Get the number of journal records not yet compacted into cib.xml
+ *
+ * \return Number of records appended since the last checkpoint
+ */
+unsigned int
+cib_journal_pending(void)
+{
+    return journal_records;
+}
+
+/*!
+ * \internal
+ * \brief Move a journal that cannot be replayed out of the way
+ *
+ * \param[in] path  Journal path
+ * \param[in] dir   CIB directory
+ *
+ * \return Newly allocated path the journal was preserved as (or NULL)
+ */
+static char *
+journal_preserve(const char *path, const char *dir)
+{
+    char *saved = crm_strdup_printf("%s/cib.journal.XXXXXX", dir);
+    int fd = mkstemp(saved);
+
+    if ((fd < 0) || (rename(path, saved) < 0)) {
+        crm_perror(LOG_ERR, "Could not preserve CIB journal %s as %s",
+                   path, saved);
+        if (fd >= 0) {
+            unlink(saved);
+        }
+        free(saved);
+        saved = NULL;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return saved;
+}
+
+/*!
+ * \internal
+ * \brief Apply records from a CIB journal
+ *
+ * \param[in,out] root     CIB to apply records to (or NULL to only count
+ *                         intact records)
+ * \param[in,out] records  Journal contents following the header (records are
+ *                         modified during processing but restored afterward)
+ * \param[in]     path     Journal path (for logging)
+ * \param[out]    failed   Set to TRUE if an intact record could not be applied
+ * \param[out]    target   If not NULL, set to the CIB version (admin_epoch,
+ *                         epoch, num_updates) that the last record produced
+ *
+ * \return Number of records applied (or counted)
+ * \note Processing stops at the first incomplete or corrupted record, which
+ *       can only be left by a write that was never reported as complete.
+ */
+static int
+journal_apply_records(xmlNode *root, char *records, const char *path,
+                      gboolean *failed, int target[3])
+{
+    int applied = 0;
+    char *pos = records;
+    char *end = records + strlen(records);
+
+    while (pos < end) {
+        unsigned long long len = 0;
+        char md5[33] = { '\0', };
+        char *payload = strchr(pos, '\n');
+        char *record_digest = NULL;
+        xmlNode *patchset = NULL;
+        int rc = pcmk_ok;
+
+        if ((payload == NULL)
+            || (sscanf(pos, "%llu %32s", &len, md5) != 2)
+            || (len >= (unsigned long long) (end - payload - 1))
+            || (payload[len + 1] != '\n')) {
+            crm_warn("Ignoring incomplete record at end of CIB journal %s",
+                     path);
+            break;
+        }
+        payload++;
+        pos = payload + len + 1;
+
+        payload[len] = '\0';
+        record_digest = crm_md5sum(payload);
+        if (safe_str_eq(record_digest, md5)) {
+            patchset = string2xml(payload);
+        }
+        payload[len] = '\n';
+        free(record_digest);
+
+        if (patchset == NULL) {
+            crm_warn("Ignoring corrupted record in CIB journal %s and any after it",
+                     path);
+            break;
+        }
+
+        if (root != NULL) {
+            rc = xml_apply_patchset(root, patchset, FALSE);
+        }
+        if (target != NULL) {
+            int del[3] = { 0, 0, 0 };
+
+            xml_patch_versions(patchset, target, del);
+        }
+        free_xml(patchset);
+        if (rc != pcmk_ok) {
+            crm_err("Could not apply intact record %d of CIB journal %s: %s",
+                    applied + 1, path, pcmk_strerror(rc));
+            *failed = TRUE;
+            break;
+        }
+        applied++;
+    }
+    return applied;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a CIB is at least at the version a journal leads to
+ *
+ * \param[in] root    CIB read from the checkpoint
+ * \param[in] target  Version (admin_epoch, epoch, num_updates) produced by the
+ *                    last intact record of a journal
+ *
+ * \return TRUE if \p root's configuration is no older than \p target
+ */
+static gboolean
+journal_superseded(xmlNode *root, const int target[3])
+{
+    int admin_epoch = 0;
+    int epoch = 0;
+
+    crm_element_value_int(root, XML_ATTR_GENERATION_ADMIN, &admin_epoch);
+    crm_element_value_int(root, XML_ATTR_GENERATION, &epoch);
+    if (admin_epoch != target[0]) {
+        return admin_epoch > target[0];
+    }
+    return epoch >= target[1];
+}
+
+/*!
+ * \internal
+ * \brief Apply the changes from one CIB journal file to a checkpoint
+ *
+ * \param[in] root         CIB read from \p file (ownership is taken)
+ * \param[in] path         Journal path
+ * \param[in] digest       Digest of \p file (or NULL if unknown)
+ * \param[in] dir          CIB directory
+ * \param[in] file         CIB file name within \p dir
+ * \param[in] interrupted  If TRUE, \p path is a journal that a checkpoint
+ *                         moved aside and did not get to remove
+ *
+ * \return CIB with journaled changes applied
+ */
+static xmlNode *
+journal_replay_file(xmlNode *root, const char *path, const char *digest,
+                    const char *dir, const char *file, gboolean interrupted)
+{
+    char *contents = crm_read_contents(path);
+    char *header = NULL;
+    char *records = NULL;
+    char *saved = NULL;
+    xmlNode *checkpoint = NULL;
+    gboolean failed = FALSE;
+    int applied = 0;
+
+    if (contents == NULL) {
+        crm_trace("No CIB journal at %s", path);
+        goto done;
+    }
+
+    records = strchr(contents, '\n');
+    if (!crm_starts_with(contents, CIB_JOURNAL_MAGIC " ") || (records == NULL)) {
+        crm_warn("Ignoring %s: not a CIB journal", path);
+        goto done;
+    }
+    records++;
+
+    header = crm_strdup_printf(CIB_JOURNAL_MAGIC " %d %s\n",
+                               CIB_JOURNAL_VERSION, crm_str(digest));
+    if ((digest == NULL) || !crm_starts_with(contents, header)) {
+        int target[3] = { 0, 0, 0 };
+        int pending = journal_apply_records(NULL, records, path, &failed,
+                                            target);
+
+        if (pending == 0) {
+            crm_info("Removing empty CIB journal %s left from an earlier "
+                     "version of %s/%s", path, dir, file);
+            unlink(path);
+            goto done;
+        }
+
+        if (interrupted && journal_superseded(root, target)) {
+            /* The checkpoint replacing this journal was written, but we were
+             * stopped before the journal could be removed
+             */
+            crm_notice("Removing CIB journal %s left by an interrupted "
+                       "checkpoint, since %s/%s already includes its %d "
+                       "change%s", path, dir, file, pending,
+                       ((pending == 1)? "" : "s"));
+            unlink(path);
+            goto done;
+        }
+
+        /* cib.xml was rewritten by someone other than the disk writer while
+         * the journal still held changes. Neither copy can be trusted to
+         * include the other's changes, so use cib.xml as it is, but don't
+         * throw the journal away.
+         */
+        saved = journal_preserve(path, dir);
+        crm_err("Not replaying %d change%s from CIB journal %s because "
+                "%s/%s was modified after the journal was started "
+                "(for example, by a tool using CIB_file while the cluster was "
+                "stopped). Using %s/%s as it is; the journal has been "
+                "preserved as %s for manual recovery.",
+                pending, ((pending == 1)? "" : "s"), path, dir, file,
+                dir, file, crm_str(saved));
+        goto done;
+    }
+
+    /* Patchsets are not applied atomically, so keep a copy to fall back to.
+     * An interrupted checkpoint's journal that still matches cib.xml is left
+     * in place; the next checkpoint will include its changes and remove it.
+     */
+    checkpoint = copy_xml(root);
+    applied = journal_apply_records(root, records, path, &failed, NULL);
+    if (failed) {
+        free_xml(root);
+        root = checkpoint;
+        checkpoint = NULL;
+
+        saved = journal_preserve(path, dir);
+        crm_err("Not replaying CIB journal %s because an intact record in it "
+                "does not apply to %s/%s. Using %s/%s as it is; the journal "
+                "has been preserved as %s for manual recovery.",
+                path, dir, file, dir, file, crm_str(saved));
+
+    } else if (applied > 0) {
+        crm_notice("Applied %d change%s from CIB journal %s (now at %s.%s)",
+                   applied, ((applied == 1)? "" : "s"), path,
+                   crm_element_value(root, XML_ATTR_GENERATION_ADMIN),
+                   crm_element_value(root, XML_ATTR_GENERATION));
+    }
+
+  done:
+    free_xml(checkpoint);
+    free(saved);
+    free(header);
+    free(contents);
+    return root;
+}
+
+/*!
+ * \internal
+ * \brief Apply any journaled changes to a CIB read from its checkpoint
+ *
+ * \param[in] root  CIB read from \p file (ownership is taken)
+ * \param[in] dir   CIB directory
+ * \param[in] file  CIB file name within \p dir
+ *
+ * \return CIB with journaled changes applied
+ */
+xmlNode *
+cib_journal_replay(xmlNode *root, const char *dir, const char *file)
+{
+    char *digest = checkpoint_digest(dir, file);
+    char *path = journal_old_path(dir, file);
+
+    // A journal left by an interrupted checkpoint comes before any current one
+    root = journal_replay_file(root, path, digest, dir, file, TRUE);
+    free(path);
+
+    path = journal_path(dir, file);
+    root = journal_replay_file(root, path, digest, dir, file, FALSE);
+    free(path);
+
+    free(digest);
+    return root;
+}
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <time.h>
@@ -30,6 +31,9 @@
 /* Maximum number of diffs to ignore while waiting for a resync */
 #define MAX_DIFF_RETRY 5
 
+/* Maximum number of recent patchsets kept for bringing peers up to date */
+#define CIB_HISTORY_MAX 500
+
 gboolean cib_is_master = FALSE;
 
 xmlNode *the_cib = NULL;
@@ -132,22 +136,235 @@ cib_process_readwrite(const char *op, int options, const char *section, xmlNode
  */
 static int sync_in_progress = 0;
 
+/* Recent v2 patchsets (oldest first), so that a peer that is only a little
+ * behind can be sent the changes it missed instead of the whole CIB
+ */
+static GQueue *cib_history = NULL;
+
 void
-send_sync_request(const char *host)
+cib_history_clear(void)
+{
+    if (cib_history != NULL) {
+        while (!g_queue_is_empty(cib_history)) {
+            free_xml(g_queue_pop_head(cib_history));
+        }
+    }
+}
+
+void
+cib_history_add(xmlNode *patchset)
+{
+    int format = 1;
+
+    if (patchset == NULL) {
+        return;
+    }
+
+    crm_element_value_int(patchset, "format", &format);
+    if (format != 2) {
+        // Only v2 patchsets can be chained by version
+        cib_history_clear();
+        return;
+    }
+
+    if (cib_history == NULL) {
+        cib_history = g_queue_new();
+    }
+    g_queue_push_tail(cib_history, copy_xml(patchset));
+    while (g_queue_get_length(cib_history) > CIB_HISTORY_MAX) {
+        free_xml(g_queue_pop_head(cib_history));
+    }
+}
+
+static int
+compare_cib_versions(const int a[3], const int b[3])
+{
+    int lpc = 0;
+
+    for (lpc = 0; lpc < 3; lpc++) {
+        if (a[lpc] != b[lpc]) {
+            return (a[lpc] < b[lpc])? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static gboolean
+sync_request_version(xmlNode *msg, int version[3])
+{
+    return (crm_element_value_int(msg, XML_ATTR_GENERATION_ADMIN, &version[0]) == 0)
+           && (crm_element_value_int(msg, XML_ATTR_GENERATION, &version[1]) == 0)
+           && (crm_element_value_int(msg, XML_ATTR_NUMUPDATES, &version[2]) == 0);
+}
+
+void
+add_sync_version(xmlNode *msg, xmlNode *cib)
+{
+    int version[3] = { 0, 0, 0 };
+
+    cib_version_details(cib, &version[0], &version[1], &version[2]);
+    crm_xml_add_int(msg, XML_ATTR_GENERATION_ADMIN, version[0]);
+    crm_xml_add_int(msg, XML_ATTR_GENERATION, version[1]);
+    crm_xml_add_int(msg, XML_ATTR_NUMUPDATES, version[2]);
+}
+
+/*!
+ * \internal
+ * \brief Collect the patchsets leading from a given version to the current CIB
+ *
+ * \param[in] from  CIB version (admin_epoch, epoch, num_updates) to start from
+ *
+ * \return Newly allocated element containing the patchsets in order (none if
+ *         \p from is the current version), or NULL if the history does not
+ *         cover every change since \p from
+ */
+static xmlNode *
+cib_history_since(const int from[3])
+{
+    int current[3] = { 0, 0, 0 };
+    int last[3] = { 0, 0, 0 };
+    xmlNode *delta = NULL;
+    GList *iter = NULL;
+
+    /* A peer that is already at our version needs nothing but the digest
+     * check, which catches a CIB that has the same version but not the same
+     * contents
+     */
+    cib_version_details(the_cib, &current[0], &current[1], &current[2]);
+    if (compare_cib_versions(from, current) == 0) {
+        return create_xml_node(NULL, "cib_delta");
+    }
+
+    if (cib_history == NULL) {
+        return NULL;
+    }
+
+    for (iter = cib_history->head; iter != NULL; iter = iter->next) {
+        xmlNode *patchset = iter->data;
+        int add[3] = { 0, 0, 0 };
+        int del[3] = { 0, 0, 0 };
+
+        xml_patch_versions(patchset, add, del);
+        if (delta == NULL) {
+            if (compare_cib_versions(del, from) != 0) {
+                continue;
+            }
+            delta = create_xml_node(NULL, "cib_delta");
+
+        } else if (compare_cib_versions(del, last) != 0) {
+            crm_debug("CIB history has a gap at %d.%d.%d", last[0], last[1],
+                      last[2]);
+            free_xml(delta);
+            return NULL;
+        }
+        add_node_copy(delta, patchset);
+        memcpy(last, add, sizeof(last));
+    }
+
+    if ((delta != NULL) && (compare_cib_versions(last, current) != 0)) {
+        free_xml(delta);
+        delta = NULL;
+    }
+    return delta;
+}
+
+static void
+request_sync(const char *host, gboolean delta)
 {
     xmlNode *sync_me = create_xml_node(NULL, "sync-me");
 
-    crm_info("Requesting re-sync from %s", (host? host : "all peers"));
+    crm_info("Requesting %sre-sync from %s", (delta? "" : "full "),
+             (host? host : "all peers"));
     sync_in_progress = 1;
 
     crm_xml_add(sync_me, F_TYPE, "cib");
     crm_xml_add(sync_me, F_CIB_OPERATION, CIB_OP_SYNC_ONE);
     crm_xml_add(sync_me, F_CIB_DELEGATED, cib_our_uname);
 
+    /* Tell the peer where we are, so it can send just what we're missing if
+     * it can (peers that don't support that will ignore this)
+     */
+    if (delta && (the_cib != NULL)) {
+        add_sync_version(sync_me, the_cib);
+    }
+
     send_cluster_message(host ? crm_get_peer(0, host) : NULL, crm_msg_cib, sync_me, FALSE);
     free_xml(sync_me);
 }
 
+void
+send_sync_request(const char *host)
+{
+    request_sync(host, TRUE);
+}
+
+/*!
+ * \internal
+ * \brief Bring the CIB up to date using patchsets sent by a peer
+ *
+ * The patchsets must apply in order with version checks, and the result must
+ * match the digest the peer sent. Otherwise, a full sync is requested.
+ */
+int
+cib_process_apply_delta(const char *op, int options, const char *section,
+                        xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                        xmlNode **result_cib, xmlNode **answer)
+{
+    int rc = pcmk_ok;
+    int applied = 0;
+    xmlNode *patchset = NULL;
+    const char *host = crm_element_value(req, F_ORIG);
+    const char *digest = crm_element_value(req, XML_ATTR_DIGEST);
+    const char *version = crm_element_value(req, XML_ATTR_CRM_VERSION);
+
+    *answer = NULL;
+    if (input == NULL) {
+        return -EINVAL;
+    }
+
+    for (patchset = first_named_child(input, XML_TAG_DIFF);
+         (patchset != NULL) && (rc == pcmk_ok);
+         patchset = crm_next_same_xml(patchset)) {
+
+        rc = xml_apply_patchset(*result_cib, patchset, TRUE);
+        if (rc == pcmk_ok) {
+            applied++;
+        }
+    }
+
+    if ((rc == pcmk_ok) && (digest != NULL)) {
+        char *new_digest = calculate_xml_versioned_digest(*result_cib, FALSE,
+                                                          TRUE, version);
+
+        if (safe_str_neq(new_digest, digest)) {
+            crm_warn("Digest mismatch after applying CIB delta from %s",
+                     crm_str(host));
+            rc = -pcmk_err_diff_failed;
+        }
+        free(new_digest);
+    }
+
+    if (rc == pcmk_ok) {
+        crm_info("Applied %d change%s from %s to bring CIB up to date",
+                 applied, ((applied == 1)? "" : "s"), crm_str(host));
+        sync_in_progress = 0;
+
+    } else {
+        crm_notice("Could not apply CIB delta from %s: %s",
+                   crm_str(host), pcmk_strerror(rc));
+        free_xml(*result_cib);
+        *result_cib = NULL;
+
+        /* If a local client asked for this sync, it gets the error and
+         * decides whether to fall back to a full sync; otherwise, do that here
+         */
+        if (crm_element_value(req, F_CIB_CLIENTID) == NULL) {
+            request_sync(host, FALSE);
+        }
+    }
+    return rc;
+}
+
 int
 cib_process_ping(const char *op, int options, const char *section, xmlNode * req, xmlNode * input,
                  xmlNode * existing_cib, xmlNode ** result_cib, xmlNode ** answer)
@@ -487,15 +704,32 @@ sync_our_cib(xmlNode * request, gboolean all)
 {
     int result = pcmk_ok;
     char *digest = NULL;
+    int peer_version[3] = { 0, 0, 0 };
     const char *host = crm_element_value(request, F_ORIG);
     const char *op = crm_element_value(request, F_CIB_OPERATION);
 
-    xmlNode *replace_request = cib_msg_copy(request, FALSE);
+    xmlNode *delta = NULL;
+    xmlNode *replace_request = NULL;
 
     CRM_CHECK(the_cib != NULL,;);
+
+    /* Only a targeted sync (a peer, or a client such as the controller
+     * during a join, asking for it) may send just the recent changes. A
+     * broadcast sync must carry the whole CIB, so that by the time it is
+     * complete (and CPG delivers it in order with everything else), every peer
+     * has exactly our CIB.
+     */
+    if (!all && (host != NULL) && sync_request_version(request, peer_version)) {
+        if (!cib_legacy_mode()) {
+            delta = cib_history_since(peer_version);
+        }
+    }
+
+    replace_request = cib_msg_copy(request, FALSE);
     CRM_CHECK(replace_request != NULL,;);
 
-    crm_debug("Syncing CIB to %s", all ? "all peers" : host);
+    crm_debug("Syncing CIB to %s%s", all ? "all peers" : host,
+              (delta? " using recent changes" : ""));
     if (all == FALSE && host == NULL) {
         crm_log_xml_err(request, "bad sync");
     }
@@ -510,11 +744,14 @@ sync_our_cib(xmlNode * request, gboolean all)
     if (host != NULL) {
         crm_xml_add(replace_request, F_CIB_ISREPLY, host);
     }
-    if (all) {
-        xml_remove_prop(replace_request, F_CIB_HOST);
-    }
 
-    crm_xml_add(replace_request, F_CIB_OPERATION, CIB_OP_REPLACE);
+    /* A client request forwarded to us is addressed to us, but the result
+     * must be processed by the requester (or everyone)
+     */
+    xml_remove_prop(replace_request, F_CIB_HOST);
+
+    crm_xml_add(replace_request, F_CIB_OPERATION,
+                (delta? CIB_OP_APPLY_DELTA : CIB_OP_REPLACE));
     crm_xml_add(replace_request, "original_" F_CIB_OPERATION, op);
     crm_xml_add(replace_request, F_CIB_GLOBAL_UPDATE, XML_BOOLEAN_TRUE);
 
@@ -522,7 +759,12 @@ sync_our_cib(xmlNode * request, gboolean all)
     digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, CRM_FEATURE_SET);
     crm_xml_add(replace_request, XML_ATTR_DIGEST, digest);
 
-    add_message_xml(replace_request, F_CIB_CALLDATA, the_cib);
+    if (delta != NULL) {
+        add_message_xml(replace_request, F_CIB_CALLDATA, delta);
+        free_xml(delta);
+    } else {
+        add_message_xml(replace_request, F_CIB_CALLDATA, the_cib);
+    }
 
     if (send_cluster_message
         (all ? NULL : crm_get_peer(0, host), crm_msg_cib, replace_request, FALSE) == FALSE) {
@@ -23,22 +23,198 @@
 #include <crm/msg_xml.h>
 
 #include <crm/common/xml.h>
+#include <crm/common/ipc_internal.h>
 #include <crm/common/remote_internal.h>
 #include <pacemaker-based.h>
 
 int pending_updates = 0;
 
+#define CIB_NOTIFY_CODECS (pcmk__codec_zstd + 1)
+
 struct cib_notification_s {
     xmlNode *msg;
-    struct iovec *iov;
-    int32_t iov_size;
+    xmlNode *diff;  // patchset, for diff notifications
+
+    /* The message is prepared for IPC on demand, at most once for each XML
+     * encoding (text or binary) and compression codec that clients accept,
+     * and the result is shared by the event queues of all such clients
+     */
+    pcmk__ipc_shared_t *shared[2][CIB_NOTIFY_CODECS];
 };
 
+/* Path prefixes that clients want diff notifications for (client ID -> GList
+ * of paths); clients with no entry get all diff notifications
+ */
+static GHashTable *diff_filters = NULL;
+
 void attach_cib_generation(xmlNode * msg, const char *field, xmlNode * a_cib);
 
 void do_cib_notify(int options, const char *op, xmlNode * update,
                    int result, xmlNode * result_data, const char *msg_type);
 
+static void
+free_paths(gpointer data)
+{
+    g_list_free_full((GList *) data, free);
+}
+
+/*!
+ * \internal
+ * \brief Set (or clear) the diff notification filter for a client
+ *
+ * \param[in] client   Client that sent the request
+ * \param[in] request  T_CIB_NOTIFY request enabling diff notifications (which
+ *                     may list F_CIB_NOTIFY_FILTER paths), or NULL to clear
+ */
+void
+cib_notify_set_filter(crm_client_t *client, xmlNode *request)
+{
+    GList *paths = NULL;
+    xmlNode *filter = NULL;
+
+    CRM_CHECK((client != NULL) && (client->id != NULL), return);
+
+    if (request != NULL) {
+        for (filter = __xml_first_child_element(request); filter != NULL;
+             filter = __xml_next_element(filter)) {
+
+            const char *path = crm_element_value(filter, XML_DIFF_PATH);
+
+            if (crm_str_eq(crm_element_name(filter), F_CIB_NOTIFY_FILTER, TRUE)
+                && (path != NULL)) {
+                paths = g_list_prepend(paths, strdup(path));
+            }
+        }
+    }
+
+    if (paths == NULL) {
+        if (diff_filters != NULL) {
+            g_hash_table_remove(diff_filters, client->id);
+        }
+        return;
+    }
+
+    if (diff_filters == NULL) {
+        diff_filters = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                             free_paths);
+    }
+    crm_debug("Client %s (%s) wants changes under %u path%s only",
+              client->name, client->id, g_list_length(paths),
+              ((g_list_length(paths) == 1)? "" : "s"));
+    g_hash_table_replace(diff_filters, strdup(client->id), paths);
+}
+
+/*!
+ * \internal
+ * \brief Forget a client's notification filter
+ *
+ * \param[in] client  Client being disconnected
+ */
+void
+cib_notify_remove_client(crm_client_t *client)
+{
+    if ((diff_filters != NULL) && (client != NULL) && (client->id != NULL)) {
+        g_hash_table_remove(diff_filters, client->id);
+    }
+}
+
+// Whether path is ancestor or the same element as, or within, it
+static bool
+path_within(const char *path, const char *ancestor)
+{
+    size_t len = strlen(ancestor);
+
+    return (strncmp(path, ancestor, len) == 0)
+           && ((path[len] == '\0') || (path[len] == '/') || (path[len] == '['));
+}
+
+// Whether a v2 patchset change might affect anything under a path
+static bool
+change_affects_path(xmlNode *change, const char *prefix)
+{
+    const char *op = crm_element_value(change, XML_DIFF_OP);
+    const char *path = crm_element_value(change, XML_DIFF_PATH);
+
+    if ((op == NULL) || (path == NULL)) {
+        return TRUE; // Be conservative
+    }
+
+    if (strcmp(op, "create") == 0) {
+        // The path is the parent of the created element
+        xmlNode *created = __xml_first_child_element(change);
+        const char *id = NULL;
+        char *created_path = NULL;
+        bool affected = FALSE;
+
+        if (created == NULL) {
+            return TRUE;
+        }
+        id = ID(created);
+        if (id == NULL) {
+            created_path = crm_strdup_printf("%s/%s", path,
+                                             crm_element_name(created));
+        } else {
+            created_path = crm_strdup_printf("%s/%s[@id='%s']", path,
+                                             crm_element_name(created), id);
+        }
+        affected = path_within(created_path, prefix)
+                   || path_within(prefix, created_path);
+        free(created_path);
+        return affected;
+
+    } else if (strcmp(op, "delete") == 0) {
+        return path_within(path, prefix) || path_within(prefix, path);
+    }
+
+    // Modifications and moves affect only the element itself
+    return path_within(path, prefix);
+}
+
+/*!
+ * \internal
+ * \brief Check whether a client's filter allows a diff notification
+ *
+ * \param[in] client  Client subscribed to diff notifications
+ * \param[in] diff    Patchset being notified
+ *
+ * \return TRUE if the client should be sent the notification, else FALSE
+ */
+static gboolean
+cib_notify_diff_wanted(crm_client_t *client, xmlNode *diff)
+{
+    int format = 1;
+    GList *paths = NULL;
+    xmlNode *change = NULL;
+
+    if ((diff == NULL) || (diff_filters == NULL) || (client->id == NULL)
+        || ((paths = g_hash_table_lookup(diff_filters, client->id)) == NULL)) {
+        return TRUE;
+    }
+
+    // Legacy patchsets are rare enough that it's not worth filtering them
+    crm_element_value_int(diff, "format", &format);
+    if (format != 2) {
+        return TRUE;
+    }
+
+    for (change = __xml_first_child_element(diff); change != NULL;
+         change = __xml_next_element(change)) {
+
+        if (crm_str_eq(crm_element_name(change), XML_DIFF_CHANGE, TRUE)) {
+            GList *iter = NULL;
+
+            for (iter = paths; iter != NULL; iter = iter->next) {
+                if (change_affects_path(change, (const char *) iter->data)) {
+                    return TRUE;
+                }
+            }
+        }
+    }
+    crm_trace("Filtered diff notification for client %s (%s)",
+              client->name, client->id);
+    return FALSE;
+}
+
 static gboolean
 cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
 {
@@ -60,7 +236,7 @@ cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
 
     CRM_LOG_ASSERT(type != NULL);
     if (is_set(client->options, cib_notify_diff) && safe_str_eq(type, T_CIB_DIFF_NOTIFY)) {
-        do_send = TRUE;
+        do_send = cib_notify_diff_wanted(client, update->diff);
 
     } else if (is_set(client->options, cib_notify_replace)
                && safe_str_eq(type, T_CIB_REPLACE_NOTIFY)) {
@@ -80,8 +256,29 @@ cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
     if (do_send) {
         switch (client->kind) {
             case CRM_CLIENT_IPC:
-                if (crm_ipcs_sendv(client, update->iov, crm_ipc_server_event) < 0) {
-                    crm_warn("Notification of client %s/%s failed", client->name, client->id);
+                {
+                    bool binary = is_set(client->flags, crm_client_flag_ipc_binary);
+                    enum pcmk__codec codec = pcmk__best_codec(client->codecs);
+                    pcmk__ipc_shared_t **shared = &(update->shared[binary][codec]);
+
+                    if (*shared == NULL) {
+                        struct iovec *iov = NULL;
+                        ssize_t rc = pcmk__ipc_prepare_iov(0, update->msg, 0,
+                                                           binary, codec, &iov);
+
+                        if (rc < 0) {
+                            crm_notice("Could not notify client %s/%s: %s "
+                                       CRM_XS " rc=%lld",
+                                       client->name, client->id,
+                                       pcmk_strerror(rc), (long long) rc);
+                            break;
+                        }
+                        *shared = pcmk__ipc_shared_new(iov);
+                    }
+                    if (pcmk__ipcs_send_shared(client, *shared,
+                                               crm_ipc_server_event) < 0) {
+                        crm_warn("Notification of client %s/%s failed", client->name, client->id);
+                    }
                 }
                 break;
 #ifdef HAVE_GNUTLS_GNUTLS_H
@@ -101,23 +298,22 @@ cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
 static void
 cib_notify_send(xmlNode * xml)
 {
-    struct iovec *iov;
     struct cib_notification_s update;
-
-    ssize_t rc = crm_ipc_prepare(0, xml, &iov, 0);
+    int binary, codec;
 
     crm_trace("Notifying clients");
-    if (rc > 0) {
-        update.msg = xml;
-        update.iov = iov;
-        update.iov_size = rc;
-        g_hash_table_foreach_remove(client_connections, cib_notify_send_one, &update);
+    memset(&update, 0, sizeof(update));
+    update.msg = xml;
+    if (safe_str_eq(crm_element_value(xml, F_SUBTYPE), T_CIB_DIFF_NOTIFY)) {
+        update.diff = get_message_xml(xml, F_CIB_UPDATE_RESULT);
+    }
+    g_hash_table_foreach_remove(client_connections, cib_notify_send_one, &update);
 
-    } else {
-        crm_notice("Could not notify clients: %s " CRM_XS " rc=%lld",
-                   pcmk_strerror(rc), (long long) rc);
+    for (binary = 0; binary < 2; binary++) {
+        for (codec = 0; codec < CIB_NOTIFY_CODECS; codec++) {
+            pcmk__ipc_shared_unref(update.shared[binary][codec]);
+        }
     }
-    pcmk_free_ipc_event(iov);
     crm_trace("Notify complete");
 }
 
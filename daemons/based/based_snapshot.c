@@ -0,0 +1,208 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/ipc_internal.h>
+#include <crm/cib/internal.h>
+
+#include <pacemaker-based.h>
+
+/*
+ * CIB query snapshots
+ *
+ * Monitoring tools tend to poll for the entire CIB. Answering each such query
+ * the usual way copies the CIB into the reply and then serializes the copy,
+ * all on the main loop, so writes queue behind every reader.
+ *
+ * Instead, the first whole-CIB query after a change serializes the CIB once,
+ * and that text is kept as a read-only snapshot until the CIB changes again.
+ * Each reply is built by splicing the snapshot into a serialized reply
+ * envelope, so a query costs a copy of text rather than a walk of the tree,
+ * and every reply reflects exactly one committed CIB version.
+ */
+
+#define SNAPSHOT_PLACEHOLDER "<" F_CIB_CALLDATA "/>"
+
+static char *snapshot_text = NULL;
+static size_t snapshot_len = 0;
+static xmlNode *snapshot_cib = NULL;    // the_cib when snapshot was taken
+
+static unsigned long long snapshot_taken = 0;
+static unsigned long long snapshot_used = 0;
+
+/*!
+ * \internal
+ * \brief Discard the current query snapshot (because the CIB changed)
+ */
+void
+cib_snapshot_invalidate(void)
+{
+    free(snapshot_text);
+    snapshot_text = NULL;
+    snapshot_len = 0;
+    snapshot_cib = NULL;
+}
+
+static const char *
+current_snapshot(void)
+{
+    if ((snapshot_text == NULL) || (snapshot_cib != the_cib)) {
+        cib_snapshot_invalidate();
+        snapshot_text = dump_xml_unformatted(the_cib);
+        if (snapshot_text == NULL) {
+            return NULL;
+        }
+        snapshot_len = strlen(snapshot_text);
+        snapshot_cib = the_cib;
+        snapshot_taken++;
+        crm_trace("Took CIB query snapshot of %s.%s.%s (%llu bytes)",
+                  crm_element_value(the_cib, XML_ATTR_GENERATION_ADMIN),
+                  crm_element_value(the_cib, XML_ATTR_GENERATION),
+                  crm_element_value(the_cib, XML_ATTR_NUMUPDATES),
+                  (unsigned long long) snapshot_len);
+    }
+    snapshot_used++;
+    return snapshot_text;
+}
+
+static gboolean
+snapshot_can_answer(crm_client_t *client, xmlNode *request, int call_options)
+{
+    const char *section = crm_element_value(request, F_CIB_SECTION);
+
+    if ((client == NULL) || (client->kind != CRM_CLIENT_IPC)
+        || (the_cib == NULL) || (cib_status != pcmk_ok)) {
+        return FALSE;
+
+    } else if (safe_str_neq(crm_element_value(request, F_CIB_OPERATION),
+                            CIB_OP_QUERY)) {
+        return FALSE;
+
+    } else if (call_options & (cib_xpath|cib_no_children|cib_discard_reply)) {
+        return FALSE;
+
+    } else if ((section != NULL)
+               && safe_str_neq(section, XML_CIB_TAG_SECTION_ALL)) {
+        return FALSE;
+    }
+
+#if ENABLE_ACL
+    // Filtered views are specific to the user, so always build them fresh
+    if (pcmk_acl_required(crm_element_value(request, F_CIB_USER))) {
+        return FALSE;
+    }
+#endif
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Answer a whole-CIB query from the query snapshot, if possible
+ *
+ * \param[in] client        Local client that sent \p request
+ * \param[in] request       Request to answer
+ * \param[in] call_options  Group of enum cib_call_options flags for request
+ *
+ * \return TRUE if the query was answered, FALSE if it must be processed
+ *         normally
+ */
+gboolean
+cib_snapshot_query(crm_client_t *client, xmlNode *request, int call_options)
+{
+    const char *cib_text = NULL;
+    char *envelope = NULL;
+    char *placeholder = NULL;
+    char *text = NULL;
+    size_t prefix_len = 0;
+    size_t suffix_len = 0;
+    uint32_t rid = 0;
+    ssize_t rc = 0;
+    struct iovec *iov = NULL;
+    xmlNode *reply = NULL;
+
+    if (!snapshot_can_answer(client, request, call_options)) {
+        return FALSE;
+    }
+
+    reply = create_xml_node(NULL, "cib-reply");
+    crm_xml_add(reply, F_TYPE, T_CIB);
+    crm_xml_add(reply, F_CIB_OPERATION, CIB_OP_QUERY);
+    crm_xml_add(reply, F_CIB_CALLID, crm_element_value(request, F_CIB_CALLID));
+    crm_xml_add(reply, F_CIB_CLIENTID,
+                crm_element_value(request, F_CIB_CLIENTID));
+    crm_xml_add(reply, F_CIB_CALLOPTS,
+                crm_element_value(request, F_CIB_CALLOPTS));
+    crm_xml_add_int(reply, F_CIB_RC, pcmk_ok);
+    create_xml_node(reply, F_CIB_CALLDATA);
+
+    envelope = dump_xml_unformatted(reply);
+    free_xml(reply);
+
+    /* Attribute values can't contain '<', so the first match is the
+     * (empty) calldata element
+     */
+    placeholder = (envelope? strstr(envelope, SNAPSHOT_PLACEHOLDER) : NULL);
+    cib_text = current_snapshot();
+    if ((placeholder == NULL) || (cib_text == NULL)) {
+        free(envelope);
+        return FALSE;
+    }
+
+    prefix_len = placeholder - envelope;
+    suffix_len = strlen(placeholder + strlen(SNAPSHOT_PLACEHOLDER));
+    text = malloc(prefix_len + snapshot_len + suffix_len
+                  + (2 * strlen(F_CIB_CALLDATA)) + 6);
+    CRM_ASSERT(text != NULL);
+    sprintf(text, "%.*s<" F_CIB_CALLDATA ">%s</" F_CIB_CALLDATA ">%s",
+            (int) prefix_len, envelope, cib_text,
+            placeholder + strlen(SNAPSHOT_PLACEHOLDER));
+    free(envelope);
+
+    if (call_options & cib_sync_call) {
+        CRM_LOG_ASSERT(client->request_id);
+        rid = client->request_id;
+    }
+
+    rc = pcmk__ipc_prepare_text_iov(rid, text, 0,
+                                    pcmk__best_codec(client->codecs), &iov);
+    if (rc < 0) {
+        crm_notice("Could not answer query from %s with CIB snapshot: %s",
+                   crm_client_name(client), pcmk_strerror(rc));
+        pcmk_free_ipc_event(iov);
+        return FALSE;
+    }
+
+    if (call_options & cib_sync_call) {
+        client->request_id = 0;
+        rc = crm_ipcs_sendv(client, iov, crm_ipc_server_free);
+    } else {
+        rc = crm_ipcs_sendv(client, iov,
+                            crm_ipc_server_event|crm_ipc_server_free);
+    }
+    if (rc < 0) {
+        crm_warn("%s reply to %s failed: %s " CRM_XS " rc=%lld",
+                 ((call_options & cib_sync_call)? "Synchronous" : "Asynchronous"),
+                 client->name, pcmk_strerror(rc), (long long) rc);
+    }
+
+    crm_trace("Answered query %s from %s with CIB snapshot "
+              CRM_XS " snapshots=%llu uses=%llu",
+              crm_element_value(request, F_CIB_CALLID),
+              crm_client_name(client), snapshot_taken, snapshot_used);
+    return TRUE;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/ipc_internal.h>
+#include <crm/cib/internal.h>
+
+#include <pacemaker-based.h>
+
+/*
+ * CIB operation statistics
+ *
+ * For each operation type, and for each client name, the CIB manager counts
+ * requests and accumulates the time spent in each phase of handling them, along
+ * with a histogram of their total handling time. Requests forwarded to peers
+ * are counted separately from requests processed locally, since in a cluster
+ * most updates are forwarded to all nodes (this one included) before being
+ * processed.
+ *
+ * The statistics are reported (as XML) by the CIB_OP_STATS operation, along
+ * with the event queue statistics of each connected IPC client.
+ */
+
+// Upper bounds (in milliseconds) of the histogram buckets, except the last
+static const unsigned int bucket_ms[] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+#define CIB_STATS_BUCKETS   ((int) (sizeof(bucket_ms) / sizeof(bucket_ms[0])) + 1)
+
+// Client names beyond this many are counted together
+#define CIB_STATS_MAX_CLIENTS 256
+#define CIB_STATS_OTHER_CLIENTS "(other)"
+
+static const char *phase_names[cib_phase_max] = {
+    "perform", "validate", "diff", "notify", "broadcast", "reply"
+};
+
+typedef struct cib_op_stats_s {
+    unsigned long long count;       // requests processed here
+    unsigned long long failed;      // requests processed here, unsuccessfully
+    unsigned long long forwarded;   // requests forwarded to peers
+    unsigned long long total_us;
+    unsigned long long max_us;
+    unsigned long long phase_us[cib_phase_max];
+    unsigned long long phase_max_us[cib_phase_max];
+    unsigned long long histogram[CIB_STATS_BUCKETS];
+} cib_op_stats_t;
+
+static GHashTable *op_stats = NULL;
+static GHashTable *client_stats = NULL;
+static time_t stats_since = 0;
+
+// Timings of the request being handled
+static long long request_started = 0;
+static long long request_phase_us[cib_phase_max];
+
+/*!
+ * \internal
+ * \brief Start timing the handling of a new request
+ */
+void
+cib_stats_start(void)
+{
+    request_started = cib_now_us();
+    memset(request_phase_us, 0, sizeof(request_phase_us));
+}
+
+/*!
+ * \internal
+ * \brief Add time to a phase of the current request
+ *
+ * \param[in] phase  Phase to add time to
+ * \param[in] us     Time to add (in microseconds)
+ */
+void
+cib_stats_add_us(enum cib_stats_phase phase, long long us)
+{
+    CRM_CHECK((phase >= 0) && (phase < cib_phase_max), return);
+    if (us > 0) {
+        request_phase_us[phase] += us;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Add the time since a given moment to a phase of the current request
+ *
+ * \param[in] phase    Phase to add time to
+ * \param[in] started  When the phase started (as returned by cib_now_us())
+ */
+void
+cib_stats_add(enum cib_stats_phase phase, long long started)
+{
+    cib_stats_add_us(phase, cib_now_us() - started);
+}
+
+/*!
+ * \internal
+ * \brief Add the phases of a cib_perform_op() call to the current request
+ *
+ * \param[in] started  When cib_perform_op() was called
+ */
+void
+cib_stats_perform(long long started)
+{
+    const cib_op_times_t *times = cib_last_op_times();
+    long long elapsed = cib_now_us() - started;
+
+    cib_stats_add_us(cib_phase_validate, times->validate_us);
+    cib_stats_add_us(cib_phase_diff, times->diff_us);
+    cib_stats_add_us(cib_phase_perform,
+                     elapsed - times->validate_us - times->diff_us);
+}
+
+static cib_op_stats_t *
+get_stats(GHashTable **table, const char *name, guint limit)
+{
+    cib_op_stats_t *stats = NULL;
+
+    if (*table == NULL) {
+        *table = g_hash_table_new_full(crm_str_hash, g_str_equal, free, free);
+    }
+    if (stats_since == 0) {
+        stats_since = time(NULL);
+    }
+
+    stats = g_hash_table_lookup(*table, name);
+    if (stats == NULL) {
+        if ((limit > 0) && (g_hash_table_size(*table) >= limit)) {
+            return get_stats(table, CIB_STATS_OTHER_CLIENTS, 0);
+        }
+        stats = calloc(1, sizeof(cib_op_stats_t));
+        CRM_ASSERT(stats != NULL);
+        g_hash_table_insert(*table, strdup(name), stats);
+    }
+    return stats;
+}
+
+static void
+record_stats(cib_op_stats_t *stats, long long total_us, int rc,
+             gboolean forwarded)
+{
+    int lpc = 0;
+
+    if (forwarded) {
+        stats->forwarded++;
+    } else {
+        long long total_ms = total_us / 1000;
+
+        stats->count++;
+        if (rc != pcmk_ok) {
+            stats->failed++;
+        }
+        stats->total_us += total_us;
+        stats->max_us = QB_MAX(stats->max_us, (unsigned long long) total_us);
+
+        for (lpc = 0; lpc < (CIB_STATS_BUCKETS - 1); lpc++) {
+            if (total_ms < bucket_ms[lpc]) {
+                break;
+            }
+        }
+        stats->histogram[lpc]++;
+    }
+
+    for (lpc = 0; lpc < cib_phase_max; lpc++) {
+        unsigned long long us = (unsigned long long) request_phase_us[lpc];
+
+        stats->phase_us[lpc] += us;
+        stats->phase_max_us[lpc] = QB_MAX(stats->phase_max_us[lpc], us);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Record the statistics for the current request
+ *
+ * \param[in] op         Operation requested
+ * \param[in] client     Name of client that sent the request
+ * \param[in] rc         Result of request
+ * \param[in] forwarded  TRUE if the request was forwarded rather than
+ *                       processed here
+ */
+void
+cib_stats_finish(const char *op, const char *client, int rc,
+                 gboolean forwarded)
+{
+    long long total_us = cib_now_us() - request_started;
+
+    if (request_started == 0) {
+        return;
+    }
+    request_started = 0;
+
+    record_stats(get_stats(&op_stats, (op? op : "unknown"), 0),
+                 total_us, rc, forwarded);
+    record_stats(get_stats(&client_stats, (client? client : "unknown"),
+                           CIB_STATS_MAX_CLIENTS),
+                 total_us, rc, forwarded);
+
+    if (total_us >= 1000000) {
+        crm_notice("Handling %s request from %s took %lldms "
+                   CRM_XS " perform=%lldus validate=%lldus diff=%lldus"
+                   " notify=%lldus broadcast=%lldus reply=%lldus",
+                   crm_str(op), crm_str(client), total_us / 1000,
+                   request_phase_us[cib_phase_perform],
+                   request_phase_us[cib_phase_validate],
+                   request_phase_us[cib_phase_diff],
+                   request_phase_us[cib_phase_notify],
+                   request_phase_us[cib_phase_broadcast],
+                   request_phase_us[cib_phase_reply]);
+    }
+}
+
+static void
+add_ull(xmlNode *xml, const char *name, unsigned long long value)
+{
+    char *s = crm_strdup_printf("%llu", value);
+
+    crm_xml_add(xml, name, s);
+    free(s);
+}
+
+static void
+add_stats_xml(xmlNode *parent, const char *tag, const char *name,
+              cib_op_stats_t *stats)
+{
+    int lpc = 0;
+    xmlNode *xml = create_xml_node(parent, tag);
+
+    crm_xml_add(xml, XML_NVPAIR_ATTR_NAME, name);
+    add_ull(xml, "count", stats->count);
+    add_ull(xml, "failed", stats->failed);
+    add_ull(xml, "forwarded", stats->forwarded);
+    add_ull(xml, "total-us", stats->total_us);
+    add_ull(xml, "max-us", stats->max_us);
+
+    for (lpc = 0; lpc < cib_phase_max; lpc++) {
+        char *attr = crm_strdup_printf("%s-us", phase_names[lpc]);
+
+        add_ull(xml, attr, stats->phase_us[lpc]);
+        free(attr);
+
+        attr = crm_strdup_printf("%s-max-us", phase_names[lpc]);
+        add_ull(xml, attr, stats->phase_max_us[lpc]);
+        free(attr);
+    }
+
+    for (lpc = 0; lpc < CIB_STATS_BUCKETS; lpc++) {
+        xmlNode *bucket = NULL;
+
+        if (stats->histogram[lpc] == 0) {
+            continue;
+        }
+        bucket = create_xml_node(xml, "bucket");
+        if (lpc < (CIB_STATS_BUCKETS - 1)) {
+            crm_xml_add_int(bucket, "lt-ms", bucket_ms[lpc]);
+        }
+        add_ull(bucket, "count", stats->histogram[lpc]);
+    }
+}
+
+static void
+add_stats_table_xml(xmlNode *parent, const char *tag, GHashTable *table)
+{
+    GHashTableIter iter;
+    const char *name = NULL;
+    cib_op_stats_t *stats = NULL;
+
+    if (table == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &name,
+                                  (gpointer *) &stats)) {
+        add_stats_xml(parent, tag, name, stats);
+    }
+}
+
+int
+cib_process_stats(const char *op, int options, const char *section,
+                  xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                  xmlNode **result_cib, xmlNode **answer)
+{
+    *answer = create_xml_node(NULL, "cib_stats");
+    crm_xml_add(*answer, XML_ATTR_UNAME, cib_our_uname);
+    add_ull(*answer, "since", (unsigned long long) stats_since);
+    add_stats_table_xml(*answer, "cib_op_stats", op_stats);
+    add_stats_table_xml(*answer, "cib_client_stats", client_stats);
+    pcmk__add_ipc_client_stats(*answer);
+    return pcmk_ok;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+#include <crm/cib/internal.h>
+
+#include <pacemaker-based.h>
+
+/*
+ * Status section index
+ *
+ * Nearly all CIB traffic is status updates from the controller, and each is a
+ * modify that merges a <status> or <node_state> fragment into the status
+ * section. Generically, that means finding the target by walking the section
+ * (every node's entire resource history, in the worst case) and then scanning
+ * the siblings at each level for a matching ID.
+ *
+ * Status updates are applied to the live CIB in place (see cib_zero_copy), so
+ * the manager keeps hash tables, for the containers that can grow large, from
+ * child ID to child: node_state elements in <status>, and lrm_resource
+ * elements in each node's <lrm_resources>. The tables for a container are
+ * built the first time it is searched, and then kept up to date as children
+ * are created.
+ *
+ * Only in-place merges keep the index valid, so it is discarded after any
+ * other change to the CIB (and whenever such a merge fails), and rebuilt
+ * lazily afterward.
+ */
+
+// Container element -> table of child ID -> child element
+static GHashTable *status_index = NULL;
+
+// Whether the last modify was an in-place status merge using the index
+static gboolean status_index_used = FALSE;
+
+static const char *
+indexed_child_tag(xmlNode *container)
+{
+    const char *name = crm_element_name(container);
+
+    if (safe_str_eq(name, XML_CIB_TAG_STATUS)) {
+        return XML_CIB_TAG_STATE;
+
+    } else if (safe_str_eq(name, XML_LRM_TAG_RESOURCES)) {
+        return XML_LRM_TAG_RESOURCE;
+    }
+    return NULL;
+}
+
+static GHashTable *
+container_index(xmlNode *container, const char *tag)
+{
+    GHashTable *children = NULL;
+    xmlNode *child = NULL;
+
+    if (status_index == NULL) {
+        status_index = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) g_hash_table_destroy);
+    }
+
+    children = g_hash_table_lookup(status_index, container);
+    if (children != NULL) {
+        return children;
+    }
+
+    children = g_hash_table_new_full(crm_str_hash, g_str_equal, free, NULL);
+    for (child = __xml_first_child(container); child != NULL;
+         child = __xml_next(child)) {
+
+        const char *id = ID(child);
+
+        // Like pcmk__xe_match(), the first match wins
+        if ((id != NULL) && safe_str_eq(crm_element_name(child), tag)
+            && (g_hash_table_lookup(children, id) == NULL)) {
+            g_hash_table_insert(children, strdup(id), child);
+        }
+    }
+    g_hash_table_insert(status_index, container, children);
+    return children;
+}
+
+/*!
+ * \internal
+ * \brief Discard the status section index
+ */
+void
+cib_status_index_reset(void)
+{
+    if (status_index != NULL) {
+        g_hash_table_destroy(status_index);
+        status_index = NULL;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Keep or discard the status index after a CIB modification
+ *
+ * \param[in] rc  Result of the modification
+ */
+void
+cib_status_index_update(int rc)
+{
+    if ((rc != pcmk_ok) || !status_index_used) {
+        cib_status_index_reset();
+    }
+    status_index_used = FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Merge an update into an element of the live status section
+ *
+ * This behaves like add_xml_object() without diff handling, except that
+ * children of indexed containers are looked up in the index.
+ *
+ * \param[in] parent  Element containing \p target (or where it should go)
+ * \param[in] target  Element to update (or NULL to find or create it)
+ * \param[in] update  Update to merge
+ */
+static void
+status_merge(xmlNode *parent, xmlNode *target, xmlNode *update)
+{
+    xmlNode *a_child = NULL;
+    const char *name = crm_element_name(update);
+    const char *id = ID(update);
+
+    if (target == NULL) {
+        const char *tag = indexed_child_tag(parent);
+
+        if ((id != NULL) && safe_str_eq(name, tag)) {
+            GHashTable *children = container_index(parent, tag);
+
+            target = g_hash_table_lookup(children, id);
+            if (target == NULL) {
+                target = create_xml_node(parent, name);
+                g_hash_table_insert(children, strdup(id), target);
+            }
+
+        } else {
+            // Small containers aren't worth indexing
+            const char *href = (id? XML_ATTR_ID : XML_ATTR_IDREF);
+            const char *href_val = (id? id : crm_element_value(update, XML_ATTR_IDREF));
+
+            target = pcmk__xe_match(parent, name, (href_val? href : NULL),
+                                    href_val);
+            if (target == NULL) {
+                target = create_xml_node(parent, name);
+            }
+        }
+    }
+
+    copy_in_properties(target, update);
+
+    for (a_child = __xml_first_child(update); a_child != NULL;
+         a_child = __xml_next(a_child)) {
+
+        if (a_child->type == XML_ELEMENT_NODE) {
+            status_merge(target, NULL, a_child);
+        } else {
+            add_xml_object(target, NULL, a_child, FALSE);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Process a CIB modify request, using the status index where possible
+ *
+ * Merges of \<status\> or \<node_state\> fragments into the live status section
+ * use the index; anything else is handled by cib_process_modify().
+ */
+int
+cib_process_modify_svr(const char *op, int options, const char *section,
+                       xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                       xmlNode **result_cib, xmlNode **answer)
+{
+    xmlNode *status = NULL;
+    const char *name = crm_element_name(input);
+
+    status_index_used = FALSE;
+
+    if ((*result_cib != the_cib) || (input == NULL)
+        || (options & (cib_xpath|cib_mixed_update))
+        || safe_str_neq(section, XML_CIB_TAG_STATUS)) {
+        return cib_process_modify(op, options, section, req, input,
+                                  existing_cib, result_cib, answer);
+    }
+
+    status = get_object_root(section, *result_cib);
+    if (status == NULL) {
+        return cib_process_modify(op, options, section, req, input,
+                                  existing_cib, result_cib, answer);
+    }
+
+    if (safe_str_eq(name, XML_CIB_TAG_STATUS) && (ID(input) == NULL)) {
+        status_index_used = TRUE;
+        status_merge(NULL, status, input);
+        return pcmk_ok;
+
+    } else if (safe_str_eq(name, XML_CIB_TAG_STATE) && (ID(input) != NULL)) {
+        GHashTable *nodes = container_index(status, XML_CIB_TAG_STATE);
+
+        status_index_used = TRUE;
+        if ((g_hash_table_lookup(nodes, ID(input)) == NULL)
+            && !(options & cib_can_create)) {
+            return -ENXIO;
+        }
+        status_merge(status, NULL, input);
+        return pcmk_ok;
+    }
+
+    return cib_process_modify(op, options, section, req, input,
+                              existing_cib, result_cib, answer);
+}
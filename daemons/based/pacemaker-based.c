@@ -190,6 +190,14 @@ main(int argc, char **argv)
         return CRM_EX_FATAL;
     }
 
+    /* Start the disk writer before reading the CIB or opening any connections,
+     * so it doesn't inherit them (there is nothing for it to do in stand-alone
+     * mode, where writes are disabled)
+     */
+    if (cib_writes_enabled) {
+        cib_start_disk_writer();
+    }
+
     crm_peer_init();
 
     // Read initial CIB, connect to cluster, and start IPC servers
@@ -92,6 +92,12 @@ xmlNode *readCibXml(char *buffer);
 xmlNode *readCibXmlFile(const char *dir, const char *file,
                         gboolean discard_status);
 int activateCibXml(xmlNode *doc, gboolean to_disk, const char *op);
+void cib_start_disk_writer(void);
+void cib_stop_disk_writer(void);
+int cib_journal_write(xmlNode *cib, const char *dir, const char *file,
+                      gboolean checkpoint);
+unsigned int cib_journal_pending(void);
+xmlNode *cib_journal_replay(xmlNode *root, const char *dir, const char *file);
 
 xmlNode *createCibRequest(gboolean isLocal, const char *operation,
                           const char *section, const char *verbose,
@@ -129,7 +135,44 @@ int cib_process_upgrade_server(const char *op, int options, const char *section,
                                xmlNode *req, xmlNode *input,
                                xmlNode *existing_cib, xmlNode **result_cib,
                                xmlNode **answer);
+int cib_process_apply_delta(const char *op, int options, const char *section,
+                            xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                            xmlNode **result_cib, xmlNode **answer);
 void send_sync_request(const char *host);
+void add_sync_version(xmlNode *msg, xmlNode *cib);
+void cib_history_add(xmlNode *patchset);
+void cib_history_clear(void);
+
+gboolean cib_snapshot_query(crm_client_t *client, xmlNode *request,
+                            int call_options);
+void cib_snapshot_invalidate(void);
+
+int cib_process_modify_svr(const char *op, int options, const char *section,
+                           xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                           xmlNode **result_cib, xmlNode **answer);
+void cib_status_index_update(int rc);
+void cib_status_index_reset(void);
+
+// Phases of request handling measured by the operation statistics
+enum cib_stats_phase {
+    cib_phase_perform,      // cib_perform_op(), less validation and diff
+    cib_phase_validate,     // schema validation
+    cib_phase_diff,         // patchset creation
+    cib_phase_notify,       // notification fan-out to local clients
+    cib_phase_broadcast,    // sending to peers
+    cib_phase_reply,        // replying to local client
+    cib_phase_max
+};
+
+void cib_stats_start(void);
+void cib_stats_add(enum cib_stats_phase phase, long long started);
+void cib_stats_add_us(enum cib_stats_phase phase, long long us);
+void cib_stats_perform(long long started);
+void cib_stats_finish(const char *op, const char *client, int rc,
+                      gboolean forwarded);
+int cib_process_stats(const char *op, int options, const char *section,
+                      xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                      xmlNode **result_cib, xmlNode **answer);
 
 xmlNode *cib_msg_copy(xmlNode *msg, gboolean with_data);
 xmlNode *cib_construct_reply(xmlNode *request, xmlNode *output, int rc);
@@ -147,6 +190,8 @@ void cib_diff_notify(int options, const char *client, const char *call_id,
                      xmlNode *old_cib);
 void cib_replace_notify(const char *origin, xmlNode *update, int result,
                         xmlNode *diff);
+void cib_notify_set_filter(crm_client_t *client, xmlNode *request);
+void cib_notify_remove_client(crm_client_t *client);
 
 static inline const char *
 cib_config_lookup(const char *opt)
@@ -26,6 +26,7 @@ do_cib_updated(const char *event, xmlNode * msg)
     if (crm_patchset_contains_alert(msg, TRUE)) {
         mainloop_set_trigger(config_read);
     }
+    controld_sched_cib_changed(msg);
 }
 
 static void
@@ -56,6 +57,9 @@ do_cib_control(long long action,
 
     if (action & A_CIB_STOP) {
 
+        if (fsa_cib_conn->state != cib_disconnected) {
+            controld_flush_rsc_updates();
+        }
         if (fsa_cib_conn->state != cib_disconnected && last_resource_update != 0) {
             crm_info("Waiting for resource update %d to complete", last_resource_update);
             crmd_fsa_stall(FALSE);
@@ -127,6 +127,8 @@ do_shutdown_req(long long action,
 
 extern char *max_generation_from;
 extern xmlNode *max_generation_xml;
+extern GHashTable *full_history_nodes;
+extern GHashTable *self_sync_nodes;
 extern GHashTable *resource_history;
 extern GHashTable *voted;
 
@@ -271,6 +273,14 @@ crmd_exit(crm_exit_t exit_code)
 
     free(max_generation_from); max_generation_from = NULL;
     free_xml(max_generation_xml); max_generation_xml = NULL;
+    if (full_history_nodes) {
+        g_hash_table_destroy(full_history_nodes);
+        full_history_nodes = NULL;
+    }
+    if (self_sync_nodes) {
+        g_hash_table_destroy(self_sync_nodes);
+        self_sync_nodes = NULL;
+    }
 
     mainloop_destroy_signal(SIGPIPE);
     mainloop_destroy_signal(SIGUSR1);
@@ -691,6 +701,14 @@ static pe_cluster_option crmd_opts[] = {
         "*** Advanced Use Only *** Enabling this option will slow down cluster recovery under all conditions",
         "Delay cluster recovery for the configured interval to allow for additional/related events to occur.\n"
         "Useful if your configuration is sensitive to the order in which ping updates arrive."
+    },
+	{
+        "scheduler-max-delay", NULL, "time", NULL, "2s", &check_timer,
+        "*** Advanced Use Only *** Maximum time to delay a scheduler run while changes keep arriving",
+        "During a burst of changes, the controller briefly delays each new scheduler run so that one "
+        "run covers several changes, rather than each run being discarded when the next change arrives. "
+        "Changes are never delayed longer than this in total. Zero disables the delay. "
+        "Ignored if transition-delay is set."
     },
 	{ "stonith-watchdog-timeout", NULL, "time", NULL, NULL, &check_sbd_timeout,
 	  "How long to wait before we can assume nodes are safely down", NULL
@@ -803,6 +821,8 @@ config_query_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void
     value = crmd_pref(config_hash, "transition-delay");
     transition_timer->period_ms = crm_get_msec(value);
 
+    controld_set_sched_max_delay(crmd_pref(config_hash, "scheduler-max-delay"));
+
     value = crmd_pref(config_hash, "join-integration-timeout");
     integration_timer->period_ms = crm_get_msec(value);
 
@@ -51,7 +51,8 @@ void send_direct_ack(const char *to_host, const char *to_sys,
 
 static gboolean lrm_state_verify_stopped(lrm_state_t * lrm_state, enum crmd_fsa_state cur_state,
                                          int log_level);
-static int do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data_t * op);
+static void do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc,
+                               lrmd_event_data_t * op, gboolean urgent);
 
 static void
 lrm_connection_destroy(void)
@@ -159,10 +160,47 @@ history_free(gpointer data)
     lrmd_free_event(history->failed);
     lrmd_free_event(history->last);
     free(history->id);
+    free(history->digest);
     history_free_recurring_ops(history);
     free(history);
 }
 
+/*!
+ * \internal
+ * \brief Note that a resource's history has changed
+ *
+ * \param[in,out] lrm_state  Executor state that \p entry belongs to
+ * \param[in,out] entry      Resource history that changed
+ * \param[in]     recorded   Whether the change was just recorded in the CIB
+ *                           (with the current history sequence number)
+ */
+static void
+history_changed(lrm_state_t *lrm_state, rsc_history_t *entry,
+                gboolean recorded)
+{
+    entry->seq = recorded? lrm_state->history_seq : ++(lrm_state->history_seq);
+    free(entry->digest);
+    entry->digest = NULL;
+}
+
+/*!
+ * \internal
+ * \brief Add the history epoch and a sequence number to an \<lrm\> element
+ *
+ * \param[in]     lrm_state  Executor state for node whose history it is
+ * \param[in,out] xml_lrm    Element to stamp
+ * \param[in]     seq        Sequence number of newest history in \p xml_lrm
+ */
+static void
+add_history_stamp(lrm_state_t *lrm_state, xmlNode *xml_lrm, long long seq)
+{
+    char *seq_s = crm_strdup_printf("%lld", seq);
+
+    crm_xml_add(xml_lrm, XML_LRM_ATTR_HISTORY_EPOCH, lrm_state->history_epoch);
+    crm_xml_add(xml_lrm, XML_LRM_ATTR_HISTORY_SEQ, seq_s);
+    free(seq_s);
+}
+
 static void
 update_history_cache(lrm_state_t * lrm_state, lrmd_rsc_info_t * rsc, lrmd_event_data_t * op)
 {
@@ -201,6 +239,7 @@ update_history_cache(lrm_state_t * lrm_state, lrmd_rsc_info_t * rsc, lrmd_event_
         return;
     }
 
+    history_changed(lrm_state, entry, TRUE);
     entry->last_callid = op->call_id;
     target_rc = rsc_op_expected_rc(op);
     if (op->op_status == PCMK_LRM_OP_CANCELLED) {
@@ -711,17 +750,24 @@ build_operation_update(xmlNode * parent, lrmd_rsc_info_t * rsc, lrmd_event_data_
          * schedule a meta-data cache check at the beginning of each transition.
          * Once that is working, this block will only be a fallback in case the
          * initial collection fails.
+         *
+         * The executor stores agents' meta-data on disk the first time it runs
+         * them, so a restarted controller rarely has to run them itself.
          */
-        char *metadata_str = NULL;
-
-        int rc = lrm_state_get_metadata(lrm_state, rsc->standard,
-                                        rsc->provider, rsc->type,
-                                        &metadata_str, 0);
-
-        if (rc != pcmk_ok) {
-            crm_warn("Failed to get metadata for %s (%s:%s:%s)",
-                     rsc->id, rsc->standard, rsc->provider, rsc->type);
-            return TRUE;
+        char *metadata_str = pcmk__metadata_cache_get(rsc->standard,
+                                                      rsc->provider,
+                                                      rsc->type);
+
+        if (metadata_str == NULL) {
+            int rc = lrm_state_get_metadata(lrm_state, rsc->standard,
+                                            rsc->provider, rsc->type,
+                                            &metadata_str, 0);
+
+            if (rc != pcmk_ok) {
+                crm_warn("Failed to get metadata for %s (%s:%s:%s)",
+                         rsc->id, rsc->standard, rsc->provider, rsc->type);
+                return TRUE;
+            }
         }
 
         metadata = metadata_cache_update(lrm_state->metadata_cache, rsc,
@@ -779,6 +825,33 @@ is_rsc_active(lrm_state_t * lrm_state, const char *rsc_id)
     return TRUE;
 }
 
+static xmlNode *
+build_rsc_history(lrm_state_t *lrm_state, rsc_history_t *entry,
+                  xmlNode *rsc_list)
+{
+    GList *gIter = NULL;
+    xmlNode *xml_rsc = create_xml_node(rsc_list, XML_LRM_TAG_RESOURCE);
+
+    crm_xml_add(xml_rsc, XML_ATTR_ID, entry->id);
+    crm_xml_add(xml_rsc, XML_ATTR_TYPE, entry->rsc.type);
+    crm_xml_add(xml_rsc, XML_AGENT_ATTR_CLASS, entry->rsc.standard);
+    crm_xml_add(xml_rsc, XML_AGENT_ATTR_PROVIDER, entry->rsc.provider);
+
+    if (entry->last && entry->last->params) {
+        const char *container = g_hash_table_lookup(entry->last->params, CRM_META"_"XML_RSC_ATTR_CONTAINER);
+        if (container) {
+            crm_trace("Resource %s is a part of container resource %s", entry->id, container);
+            crm_xml_add(xml_rsc, XML_RSC_ATTR_CONTAINER, container);
+        }
+    }
+    build_operation_update(xml_rsc, &(entry->rsc), entry->failed, lrm_state->node_name, __FUNCTION__);
+    build_operation_update(xml_rsc, &(entry->rsc), entry->last, lrm_state->node_name, __FUNCTION__);
+    for (gIter = entry->recurring_op_list; gIter != NULL; gIter = gIter->next) {
+        build_operation_update(xml_rsc, &(entry->rsc), gIter->data, lrm_state->node_name, __FUNCTION__);
+    }
+    return xml_rsc;
+}
+
 static gboolean
 build_active_RAs(lrm_state_t * lrm_state, xmlNode * rsc_list)
 {
@@ -787,30 +860,54 @@ build_active_RAs(lrm_state_t * lrm_state, xmlNode * rsc_list)
 
     g_hash_table_iter_init(&iter, lrm_state->resource_history);
     while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+        build_rsc_history(lrm_state, entry, rsc_list);
+    }
 
-        GList *gIter = NULL;
-        xmlNode *xml_rsc = create_xml_node(rsc_list, XML_LRM_TAG_RESOURCE);
+    return FALSE;
+}
 
-        crm_xml_add(xml_rsc, XML_ATTR_ID, entry->id);
-        crm_xml_add(xml_rsc, XML_ATTR_TYPE, entry->rsc.type);
-        crm_xml_add(xml_rsc, XML_AGENT_ATTR_CLASS, entry->rsc.standard);
-        crm_xml_add(xml_rsc, XML_AGENT_ATTR_PROVIDER, entry->rsc.provider);
+/*!
+ * \internal
+ * \brief Calculate a digest of a resource's history
+ *
+ * The digest does not depend on the order of attributes or operations, or on
+ * which function recorded each operation, so history recorded one result at a
+ * time has the same digest as the same history built all at once.
+ *
+ * \param[in] xml_rsc  Resource history (\<lrm_resource\>) to digest
+ *
+ * \return Newly allocated digest of \p xml_rsc
+ */
+static char *
+rsc_history_digest(xmlNode *xml_rsc)
+{
+    GList *ops = NULL;
+    GList *iter = NULL;
+    GString *buffer = NULL;
+    char *text = NULL;
+    char *digest = NULL;
+    xmlNode *op = NULL;
+    xmlNode *sorted = sorted_xml(xml_rsc, NULL, TRUE);
 
-        if (entry->last && entry->last->params) {
-            const char *container = g_hash_table_lookup(entry->last->params, CRM_META"_"XML_RSC_ATTR_CONTAINER);
-            if (container) {
-                crm_trace("Resource %s is a part of container resource %s", entry->id, container);
-                crm_xml_add(xml_rsc, XML_RSC_ATTR_CONTAINER, container);
-            }
-        }
-        build_operation_update(xml_rsc, &(entry->rsc), entry->failed, lrm_state->node_name, __FUNCTION__);
-        build_operation_update(xml_rsc, &(entry->rsc), entry->last, lrm_state->node_name, __FUNCTION__);
-        for (gIter = entry->recurring_op_list; gIter != NULL; gIter = gIter->next) {
-            build_operation_update(xml_rsc, &(entry->rsc), gIter->data, lrm_state->node_name, __FUNCTION__);
-        }
+    while ((op = first_named_child(sorted, XML_LRM_TAG_RSC_OP)) != NULL) {
+        xml_remove_prop(op, XML_ATTR_ORIGIN);
+        ops = g_list_prepend(ops, dump_xml_unformatted(op));
+        free_xml(op);
     }
+    ops = g_list_sort(ops, (GCompareFunc) strcmp);
 
-    return FALSE;
+    text = dump_xml_unformatted(sorted);
+    buffer = g_string_new(text);
+    free(text);
+    for (iter = ops; iter != NULL; iter = iter->next) {
+        g_string_append(buffer, (const char *) iter->data);
+    }
+    digest = crm_md5sum(buffer->str);
+
+    g_string_free(buffer, TRUE);
+    g_list_free_full(ops, free);
+    free_xml(sorted);
+    return digest;
 }
 
 static xmlNode *
@@ -832,6 +929,7 @@ do_lrm_query_internal(lrm_state_t *lrm_state, int update_flags)
 
     xml_data = create_xml_node(xml_state, XML_CIB_TAG_LRM);
     crm_xml_add(xml_data, XML_ATTR_ID, peer->uuid);
+    add_history_stamp(lrm_state, xml_data, lrm_state->history_seq);
     rsc_list = create_xml_node(xml_data, XML_LRM_TAG_RESOURCES);
 
     /* Build a list of active (not always running) resources */
@@ -855,6 +953,161 @@ do_lrm_query(gboolean is_replace, const char *node_name)
                                  node_update_cluster|node_update_peer);
 }
 
+/*!
+ * \internal
+ * \brief Check whether the CIB already has a resource's current history
+ *
+ * \param[in]     lrm_state  Executor state that \p entry belongs to
+ * \param[in,out] entry      Resource history to check
+ * \param[in]     cib_rsc    Resource's history in the CIB (if any)
+ * \param[in]     base       History sequence number of \p cib_rsc's node
+ *
+ * \return TRUE if \p cib_rsc matches \p entry, otherwise FALSE
+ */
+static gboolean
+rsc_history_recorded(lrm_state_t *lrm_state, rsc_history_t *entry,
+                     xmlNode *cib_rsc, long long base)
+{
+    char *digest = NULL;
+    gboolean recorded = FALSE;
+
+    // Anything changed since the CIB's history was recorded must be sent
+    if ((cib_rsc == NULL) || (entry->seq > base)) {
+        return FALSE;
+    }
+
+    // Otherwise, double-check the content
+    if (entry->digest == NULL) {
+        xmlNode *xml_rsc = build_rsc_history(lrm_state, entry, NULL);
+
+        entry->digest = rsc_history_digest(xml_rsc);
+        free_xml(xml_rsc);
+    }
+    digest = rsc_history_digest(cib_rsc);
+    recorded = safe_str_eq(digest, entry->digest);
+    if (!recorded) {
+        crm_debug("History of %s in CIB differs from executor state",
+                  entry->id);
+    }
+    free(digest);
+    return recorded;
+}
+
+/*!
+ * \internal
+ * \brief Build a node's resource history relative to what the CIB has
+ *
+ * If the local CIB has this node's history as recorded by this controller
+ * instance, only resources whose history has changed since then are included,
+ * and resources whose history has been removed since then are listed with
+ * XML_LRM_ATTR_HISTORY_REMOVED set. The \<lrm\> element then has
+ * XML_LRM_ATTR_HISTORY_BASE set to the sequence number of the CIB's history,
+ * so the recipient can check that its CIB has the same history before
+ * applying the changes. Otherwise, the node's entire history is built, as with
+ * do_lrm_query().
+ *
+ * \param[in] node_name  Name of node to build history for
+ *
+ * \return Node state update with resource history (or NULL on error)
+ */
+xmlNode *
+controld_query_history_changes(const char *node_name)
+{
+    int changed = 0;
+    int removed = 0;
+    long long base = 0;
+    const char *base_s = NULL;
+    const char *rsc_id = NULL;
+    crm_node_t *peer = NULL;
+    lrm_state_t *lrm_state = lrm_state_find(node_name);
+    rsc_history_t *entry = NULL;
+    xmlNode *cib_lrm = NULL;
+    xmlNode *cib_rsc = NULL;
+    xmlNode *xml_state = NULL;
+    xmlNode *xml_data = NULL;
+    xmlNode *rsc_list = NULL;
+    GHashTable *recorded = NULL;
+    GHashTableIter iter;
+
+    if (!lrm_state) {
+        crm_err("Could not find executor state for node %s", node_name);
+        return NULL;
+    }
+
+    peer = crm_get_peer_full(0, lrm_state->node_name, CRM_GET_PEER_ANY);
+    CRM_CHECK(peer != NULL, return NULL);
+
+    cib_lrm = controld_query_node_history(peer->uuid, 0);
+    if (cib_lrm != NULL) {
+        base_s = crm_element_value(cib_lrm, XML_LRM_ATTR_HISTORY_SEQ);
+    }
+    if ((base_s == NULL)
+        || safe_str_neq(crm_element_value(cib_lrm, XML_LRM_ATTR_HISTORY_EPOCH),
+                        lrm_state->history_epoch)) {
+        crm_debug("CIB has no resource history for %s from this instance",
+                  node_name);
+        free_xml(cib_lrm);
+        return do_lrm_query_internal(lrm_state,
+                                     node_update_cluster|node_update_peer);
+    }
+    base = crm_parse_ll(base_s, NULL);
+
+    xml_state = create_node_state_update(peer,
+                                         node_update_cluster|node_update_peer,
+                                         NULL, __FUNCTION__);
+    if (xml_state == NULL) {
+        free_xml(cib_lrm);
+        return NULL;
+    }
+
+    xml_data = create_xml_node(xml_state, XML_CIB_TAG_LRM);
+    crm_xml_add(xml_data, XML_ATTR_ID, peer->uuid);
+    add_history_stamp(lrm_state, xml_data, lrm_state->history_seq);
+    crm_xml_add(xml_data, XML_LRM_ATTR_HISTORY_BASE, base_s);
+    rsc_list = create_xml_node(xml_data, XML_LRM_TAG_RESOURCES);
+
+    recorded = g_hash_table_new_full(crm_str_hash, g_str_equal, free, NULL);
+    cib_rsc = first_named_child(cib_lrm, XML_LRM_TAG_RESOURCES);
+    for (cib_rsc = first_named_child(cib_rsc, XML_LRM_TAG_RESOURCE);
+         cib_rsc != NULL; cib_rsc = crm_next_same_xml(cib_rsc)) {
+
+        if (ID(cib_rsc) != NULL) {
+            g_hash_table_replace(recorded, strdup(ID(cib_rsc)), cib_rsc);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, lrm_state->resource_history);
+    while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+        cib_rsc = g_hash_table_lookup(recorded, entry->id);
+        if (!rsc_history_recorded(lrm_state, entry, cib_rsc, base)) {
+            build_rsc_history(lrm_state, entry, rsc_list);
+            changed++;
+        }
+        g_hash_table_remove(recorded, entry->id);
+    }
+
+    // Whatever is left in the CIB is no longer in the executor's history
+    g_hash_table_iter_init(&iter, recorded);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &rsc_id, NULL)) {
+        xmlNode *xml_rsc = create_xml_node(rsc_list, XML_LRM_TAG_RESOURCE);
+
+        crm_xml_add(xml_rsc, XML_ATTR_ID, rsc_id);
+        crm_xml_add(xml_rsc, XML_LRM_ATTR_HISTORY_REMOVED, XML_BOOLEAN_TRUE);
+        removed++;
+    }
+
+    crm_info("Resource history for %s has %d change%s and %d removal%s "
+             "since %lld " CRM_XS " resources=%d",
+             node_name, changed, s_if_plural(changed), removed,
+             s_if_plural(removed), base,
+             g_hash_table_size(lrm_state->resource_history));
+    crm_log_xml_trace(xml_state, "Executor state changes");
+
+    g_hash_table_destroy(recorded);
+    free_xml(cib_lrm);
+    return xml_state;
+}
+
 static void
 notify_deleted(lrm_state_t * lrm_state, ha_msg_input_t * input, const char *rsc_id, int rc)
 {
@@ -939,6 +1192,7 @@ delete_rsc_status(lrm_state_t * lrm_state, const char *rsc_id, int call_options,
 
     rsc_xpath = crm_strdup_printf(RSC_TEMPLATE, lrm_state->node_name, rsc_id);
 
+    controld_flush_rsc_updates();
     rc = cib_internal_op(fsa_cib_conn, CIB_OP_DELETE, NULL, rsc_xpath,
                          NULL, NULL, call_options | cib_xpath, user_name);
 
@@ -1007,6 +1261,7 @@ erase_lrm_history_by_op(lrm_state_t *lrm_state, lrmd_event_data_t *op)
     crm_debug("Erasing resource operation history for " CRM_OP_FMT " (call=%d)",
               op->rsc_id, op->op_type, op->interval_ms, op->call_id);
 
+    controld_flush_rsc_updates();
     fsa_cib_conn->cmds->remove(fsa_cib_conn, XML_CIB_TAG_STATUS, xml_top,
                                cib_quorum_override);
 
@@ -1068,6 +1323,7 @@ erase_lrm_history_by_id(lrm_state_t *lrm_state, const char *rsc_id,
 
     crm_debug("Erasing resource operation history for %s on %s (call=%d)",
               key, rsc_id, call_id);
+    controld_flush_rsc_updates();
     fsa_cib_conn->cmds->remove(fsa_cib_conn, op_xpath, NULL,
                                cib_quorum_override | cib_xpath);
     free(op_xpath);
@@ -1129,6 +1385,7 @@ lrm_clear_last_failure(const char *rsc_id, const char *node_name,
         if (last_failed_matches_op(entry, operation, interval_ms)) {
             lrmd_free_event(entry->failed);
             entry->failed = NULL;
+            history_changed(lrm_state, entry, FALSE);
         }
     }
 }
@@ -2169,7 +2426,7 @@ record_pending_op(const char *node_name, lrmd_rsc_info_t *rsc, lrmd_event_data_t
     crm_debug("Recording pending op " CRM_OP_FMT " on %s in the CIB",
               op->rsc_id, op->op_type, op->interval_ms, node_name);
 
-    do_update_resource(node_name, rsc, op);
+    do_update_resource(node_name, rsc, op, FALSE);
 }
 
 static void
@@ -2354,8 +2611,201 @@ cib_rsc_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void *use
     }
 }
 
+/*
+ * Batched resource history updates
+ *
+ * Every operation result (and every pending operation) is recorded in the
+ * CIB's status section. Sent one at a time, each is a separate CIB request that
+ * must be applied, diffed, and broadcast to the cluster, which adds up quickly
+ * with many recurring monitors or a mass start.
+ *
+ * So updates are merged into a single pending status update, which is sent
+ * either at the next main loop iteration (if any result in it is urgent, which
+ * still combines results that arrive together) or after at most
+ * RSC_UPDATE_DELAY_MS. Results are urgent unless they are successes that no
+ * transition can be waiting on. The pending update is also sent before any
+ * deletion of resource history, so that requests reach the CIB in order.
+ */
+
+#define RSC_UPDATE_DELAY_MS 250
+
+static xmlNode *rsc_update_batch = NULL;
+static int rsc_update_batch_count = 0;
+static crm_trigger_t *rsc_update_trigger = NULL;
+static mainloop_timer_t *rsc_update_timer = NULL;
+
+/*!
+ * \internal
+ * \brief Send any pending batched resource history update to the CIB
+ *
+ * \return Call ID of CIB update (or 0 if nothing was pending)
+ */
+int
+controld_flush_rsc_updates(void)
+{
+    int rc = pcmk_ok;
+    int call_opt = crmd_cib_smart_opt();
+
+    if (rsc_update_timer != NULL) {
+        mainloop_timer_stop(rsc_update_timer);
+    }
+    if (rsc_update_batch == NULL) {
+        return 0;
+    }
+
+    /* make it an asynchronous call and be done with it
+     *
+     * Best case:
+     *   the resource state will be discovered during
+     *   the next signup or election.
+     *
+     * Bad case:
+     *   we are shutting down and there is no DC at the time,
+     *   but then why were we shutting down then anyway?
+     *   (probably because of an internal error)
+     *
+     * Worst case:
+     *   we get shot for having resources "running" that really weren't
+     *
+     * the alternative however means blocking here for too long, which
+     * isn't acceptable
+     */
+    fsa_cib_update(XML_CIB_TAG_STATUS, rsc_update_batch, call_opt, rc, NULL);
+
+    if (rc > 0) {
+        last_resource_update = rc;
+    }
+
+    /* the return code is a call number, not an error code */
+    crm_debug("Sent batched resource state update for %d result%s "
+              CRM_XS " cib-update=%d", rsc_update_batch_count,
+              ((rsc_update_batch_count == 1)? "" : "s"), rc);
+    fsa_register_cib_callback(rc, FALSE, NULL, cib_rsc_callback);
+
+    free_xml(rsc_update_batch);
+    rsc_update_batch = NULL;
+    rsc_update_batch_count = 0;
+    return rc;
+}
+
 static int
-do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data_t * op)
+rsc_update_flush_cb(gpointer user_data)
+{
+    controld_flush_rsc_updates();
+    return TRUE;
+}
+
+static gboolean
+rsc_update_timer_cb(gpointer user_data)
+{
+    controld_flush_rsc_updates();
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Merge a resource history update into the pending batched update
+ *
+ * \param[in] update  Status update for a single resource on a single node
+ * \param[in] urgent  Whether to send the batched update without delay
+ */
+static void
+batch_rsc_update(xmlNode *update, gboolean urgent)
+{
+    xmlNode *state = first_named_child(update, XML_CIB_TAG_STATE);
+    xmlNode *resource = first_named_child(state, XML_CIB_TAG_LRM);
+    xmlNode *batch_state = NULL;
+    xmlNode *batch_resource = NULL;
+    xmlNode *op = NULL;
+
+    resource = first_named_child(resource, XML_LRM_TAG_RESOURCES);
+    resource = first_named_child(resource, XML_LRM_TAG_RESOURCE);
+    CRM_CHECK(resource != NULL, return);
+
+    if (rsc_update_batch == NULL) {
+        rsc_update_batch = create_xml_node(NULL, XML_CIB_TAG_STATUS);
+    }
+    rsc_update_batch_count++;
+
+    batch_state = find_entity(rsc_update_batch, XML_CIB_TAG_STATE, ID(state));
+    if (batch_state == NULL) {
+        add_node_copy(rsc_update_batch, state);
+
+    } else {
+        xmlNode *batch_resources = first_named_child(batch_state,
+                                                     XML_CIB_TAG_LRM);
+
+        // Keep the newest history sequence number
+        copy_in_properties(batch_resources,
+                           first_named_child(state, XML_CIB_TAG_LRM));
+        batch_resources = first_named_child(batch_resources,
+                                            XML_LRM_TAG_RESOURCES);
+        batch_resource = find_entity(batch_resources, XML_LRM_TAG_RESOURCE,
+                                     ID(resource));
+        if (batch_resource == NULL) {
+            add_node_copy(batch_resources, resource);
+        }
+    }
+
+    if (batch_resource != NULL) {
+        // A later result for the same history entry replaces the earlier one
+        copy_in_properties(batch_resource, resource);
+        for (op = first_named_child(resource, XML_LRM_TAG_RSC_OP); op != NULL;
+             op = crm_next_same_xml(op)) {
+
+            xmlNode *old = find_entity(batch_resource, XML_LRM_TAG_RSC_OP,
+                                       ID(op));
+
+            if (old != NULL) {
+                free_xml(old);
+            }
+            add_node_copy(batch_resource, op);
+        }
+    }
+
+    if (urgent) {
+        if (rsc_update_trigger == NULL) {
+            rsc_update_trigger = mainloop_add_trigger(G_PRIORITY_HIGH,
+                                                      rsc_update_flush_cb,
+                                                      NULL);
+        }
+        mainloop_set_trigger(rsc_update_trigger);
+
+    } else if (rsc_update_timer == NULL) {
+        rsc_update_timer = mainloop_timer_add("rsc_update_timer",
+                                              RSC_UPDATE_DELAY_MS, FALSE,
+                                              rsc_update_timer_cb, NULL);
+        mainloop_timer_start(rsc_update_timer);
+
+    } else if (!mainloop_timer_running(rsc_update_timer)) {
+        // Don't restart a running timer, so the delay stays bounded
+        mainloop_timer_start(rsc_update_timer);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Check whether an operation result should be recorded without delay
+ *
+ * \param[in] op       Operation result
+ * \param[in] pending  Pending operation entry for \p op (if any)
+ *
+ * \return FALSE if \p op is a success that no transition can be waiting on
+ *         (a recurring operation result other than the first), else TRUE
+ */
+static gboolean
+rsc_update_is_urgent(lrmd_event_data_t *op, struct recurring_op_s *pending)
+{
+    if ((op->op_status != PCMK_LRM_OP_DONE)
+        || (op->rc != rsc_op_expected_rc(op))) {
+        return TRUE;
+    }
+    return (op->interval_ms == 0) || (pending == NULL) || !pending->recorded;
+}
+
+static void
+do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data_t * op,
+                   gboolean urgent)
 {
 /*
   <status>
@@ -2365,12 +2815,11 @@ do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data
   <lrm_resource id=...>
   </...>
 */
-    int rc = pcmk_ok;
     xmlNode *update, *iter = NULL;
-    int call_opt = crmd_cib_smart_opt();
     const char *uuid = NULL;
+    lrm_state_t *lrm_state = NULL;
 
-    CRM_CHECK(op != NULL, return 0);
+    CRM_CHECK(op != NULL, return);
 
     iter = create_xml_node(iter, XML_CIB_TAG_STATUS);
     update = iter;
@@ -2387,8 +2836,7 @@ do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data
 
     CRM_LOG_ASSERT(uuid != NULL);
     if(uuid == NULL) {
-        rc = -EINVAL;
-        goto done;
+        goto cleanup;
     }
 
     crm_xml_add(iter, XML_ATTR_UUID,  uuid);
@@ -2398,6 +2846,14 @@ do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data
     iter = create_xml_node(iter, XML_CIB_TAG_LRM);
     crm_xml_add(iter, XML_ATTR_ID, uuid);
 
+    /* Number the change, so a later join can tell whether the CIB has it (the
+     * resource's history entry picks up the number when it is updated)
+     */
+    lrm_state = lrm_state_find(node_name);
+    if (lrm_state != NULL) {
+        add_history_stamp(lrm_state, iter, ++(lrm_state->history_seq));
+    }
+
     iter = create_xml_node(iter, XML_LRM_TAG_RESOURCES);
     iter = create_xml_node(iter, XML_LRM_TAG_RESOURCE);
     crm_xml_add(iter, XML_ATTR_ID, op->rsc_id);
@@ -2427,37 +2883,13 @@ do_update_resource(const char *node_name, lrmd_rsc_info_t * rsc, lrmd_event_data
 
     crm_log_xml_trace(update, __FUNCTION__);
 
-    /* make it an asynchronous call and be done with it
-     *
-     * Best case:
-     *   the resource state will be discovered during
-     *   the next signup or election.
-     *
-     * Bad case:
-     *   we are shutting down and there is no DC at the time,
-     *   but then why were we shutting down then anyway?
-     *   (probably because of an internal error)
-     *
-     * Worst case:
-     *   we get shot for having resources "running" that really weren't
-     *
-     * the alternative however means blocking here for too long, which
-     * isn't acceptable
-     */
-    fsa_cib_update(XML_CIB_TAG_STATUS, update, call_opt, rc, NULL);
-
-    if (rc > 0) {
-        last_resource_update = rc;
-    }
-  done:
-    /* the return code is a call number, not an error code */
-    crm_trace("Sent resource state update message: %d for %s=%u on %s",
-              rc, op->op_type, op->interval_ms, op->rsc_id);
-    fsa_register_cib_callback(rc, FALSE, NULL, cib_rsc_callback);
+    crm_trace("Batching resource state update for %s=%u on %s%s",
+              op->op_type, op->interval_ms, op->rsc_id,
+              (urgent? " (urgent)" : ""));
+    batch_rsc_update(update, urgent);
 
   cleanup:
     free_xml(update);
-    return rc;
 }
 
 void
@@ -2524,7 +2956,6 @@ process_lrm_event(lrm_state_t *lrm_state, lrmd_event_data_t *op,
     char *op_id = NULL;
     char *op_key = NULL;
 
-    int update_id = 0;
     gboolean remove = FALSE;
     gboolean removed = FALSE;
     bool need_direct_ack = FALSE;
@@ -2614,8 +3045,12 @@ process_lrm_event(lrm_state_t *lrm_state, lrmd_event_data_t *op,
         if (controld_action_is_recordable(op->op_type)) {
             if (node_name && rsc) {
                 // We should record the result, and happily, we can
-                update_id = do_update_resource(node_name, rsc, op);
+                do_update_resource(node_name, rsc, op,
+                                   rsc_update_is_urgent(op, pending));
                 need_direct_ack = FALSE;
+                if (pending != NULL) {
+                    pending->recorded = TRUE;
+                }
 
             } else if (op->rsc_deleted) {
                 /* We shouldn't record the result (likely the resource was
@@ -2731,12 +3166,11 @@ process_lrm_event(lrm_state_t *lrm_state, lrmd_event_data_t *op,
 
         case PCMK_LRM_OP_DONE:
             crm_notice("Result of %s operation for %s on %s: %d (%s) "
-                       CRM_XS " call=%d key=%s confirmed=%s cib-update=%d",
+                       CRM_XS " call=%d key=%s confirmed=%s",
                        crm_action_str(op->op_type, op->interval_ms),
                        op->rsc_id, node_name,
                        op->rc, services_ocf_exitcode_str(op->rc),
-                       op->call_id, op_key, (removed? "true" : "false"),
-                       update_id);
+                       op->call_id, op_key, (removed? "true" : "false"));
             break;
 
         case PCMK_LRM_OP_TIMEOUT:
@@ -2750,11 +3184,11 @@ process_lrm_event(lrm_state_t *lrm_state, lrmd_event_data_t *op,
 
         default:
             crm_err("Result of %s operation for %s on %s: %s "
-                    CRM_XS " call=%d key=%s confirmed=%s status=%d cib-update=%d",
+                    CRM_XS " call=%d key=%s confirmed=%s status=%d",
                     crm_action_str(op->op_type, op->interval_ms),
                     op->rsc_id, node_name,
                     services_lrm_status_str(op->op_status), op->call_id, op_key,
-                    (removed? "true" : "false"), op->op_status, update_id);
+                    (removed? "true" : "false"), op->op_status);
     }
 
     if (op->output) {
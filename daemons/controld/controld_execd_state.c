@@ -132,6 +132,11 @@ lrm_state_create(const char *node_name)
 
     state->metadata_cache = metadata_cache_new();
 
+    /* History sequence numbers are only meaningful together with the epoch,
+     * so numbering starts over (under a new epoch) whenever the state does.
+     */
+    state->history_epoch = crm_generate_uuid();
+
     g_hash_table_insert(lrm_state_table, (char *)state->node_name, state);
     return state;
 
@@ -188,6 +193,7 @@ internal_lrm_state_destroy(gpointer data)
     }
     metadata_cache_free(lrm_state->metadata_cache);
 
+    free(lrm_state->history_epoch);
     free((char *)lrm_state->node_name);
     free(lrm_state);
 }
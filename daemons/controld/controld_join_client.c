@@ -180,6 +180,9 @@ join_query_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void *
 
         crm_xml_add(reply, F_CRM_JOIN_ID, join_id);
         crm_xml_add(reply, XML_ATTR_CRM_VERSION, CRM_FEATURE_SET);
+
+        // Let the DC know we can bring our CIB up to date ourselves
+        crm_xml_add_boolean(reply, F_CRM_JOIN_SYNC, TRUE);
         send_cluster_message(crm_get_peer(0, fsa_our_dc), crm_msg_crmd, reply, TRUE);
         free_xml(reply);
     }
@@ -212,6 +215,131 @@ set_join_state(const char * start_state)
     }
 }
 
+static int join_sync_call_id = 0;
+
+// What to send the DC once our CIB has been synchronized
+struct join_confirm_s {
+    int join_id;
+    gboolean history_changes;   // whether DC accepts only history changes
+    gboolean delta;             // whether we asked for only recent changes
+};
+
+/*!
+ * \internal
+ * \brief Confirm a join by sending our resource history to the DC
+ *
+ * \param[in] join_id          Join being confirmed
+ * \param[in] history_changes  If TRUE, send only the resource history that the
+ *                             local CIB does not already have
+ * \param[in] cause            FSA cause to use for any resulting input
+ */
+static void
+send_join_confirm(int join_id, gboolean history_changes,
+                  enum crmd_fsa_cause cause)
+{
+    static gboolean first_join = TRUE;
+    xmlNode *tmp1 = NULL;
+    const char *start_state = daemon_option("node_start_state");
+
+    /* Send our status section to the DC. If the DC can take it, send only the
+     * resource history that the CIB (which has just been synchronized) does
+     * not already have.
+     */
+    if (history_changes) {
+        tmp1 = controld_query_history_changes(fsa_our_uname);
+    } else {
+        tmp1 = do_lrm_query(TRUE, fsa_our_uname);
+    }
+    if (tmp1 != NULL) {
+        xmlNode *reply = create_request(CRM_OP_JOIN_CONFIRM, tmp1, fsa_our_dc,
+                                        CRM_SYSTEM_DC, CRM_SYSTEM_CRMD, NULL);
+
+        crm_xml_add_int(reply, F_CRM_JOIN_ID, join_id);
+
+        crm_debug("Confirming join-%d: sending local operation history to %s",
+                  join_id, fsa_our_dc);
+
+        /*
+         * If this is the node's first join since the controller started on it,
+         * set its initial state (standby or member) according to the user's
+         * preference.
+         *
+         * We do not clear the LRM history here. Even if the DC failed to do it
+         * when we last left, removing them here creates a race condition if the
+         * controller is being recovered. Instead of a list of active resources
+         * from the executor, we may end up with a blank status section. If we
+         * are _NOT_ lucky, we will probe for the "wrong" instance of anonymous
+         * clones and end up with multiple active instances on the machine.
+         */
+        if (first_join && is_not_set(fsa_input_register, R_SHUTDOWN)) {
+            first_join = FALSE;
+            if (start_state) {
+                set_join_state(start_state);
+            }
+        }
+
+        send_cluster_message(crm_get_peer(0, fsa_our_dc), crm_msg_crmd, reply, TRUE);
+        free_xml(reply);
+
+        if (AM_I_DC == FALSE) {
+            register_fsa_input_adv(cause, I_NOT_DC, NULL, A_NOTHING, TRUE, __FUNCTION__);
+        }
+
+        free_xml(tmp1);
+
+    } else {
+        crm_err("Could not confirm join-%d with %s: Local operation history failed",
+                join_id, fsa_our_dc);
+        register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
+    }
+}
+
+static void
+join_sync_callback(xmlNode *msg, int call_id, int rc, xmlNode *output,
+                   void *user_data)
+{
+    struct join_confirm_s *confirm = user_data;
+
+    if (join_sync_call_id != call_id) {
+        crm_trace("CIB sync %d superseded", call_id);
+        return;
+    }
+    join_sync_call_id = 0;
+
+    if (fsa_our_dc == NULL) {
+        crm_debug("Membership is in flux, not continuing join-%d",
+                  confirm->join_id);
+        return;
+    }
+
+    if ((rc != pcmk_ok) && confirm->delta && (rc != -pcmk_err_old_data)) {
+        struct join_confirm_s *retry = calloc(1, sizeof(struct join_confirm_s));
+
+        CRM_ASSERT(retry != NULL);
+        crm_info("Syncing entire CIB from %s because recent changes could not "
+                 "be applied: %s " CRM_XS " join-%d",
+                 fsa_our_dc, pcmk_strerror(rc), confirm->join_id);
+        retry->join_id = confirm->join_id;
+        retry->history_changes = confirm->history_changes;
+        retry->delta = FALSE;
+        join_sync_call_id = controld_sync_cib_from(fsa_our_dc, FALSE);
+        fsa_register_cib_callback(join_sync_call_id, FALSE, retry,
+                                  join_sync_callback);
+        return;
+    }
+
+    if (rc != pcmk_ok) {
+        /* Our CIB is left as it is, so any resource history that the DC's
+         * does not have will not be found as a change; send all of it instead
+         */
+        crm_warn("Could not sync CIB from %s for join-%d: %s",
+                 fsa_our_dc, confirm->join_id, pcmk_strerror(rc));
+        confirm->history_changes = FALSE;
+    }
+    send_join_confirm(confirm->join_id, confirm->history_changes,
+                      C_FSA_INTERNAL);
+}
+
 /*	A_CL_JOIN_RESULT	*/
 /* aka. this is notification that we have (or have not) been accepted */
 void
@@ -220,11 +348,9 @@ do_cl_join_finalize_respond(long long action,
                             enum crmd_fsa_state cur_state,
                             enum crmd_fsa_input current_input, fsa_data_t * msg_data)
 {
-    xmlNode *tmp1 = NULL;
     gboolean was_nack = TRUE;
-    static gboolean first_join = TRUE;
+    gboolean history_changes = FALSE;
     ha_msg_input_t *input = fsa_typed_data(fsa_dt_ha_msg);
-    const char *start_state = daemon_option("node_start_state");
 
     int join_id = -1;
     const char *op = crm_element_value(input->msg, F_CRM_TASK);
@@ -263,48 +389,37 @@ do_cl_join_finalize_respond(long long action,
 
     update_dc_expected(input->msg);
 
-    /* send our status section to the DC */
-    tmp1 = do_lrm_query(TRUE, fsa_our_uname);
-    if (tmp1 != NULL) {
-        xmlNode *reply = create_request(CRM_OP_JOIN_CONFIRM, tmp1, fsa_our_dc,
-                                        CRM_SYSTEM_DC, CRM_SYSTEM_CRMD, NULL);
-
-        crm_xml_add_int(reply, F_CRM_JOIN_ID, join_id);
-
-        crm_debug("Confirming join-%d: sending local operation history to %s",
-                  join_id, fsa_our_dc);
-
-        /*
-         * If this is the node's first join since the controller started on it,
-         * set its initial state (standby or member) according to the user's
-         * preference.
-         *
-         * We do not clear the LRM history here. Even if the DC failed to do it
-         * when we last left, removing them here creates a race condition if the
-         * controller is being recovered. Instead of a list of active resources
-         * from the executor, we may end up with a blank status section. If we
-         * are _NOT_ lucky, we will probe for the "wrong" instance of anonymous
-         * clones and end up with multiple active instances on the machine.
-         */
-        if (first_join && is_not_set(fsa_input_register, R_SHUTDOWN)) {
-            first_join = FALSE;
-            if (start_state) {
-                set_join_state(start_state);
-            }
-        }
-
-        send_cluster_message(crm_get_peer(0, fsa_our_dc), crm_msg_crmd, reply, TRUE);
-        free_xml(reply);
-
-        if (AM_I_DC == FALSE) {
-            register_fsa_input_adv(cause, I_NOT_DC, NULL, A_NOTHING, TRUE, __FUNCTION__);
-        }
+    history_changes = crm_is_true(crm_element_value(input->msg,
+                                                    F_CRM_JOIN_HISTORY));
 
-        free_xml(tmp1);
+    // We only ever want the last one
+    if (join_sync_call_id > 0) {
+        crm_trace("Cancelling previous CIB sync: %d", join_sync_call_id);
+        remove_cib_op_callback(join_sync_call_id, FALSE);
+        join_sync_call_id = 0;
+    }
 
-    } else {
-        crm_err("Could not confirm join-%d with %s: Local operation history failed",
-                join_id, fsa_our_dc);
-        register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
+    /* Instead of broadcasting its CIB, the DC may ask us to fetch whatever
+     * ours is missing, in which case confirm only once we have it (the
+     * resource history changes we send are relative to it)
+     */
+    if (!AM_I_DC
+        && crm_is_true(crm_element_value(input->msg, F_CRM_JOIN_SYNC))) {
+
+        struct join_confirm_s *confirm = calloc(1, sizeof(struct join_confirm_s));
+
+        CRM_ASSERT(confirm != NULL);
+        confirm->join_id = join_id;
+        confirm->history_changes = history_changes;
+        confirm->delta = TRUE;
+
+        crm_debug("Syncing CIB from %s before confirming join-%d",
+                  fsa_our_dc, join_id);
+        join_sync_call_id = controld_sync_cib_from(fsa_our_dc, TRUE);
+        fsa_register_cib_callback(join_sync_call_id, FALSE, confirm,
+                                  join_sync_callback);
+        return;
     }
+
+    send_join_confirm(join_id, history_changes, cause);
 }
@@ -29,6 +29,15 @@ gboolean check_join_state(enum crmd_fsa_state cur_state, const char *source);
 static int current_join_id = 0;
 unsigned long long saved_ccm_membership_id = 0;
 
+// Nodes that must send their entire resource history when next acknowledged
+GHashTable *full_history_nodes = NULL;
+
+// Nodes that can bring their own CIB up to date when acknowledged
+GHashTable *self_sync_nodes = NULL;
+
+// Whether the current join's acknowledgements ask nodes to sync their CIB
+static gboolean join_self_sync = FALSE;
+
 void
 crm_update_peer_join(const char *source, crm_node_t * node, enum crm_join_phase phase)
 {
@@ -381,6 +390,16 @@ do_dc_join_filter_offer(long long action,
     } else {
         crm_debug("join-%d: Welcoming node %s (ref %s)", join_id, join_from, ref);
         crm_update_peer_join(__FUNCTION__, join_node, crm_join_integrated);
+
+        if (self_sync_nodes == NULL) {
+            self_sync_nodes = crm_str_table_new();
+        }
+        if (crm_is_true(crm_element_value(join_ack->msg, F_CRM_JOIN_SYNC))) {
+            g_hash_table_replace(self_sync_nodes, strdup(join_from),
+                                 strdup(join_from));
+        } else {
+            g_hash_table_remove(self_sync_nodes, join_from);
+        }
     }
 
     crm_update_peer_expected(__FUNCTION__, join_node, ack_nack);
@@ -396,6 +415,55 @@ do_dc_join_filter_offer(long long action,
     }
 }
 
+/*!
+ * \internal
+ * \brief Check whether every other integrated node can sync its own CIB
+ *
+ * \return TRUE if every integrated node other than the local one asked to
+ *         sync its own CIB when acknowledged, otherwise FALSE
+ */
+static gboolean
+peers_can_self_sync(void)
+{
+    GHashTableIter iter;
+    crm_node_t *peer = NULL;
+
+    g_hash_table_iter_init(&iter, crm_peer_cache);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &peer)) {
+        if ((peer->join != crm_join_integrated)
+            || safe_str_eq(peer->uname, fsa_our_uname)) {
+            continue;
+        }
+        if ((self_sync_nodes == NULL)
+            || (g_hash_table_lookup(self_sync_nodes, peer->uname) == NULL)) {
+            crm_debug("join-%d: Broadcasting CIB because %s can't sync its own",
+                      current_join_id, peer->uname);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void
+join_delta_sync_callback(xmlNode *msg, int call_id, int rc, xmlNode *output,
+                         void *user_data)
+{
+    const char *sync_from = user_data;
+
+    if ((rc != pcmk_ok) && (rc != -pcmk_err_old_data)
+        && AM_I_DC && (fsa_state == S_FINALIZE_JOIN)) {
+
+        crm_info("Syncing entire CIB from %s because recent changes could not "
+                 "be applied: %s " CRM_XS " join-%d",
+                 sync_from, pcmk_strerror(rc), current_join_id);
+        rc = controld_sync_cib_from(sync_from, FALSE);
+        fsa_register_cib_callback(rc, FALSE, strdup(sync_from),
+                                  finalize_sync_callback);
+        return;
+    }
+    finalize_sync_callback(msg, call_id, rc, output, user_data);
+}
+
 /*	A_DC_JOIN_FINALIZE	*/
 void
 do_dc_join_finalize(long long action,
@@ -436,6 +504,30 @@ do_dc_join_finalize(long long action,
         return;
     }
 
+    join_self_sync = peers_can_self_sync();
+    if (join_self_sync) {
+        /* Each node will fetch whatever it is missing from our CIB when it is
+         * acknowledged, so we need only bring our own CIB up to date
+         */
+        if (max_generation_from && is_set(fsa_input_register, R_HAVE_CIB) == FALSE) {
+            sync_from = strdup(max_generation_from);
+            set_bit(fsa_input_register, R_CIB_ASKED);
+            crm_notice("Syncing the Cluster Information Base from %s "
+                       CRM_XS " join-%d", sync_from, current_join_id);
+            crm_log_xml_notice(max_generation_xml, "Requested version");
+
+            rc = controld_sync_cib_from(sync_from, TRUE);
+            fsa_register_cib_callback(rc, FALSE, sync_from,
+                                      join_delta_sync_callback);
+
+        } else {
+            crm_info("join-%d: Nodes will sync their CIB from ours",
+                     current_join_id);
+            finalize_sync_callback(NULL, 0, pcmk_ok, NULL, fsa_our_uname);
+        }
+        return;
+    }
+
     if (max_generation_from && is_set(fsa_input_register, R_HAVE_CIB) == FALSE) {
         /* ask for the agreed best CIB */
         sync_from = strdup(max_generation_from);
@@ -496,12 +588,119 @@ join_update_complete_callback(xmlNode * msg, int call_id, int rc, xmlNode * outp
         check_join_state(fsa_state, __FUNCTION__);
 
     } else {
-        crm_err("Join update %d failed", call_id);
+        crm_err("Join update %d failed: %s", call_id, pcmk_strerror(rc));
         crm_log_xml_debug(msg, "failed");
         register_fsa_error(C_FSA_INTERNAL, I_ERROR, NULL);
     }
 }
 
+/*!
+ * \internal
+ * \brief Check whether the CIB has the resource history that changes are based on
+ *
+ * \param[in] xml_lrm  Resource history changes from a join confirmation
+ *
+ * \return TRUE if the CIB's history for the node has the history epoch and
+ *         sequence number that \p xml_lrm is relative to, otherwise FALSE
+ */
+static gboolean
+history_base_matches(xmlNode *xml_lrm)
+{
+    xmlNode *cib_lrm = controld_query_node_history(ID(xml_lrm),
+                                                   cib_no_children);
+    gboolean matches = FALSE;
+
+    if (cib_lrm != NULL) {
+        matches = safe_str_eq(crm_element_value(cib_lrm, XML_LRM_ATTR_HISTORY_EPOCH),
+                              crm_element_value(xml_lrm, XML_LRM_ATTR_HISTORY_EPOCH))
+                  && safe_str_eq(crm_element_value(cib_lrm, XML_LRM_ATTR_HISTORY_SEQ),
+                                 crm_element_value(xml_lrm, XML_LRM_ATTR_HISTORY_BASE));
+        free_xml(cib_lrm);
+    }
+    return matches;
+}
+
+#define XPATH_RSC_HISTORY "/" XML_TAG_CIB "/" XML_CIB_TAG_STATUS "/"          \
+                          XML_CIB_TAG_STATE "[@" XML_ATTR_ID "='%s']/"       \
+                          XML_CIB_TAG_LRM "/" XML_LRM_TAG_RESOURCES "/"      \
+                          XML_LRM_TAG_RESOURCE
+
+/*!
+ * \internal
+ * \brief Apply the resource history changes in a join confirmation to the CIB
+ *
+ * The CIB's history for each changed or removed resource is deleted, then the
+ * new history of the changed resources is merged in, as a single transaction so
+ * that the CIB never has the one without the other. Unchanged resources are
+ * left alone.
+ *
+ * \param[in]     join_from  Node that the changes are for
+ * \param[in,out] update     Node state update with resource history changes
+ * \param[in]     options    CIB call options for the update
+ *
+ * \return Call ID of the CIB transaction (or -errno if it could not be sent)
+ */
+static int
+update_history_changes(const char *join_from, xmlNode *update, int options)
+{
+    int call_id = 0;
+    int changed = 0;
+    GString *xpath = NULL;
+    xmlNode *transaction = NULL;
+    xmlNode *xml_lrm = first_named_child(update, XML_CIB_TAG_LRM);
+    xmlNode *xml_rsc = first_named_child(xml_lrm, XML_LRM_TAG_RESOURCES);
+    xmlNode *next = NULL;
+
+    CRM_CHECK(ID(xml_lrm) != NULL, return -EINVAL);
+    xml_remove_prop(xml_lrm, XML_LRM_ATTR_HISTORY_BASE);
+
+    for (xml_rsc = first_named_child(xml_rsc, XML_LRM_TAG_RESOURCE);
+         xml_rsc != NULL; xml_rsc = next) {
+
+        next = crm_next_same_xml(xml_rsc);
+        if (ID(xml_rsc) == NULL) {
+            continue;
+        }
+
+        if (xpath == NULL) {
+            xpath = g_string_new(NULL);
+            g_string_printf(xpath, XPATH_RSC_HISTORY "[@" XML_ATTR_ID "='%s'",
+                            ID(xml_lrm), ID(xml_rsc));
+        } else {
+            g_string_append_printf(xpath, " or @" XML_ATTR_ID "='%s'",
+                                   ID(xml_rsc));
+        }
+        changed++;
+
+        if (crm_is_true(crm_element_value(xml_rsc,
+                                          XML_LRM_ATTR_HISTORY_REMOVED))) {
+            free_xml(xml_rsc);
+        }
+    }
+
+    crm_info("Updating resource history for %d changed or removed resource%s on %s",
+             changed, ((changed == 1)? "" : "s"), join_from);
+
+    transaction = cib_transaction_new();
+    if (xpath != NULL) {
+        g_string_append_c(xpath, ']');
+        crm_trace("Deleting changed resource history " CRM_XS " xpath=%s",
+                  xpath->str);
+        cib_transaction_add(transaction, CIB_OP_DELETE, xpath->str, NULL,
+                            cib_xpath|cib_multiple);
+        g_string_free(xpath, TRUE);
+    }
+    cib_transaction_add(transaction, CIB_OP_MODIFY, XML_CIB_TAG_STATUS, update,
+                        options & cib_can_create);
+
+    // Earlier results for the node must reach the CIB before its history does
+    controld_flush_rsc_updates();
+    call_id = cib_transaction_commit(fsa_cib_conn, transaction, NULL,
+                                     options & ~cib_can_create, NULL);
+    free_xml(transaction);
+    return call_id;
+}
+
 /*	A_DC_JOIN_PROCESS_ACK	*/
 void
 do_dc_join_ack(long long action,
@@ -511,6 +710,8 @@ do_dc_join_ack(long long action,
 {
     int join_id = -1;
     int call_id = 0;
+    xmlNode *update = NULL;
+    xmlNode *xml_lrm = NULL;
     ha_msg_input_t *join_ack = fsa_typed_data(fsa_dt_ha_msg);
 
     const char *op = crm_element_value(join_ack->msg, F_CRM_TASK);
@@ -542,31 +743,51 @@ do_dc_join_ack(long long action,
     crm_info("join-%d: Updating node state to %s for %s",
              join_id, CRMD_JOINSTATE_MEMBER, join_from);
 
-    /* update CIB with the current LRM status from the node
-     * We don't need to notify the TE of these updates, a transition will
-     *   be started in due time
-     */
-    erase_status_tag(join_from, XML_CIB_TAG_LRM, cib_scope_local);
-
     if (safe_str_eq(join_from, fsa_our_uname)) {
-        xmlNode *now_dc_lrmd_state = do_lrm_query(TRUE, fsa_our_uname);
-
-        if (now_dc_lrmd_state != NULL) {
+        update = controld_query_history_changes(fsa_our_uname);
+        if (update != NULL) {
             crm_debug("Local executor state updated from query");
-            fsa_cib_update(XML_CIB_TAG_STATUS, now_dc_lrmd_state,
-                cib_scope_local | cib_quorum_override | cib_can_create, call_id, NULL);
-            free_xml(now_dc_lrmd_state);
         } else {
             crm_warn("Local executor state updated from join acknowledgement because query failed");
-            fsa_cib_update(XML_CIB_TAG_STATUS, join_ack->xml,
-                cib_scope_local | cib_quorum_override | cib_can_create, call_id, NULL);
+            update = copy_xml(join_ack->xml);
         }
     } else {
         crm_debug("Executor state for %s updated from join acknowledgement",
                   join_from);
-        fsa_cib_update(XML_CIB_TAG_STATUS, join_ack->xml,
+        update = copy_xml(join_ack->xml);
+    }
+
+    xml_lrm = first_named_child(update, XML_CIB_TAG_LRM);
+    if (crm_element_value(xml_lrm, XML_LRM_ATTR_HISTORY_BASE) == NULL) {
+        /* update CIB with the current LRM status from the node
+         * We don't need to notify the TE of these updates, a transition will
+         *   be started in due time
+         */
+        erase_status_tag(join_from, XML_CIB_TAG_LRM, cib_scope_local);
+        fsa_cib_update(XML_CIB_TAG_STATUS, update,
            cib_scope_local | cib_quorum_override | cib_can_create, call_id, NULL);
+
+    } else if (history_base_matches(xml_lrm)) {
+        call_id = update_history_changes(join_from, update,
+                                         cib_scope_local | cib_quorum_override | cib_can_create);
+
+    } else {
+        /* The node's changes are relative to history that the CIB no longer
+         * has, so start its join over, this time asking for all of it.
+         */
+        crm_notice("join-%d: Requesting full resource history from %s "
+                   "because CIB has changed", join_id, join_from);
+        if (full_history_nodes == NULL) {
+            full_history_nodes = crm_str_table_new();
+        }
+        g_hash_table_replace(full_history_nodes, strdup(join_from),
+                             strdup(join_from));
+        crm_update_peer_join(__FUNCTION__, peer, crm_join_none);
+        register_fsa_input_before(C_FSA_INTERNAL, I_NODE_JOIN, NULL);
+        free_xml(update);
+        return;
     }
+    free_xml(update);
 
     fsa_register_cib_callback(call_id, FALSE, NULL, join_update_complete_callback);
     crm_debug("join-%d: Registered callback for CIB status update %d", join_id, call_id);
@@ -616,6 +837,19 @@ finalize_join_for(gpointer key, gpointer value, gpointer user_data)
     crm_debug("join-%d: ACK'ing join request from %s",
               current_join_id, join_to);
     crm_xml_add(acknak, CRM_OP_JOIN_ACKNAK, XML_BOOLEAN_TRUE);
+
+    /* Let the node send only the resource history that the CIB doesn't
+     * already have, unless an earlier attempt at that failed
+     */
+    if ((full_history_nodes == NULL)
+        || !g_hash_table_remove(full_history_nodes, join_to)) {
+        crm_xml_add_boolean(acknak, F_CRM_JOIN_HISTORY, TRUE);
+    }
+
+    // Our CIB is now the cluster's, so have the node fetch what it lacks
+    if (join_self_sync) {
+        crm_xml_add_boolean(acknak, F_CRM_JOIN_SYNC, TRUE);
+    }
     crm_update_peer_join(__FUNCTION__, join_node, crm_join_finalized);
     crm_update_peer_expected(__FUNCTION__, join_node, CRMD_JOINSTATE_MEMBER);
 
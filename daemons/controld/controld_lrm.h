@@ -27,6 +27,9 @@ typedef struct resource_history_s {
      * holds the parameters that should be used for the next stop
      * cmd on this resource. */
     GHashTable *stop_params;
+
+    long long seq;      // history sequence number as of last change
+    char *digest;       // digest of recorded history (NULL if not known)
 } rsc_history_t;
 
 void history_free(gpointer data);
@@ -43,6 +46,7 @@ struct recurring_op_s {
     char *op_key;
     char *user_data;
     GHashTable *params;
+    gboolean recorded;  // whether a result has been recorded in the CIB
 };
 
 typedef struct lrm_state_s {
@@ -56,6 +60,9 @@ typedef struct lrm_state_s {
     GHashTable *rsc_info_cache;
     GHashTable *metadata_cache; // key = class[:provider]:agent, value = ra_metadata_s
 
+    char *history_epoch;        // identifies this instance's history numbering
+    long long history_seq;      // last history sequence number used
+
     int num_lrm_register_fails;
 } lrm_state_t;
 
@@ -163,3 +170,6 @@ gboolean remote_ra_controlling_guest(lrm_state_t * lrm_state);
 
 void process_lrm_event(lrm_state_t *lrm_state, lrmd_event_data_t *op,
                        struct recurring_op_s *pending, xmlNode *action_xml);
+
+int controld_flush_rsc_updates(void);
+xmlNode *controld_query_history_changes(const char *node_name);
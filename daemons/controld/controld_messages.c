@@ -1008,15 +1008,22 @@ handle_response(xmlNode * stored_msg)
         if (msg_ref == NULL) {
             crm_err("%s - Ignoring calculation with no reference", op);
 
+        } else if (safe_str_eq(msg_ref, fsa_pe_ref)
+                   && crm_is_true(crm_element_value(stored_msg,
+                                                    F_CRM_SCHED_RESYNC))) {
+            controld_resend_sched_input();
+
         } else if (safe_str_eq(msg_ref, fsa_pe_ref)) {
             ha_msg_input_t fsa_input;
 
             controld_stop_sched_timer();
+            controld_sched_reply_received(TRUE);
             fsa_input.msg = stored_msg;
             register_fsa_input_later(C_IPC_MESSAGE, I_PE_SUCCESS, &fsa_input);
 
         } else {
             crm_info("%s calculation %s is obsolete", op, msg_ref);
+            controld_sched_reply_received(FALSE);
         }
 
     } else if (strcmp(op, CRM_OP_VOTE) == 0
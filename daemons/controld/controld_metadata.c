@@ -116,6 +116,7 @@ metadata_cache_fini()
         version_format_regex = NULL;
     }
 #endif
+    pcmk__metadata_cache_cleanup();
 }
 
 #if ENABLE_VERSIONED_ATTRS
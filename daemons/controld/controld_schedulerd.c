@@ -10,6 +10,8 @@
 #include <crm_internal.h>
 
 #include <unistd.h>  /* pid_t, sleep, ssize_t */
+#include <string.h>  /* memcmp, memcpy, strlen */
+#include <time.h>
 
 #include <crm/cib.h>
 #include <crm/cluster.h>
@@ -21,6 +23,49 @@
 
 static mainloop_io_t *pe_subsystem = NULL;
 
+/* The scheduler keeps the last input it was sent, so once it has one, the
+ * controller sends only (v2) patches against it. The controller keeps its own
+ * copy of that input here, and discards it whenever the scheduler might not
+ * have the same one (a new connection, or a patch that did not apply), so that
+ * the next input is sent in full.
+ */
+static xmlNode *sched_baseline = NULL;
+
+/* The patches are not calculated by comparing the new input with the last
+ * one, which takes time quadratic in the number of siblings and so is too
+ * slow for exactly the large CIBs where patching pays off. Instead, the CIB
+ * manager's own patchsets for every change since the last input are kept here
+ * (oldest first) and passed along, followed by a patch for any of the
+ * controller's own changes to the input.
+ */
+static GQueue *sched_changes = NULL;
+
+// Send the next input in full rather than replaying more changes than this
+#define SCHED_PATCH_MAX_CHANGES 1000
+
+// Size of the last input sent in full, to compare patches against
+static size_t sched_full_bytes = 0;
+
+static void
+reset_sched_changes(void)
+{
+    if (sched_changes != NULL) {
+        xmlNode *patchset = NULL;
+
+        while ((patchset = g_queue_pop_head(sched_changes)) != NULL) {
+            free_xml(patchset);
+        }
+    }
+}
+
+static void
+reset_sched_baseline(void)
+{
+    free_xml(sched_baseline);
+    sched_baseline = NULL;
+    reset_sched_changes();
+}
+
 /*!
  * \internal
  * \brief Close any scheduler connection and free associated memory
@@ -29,6 +74,12 @@ void
 pe_subsystem_free(void)
 {
     clear_bit(fsa_input_register, R_PE_REQUIRED);
+    reset_sched_baseline();
+    if (sched_changes != NULL) {
+        g_queue_free(sched_changes);
+        sched_changes = NULL;
+    }
+    controld_cancel_sched_run();
     if (pe_subsystem) {
         controld_expect_sched_reply(NULL);
         mainloop_del_ipc_client(pe_subsystem);
@@ -59,7 +110,8 @@ save_cib_contents(xmlNode *msg, int call_id, int rc, xmlNode *output,
     CRM_CHECK(id != NULL, return);
 
     if (rc == pcmk_ok) {
-        char *filename = crm_strdup_printf(PE_STATE_DIR "/pe-core-%s.bz2", id);
+        char *filename = crm_strdup_printf(PE_STATE_DIR "/pe-core-%s.%s", id,
+                                           pcmk__codec_ext(pcmk__file_codec()));
 
         if (write_xml_file(output, filename, TRUE) < 0) {
             crm_err("Could not save Cluster Information Base to %s after scheduler crash",
@@ -83,6 +135,7 @@ pe_ipc_destroy(gpointer user_data)
 {
     // If we aren't connected to the scheduler, we can't expect a reply
     controld_expect_sched_reply(NULL);
+    reset_sched_baseline();
 
     if (is_set(fsa_input_register, R_PE_REQUIRED)) {
         int rc = pcmk_ok;
@@ -151,6 +204,7 @@ pe_subsystem_new()
     };
 
     set_bit(fsa_input_register, R_PE_REQUIRED);
+    reset_sched_baseline();
     pe_subsystem = mainloop_add_ipc_client(CRM_SYSTEM_PENGINE,
                                            G_PRIORITY_DEFAULT,
                                            5 * 1024 * 1024 /* 5MB */,
@@ -217,6 +271,222 @@ int fsa_pe_query = 0;
 char *fsa_pe_ref = NULL;
 static mainloop_timer_t *controld_sched_timer = NULL;
 
+/*
+ * Scheduler run coalescing
+ *
+ * Nearly every change to the cluster (an operation result, a node attribute
+ * change, a configuration change) aborts the current transition and asks for a
+ * new scheduler run. During a burst of changes, such as a mass failover, each
+ * run is usually thrown away when the next change arrives, before its result
+ * can be used.
+ *
+ * So when requests arrive in quick succession, the new run is delayed for a
+ * short window, which restarts with each further request. The window is half
+ * the recent scheduler run time (but at least SCHED_DEBOUNCE_MIN_MS), scaled up
+ * by the recent request rate. A run is never delayed longer in total than the
+ * scheduler-max-delay cluster option, and an isolated request is not delayed at
+ * all. A configured transition-delay overrides all of this with its fixed
+ * delay.
+ */
+
+#define SCHED_DEBOUNCE_MIN_MS   10
+#define SCHED_RATE_WINDOW_MS    1000    // period over which the rate decays
+#define SCHED_RATE_BURST        1500    // rate (x1000) that counts as a burst
+#define SCHED_RATE_MAX          4000    // rate (x1000) beyond which not to scale
+
+static struct sched_coalesce_s {
+    mainloop_timer_t *timer;    // delayed run
+    guint max_delay_ms;         // scheduler-max-delay
+    guint runtime_ms;           // moving average of scheduler run time
+    long long sent_ms;          // when current scheduler request was sent
+    long long first_ms;         // when delayed run was first requested
+    long long last_ms;          // when a run was last requested
+    int rate;                   // decaying count (x1000) of recent requests
+    unsigned int pending;       // requests folded into the delayed run
+
+    unsigned long long requested;   // runs requested
+    unsigned long long coalesced;   // requests folded into another run
+    unsigned long long discarded;   // scheduler results thrown away
+} coalesce = { NULL, 2000, 0, };
+
+// Current time in milliseconds, for measuring intervals
+static long long
+sched_now_ms(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000);
+    }
+#endif
+    return time(NULL) * 1000LL;
+}
+
+/*!
+ * \internal
+ * \brief Set the maximum time a scheduler run may be delayed for coalescing
+ *
+ * \param[in] value  New value of scheduler-max-delay cluster option
+ */
+void
+controld_set_sched_max_delay(const char *value)
+{
+    long long ms = crm_get_msec(value);
+
+    coalesce.max_delay_ms = (guint) QB_MAX(ms, 0);
+    crm_debug("Scheduler runs may be delayed up to %ums to coalesce changes",
+              coalesce.max_delay_ms);
+}
+
+static void
+log_coalesce_stats(int log_level, const char *text)
+{
+    do_crm_log(log_level, "%s " CRM_XS " requested=%llu coalesced=%llu "
+               "discarded=%llu runtime=%ums",
+               text, coalesce.requested, coalesce.coalesced,
+               coalesce.discarded, coalesce.runtime_ms);
+}
+
+static gboolean
+sched_run_popped(gpointer user_data)
+{
+    if (coalesce.pending > 1) {
+        char *text = crm_strdup_printf("Coalesced %u scheduler requests "
+                                       "over %lldms", coalesce.pending,
+                                       sched_now_ms() - coalesce.first_ms);
+
+        log_coalesce_stats(LOG_DEBUG, text);
+        free(text);
+    }
+    coalesce.pending = 0;
+    if (AM_I_DC) {
+        register_fsa_input(C_FSA_INTERNAL, I_PE_CALC, NULL);
+    }
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Cancel any delayed scheduler run
+ */
+void
+controld_cancel_sched_run(void)
+{
+    if (coalesce.requested > 0) {
+        log_coalesce_stats(LOG_INFO, "Scheduler run statistics");
+    }
+    if (coalesce.timer != NULL) {
+        mainloop_timer_del(coalesce.timer);
+        coalesce.timer = NULL;
+    }
+    coalesce.pending = 0;
+}
+
+static guint
+sched_delay_ms(long long now)
+{
+    long long remaining = coalesce.max_delay_ms - (now - coalesce.first_ms);
+    long long delay = 0;
+
+    if ((coalesce.rate < SCHED_RATE_BURST) || (remaining <= 0)) {
+        return 0;
+    }
+    delay = QB_MAX(coalesce.runtime_ms / 2, SCHED_DEBOUNCE_MIN_MS);
+    delay = delay * QB_MIN(coalesce.rate, SCHED_RATE_MAX) / 1000;
+    return (guint) QB_MIN(delay, remaining);
+}
+
+/*!
+ * \internal
+ * \brief Request a new scheduler run, coalescing bursts of requests
+ */
+void
+controld_request_sched_run(void)
+{
+    long long now = sched_now_ms();
+    long long elapsed = now - coalesce.last_ms;
+    guint delay_ms = 0;
+
+    coalesce.requested++;
+    coalesce.last_ms = now;
+    if ((elapsed < 0) || (elapsed >= SCHED_RATE_WINDOW_MS)) {
+        coalesce.rate = 0;
+    } else {
+        coalesce.rate = coalesce.rate * (SCHED_RATE_WINDOW_MS - elapsed)
+                        / SCHED_RATE_WINDOW_MS;
+    }
+    coalesce.rate += 1000;
+
+    if (fsa_state == S_POLICY_ENGINE) {
+        /* A CIB query or scheduler request is already in flight, and its
+         * result no longer reflects the CIB, so discard any reply to it. The
+         * (possibly delayed) run requested below replaces it, so a burst of
+         * changes during a run is still coalesced.
+         */
+        controld_expect_sched_reply(NULL);
+    }
+
+    if (transition_timer->period_ms > 0) {
+        crm_timer_stop(transition_timer);
+        crm_timer_start(transition_timer);
+        return;
+    }
+
+    if (coalesce.pending > 0) {
+        coalesce.coalesced++;
+    } else {
+        coalesce.first_ms = now;
+    }
+    coalesce.pending++;
+
+    delay_ms = sched_delay_ms(now);
+    if (delay_ms == 0) {
+        if (coalesce.timer != NULL) {
+            mainloop_timer_stop(coalesce.timer);
+        }
+        sched_run_popped(NULL);
+        return;
+    }
+
+    crm_trace("Delaying scheduler run %ums in state %s "
+              CRM_XS " pending=%u coalesced=%llu",
+              delay_ms, fsa_state2string(fsa_state), coalesce.pending,
+              coalesce.coalesced);
+    if (coalesce.timer == NULL) {
+        coalesce.timer = mainloop_timer_add("scheduler_run_timer", delay_ms,
+                                            FALSE, sched_run_popped, NULL);
+    } else {
+        mainloop_timer_set_period(coalesce.timer, delay_ms);
+    }
+    mainloop_timer_start(coalesce.timer);
+}
+
+/*!
+ * \internal
+ * \brief Account for a reply from the scheduler
+ *
+ * \param[in] current  TRUE if the reply is to the request currently expected,
+ *                     FALSE if it is obsolete and will be discarded
+ */
+void
+controld_sched_reply_received(gboolean current)
+{
+    if (!current) {
+        coalesce.discarded++;
+
+    } else if (coalesce.sent_ms > 0) {
+        long long runtime = sched_now_ms() - coalesce.sent_ms;
+
+        coalesce.sent_ms = 0;
+        if (runtime >= 0) {
+            // Weight the latest run time by one quarter
+            coalesce.runtime_ms = (guint) ((3LL * coalesce.runtime_ms
+                                            + runtime) / 4);
+        }
+    }
+}
+
 // @TODO Make this a configurable cluster option if there's demand for it
 #define SCHED_TIMEOUT_MS (120000)
 
@@ -269,6 +539,7 @@ controld_expect_sched_reply(xmlNode *msg)
     if (msg) {
         ref = crm_element_value_copy(msg, XML_ATTR_REFERENCE);
         CRM_ASSERT(ref != NULL);
+        coalesce.sent_ms = sched_now_ms();
 
         if (controld_sched_timer == NULL) {
             controld_sched_timer = mainloop_timer_add("scheduler_reply_timer",
@@ -297,6 +568,22 @@ controld_free_sched_timer()
     }
 }
 
+/*!
+ * \internal
+ * \brief Send the scheduler its next input in full
+ *
+ * This is called when the scheduler could not apply a patch to its last input,
+ * so it must be re-invoked with the full CIB.
+ */
+void
+controld_resend_sched_input(void)
+{
+    crm_notice("Scheduler could not apply CIB patch, resending full CIB");
+    controld_expect_sched_reply(NULL);
+    reset_sched_baseline();
+    register_fsa_action(A_PE_INVOKE);
+}
+
 /*	 A_PE_INVOKE	*/
 void
 do_pe_invoke(long long action,
@@ -399,10 +686,173 @@ force_local_option(xmlNode *xml, const char *attr_name, const char *attr_value)
     freeXpathObject(xpathObj);
 }
 
+/*!
+ * \internal
+ * \brief Remember a CIB change for the scheduler's next input
+ *
+ * \param[in] msg  CIB diff notification
+ */
+void
+controld_sched_cib_changed(xmlNode *msg)
+{
+    int rc = pcmk_ok;
+    int format = 1;
+    xmlNode *patchset = NULL;
+
+    if (sched_baseline == NULL) {
+        return; // Next input will be sent in full anyway
+    }
+
+    crm_element_value_int(msg, F_CIB_RC, &rc);
+    patchset = get_message_xml(msg, F_CIB_UPDATE_RESULT);
+    if ((rc < pcmk_ok) || (patchset == NULL)) {
+        return; // Nothing changed
+    }
+
+    crm_element_value_int(patchset, "format", &format);
+    if (format != 2) {
+        crm_trace("Next scheduler input will be sent in full: "
+                  "CIB changed with v%d patchset", format);
+        reset_sched_baseline();
+        return;
+    }
+
+    if (sched_changes == NULL) {
+        sched_changes = g_queue_new();
+    } else if (g_queue_get_length(sched_changes) >= SCHED_PATCH_MAX_CHANGES) {
+        crm_trace("Next scheduler input will be sent in full: "
+                  "more than %d CIB changes", SCHED_PATCH_MAX_CHANGES);
+        reset_sched_baseline();
+        return;
+    }
+    g_queue_push_tail(sched_changes, copy_xml(patchset));
+}
+
+/*!
+ * \internal
+ * \brief Add the controller's own settings to a scheduler input
+ *
+ * \param[in,out] input     Scheduler input
+ * \param[in]     watchdog  Process ID of sbd (or 0 if none)
+ */
+static void
+set_sched_input_options(xmlNode *input, pid_t watchdog)
+{
+    crm_xml_add(input, XML_ATTR_DC_UUID, fsa_our_uuid);
+    crm_xml_add_int(input, XML_ATTR_HAVE_QUORUM, fsa_has_quorum);
+
+    force_local_option(input, XML_ATTR_HAVE_WATCHDOG, watchdog?"true":"false");
+
+    if (ever_had_quorum && crm_have_quorum == FALSE) {
+        crm_xml_add_int(input, XML_ATTR_QUORUM_PANIC, 1);
+    } else {
+        xml_remove_prop(input, XML_ATTR_QUORUM_PANIC);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Create patches from the scheduler's last input to a new one
+ *
+ * The CIB changes since the last input are applied to the controller's copy of
+ * it, followed by the controller's own settings, and the result is checked
+ * against the new input. The cost is proportional to the size of the changes
+ * plus one digest of the new input, however large the CIB.
+ *
+ * \param[in]  input     New scheduler input
+ * \param[in]  watchdog  Process ID of sbd (or 0 if none)
+ * \param[out] changes   Where to store the number of CIB changes patched
+ *
+ * \return Newly allocated element containing v2 patchsets to apply in order
+ *         (the last with the digest of \p input), or NULL if the scheduler has
+ *         no last input to patch or the CIB changes since it do not lead to
+ *         \p input (in which case it should be sent in full)
+ */
+static xmlNode *
+create_sched_patch(xmlNode *input, pid_t watchdog, int *changes)
+{
+    int current[3] = { 0, 0, 0 };
+    int target[3] = { 0, 0, 0 };
+    char *digest = NULL;
+    const char *reason = NULL;
+    xmlNode *patches = NULL;
+    xmlNode *patch = NULL;
+
+    *changes = 0;
+    if (sched_baseline == NULL) {
+        return NULL;
+    }
+
+    cib_version_details(sched_baseline, &current[0], &current[1], &current[2]);
+    cib_version_details(input, &target[0], &target[1], &target[2]);
+    patches = create_xml_node(NULL, XML_TAG_SCHED_PATCHES);
+
+    while ((sched_changes != NULL) && (reason == NULL)
+           && ((patch = g_queue_pop_head(sched_changes)) != NULL)) {
+        int add[3] = { 0, 0, 0 };
+        int del[3] = { 0, 0, 0 };
+
+        xml_patch_versions(patch, add, del);
+        if (memcmp(del, current, sizeof(current)) != 0) {
+            reason = "CIB changes are not contiguous";
+
+        } else {
+            // The digest is of the CIB, not the scheduler input
+            xml_remove_prop(patch, XML_ATTR_DIGEST);
+            if (xml_apply_patchset(sched_baseline, patch, FALSE) != pcmk_ok) {
+                reason = "CIB change does not apply to last input";
+            } else {
+                add_node_copy(patches, patch);
+                memcpy(current, add, sizeof(current));
+                ++(*changes);
+            }
+        }
+        free_xml(patch);
+    }
+    if ((reason == NULL) && (memcmp(current, target, sizeof(current)) != 0)) {
+        reason = "CIB changes do not lead to new input";
+    }
+
+    if (reason == NULL) {
+        xml_track_changes(sched_baseline, NULL, NULL, FALSE);
+        set_sched_input_options(sched_baseline, watchdog);
+        patch = xml_create_patchset(2, sched_baseline, sched_baseline, NULL,
+                                    FALSE);
+        xml_accept_changes(sched_baseline);
+        if (patch == NULL) {
+            // Nothing changed, but the digest must still be checked
+            patch = create_xml_node(NULL, XML_TAG_DIFF);
+            crm_xml_add_int(patch, "format", 2);
+        }
+        patchset_process_digest(patch, sched_baseline, sched_baseline, TRUE);
+
+        digest = calculate_xml_versioned_digest(input, FALSE, TRUE,
+                                                crm_element_value(input,
+                                                                  XML_ATTR_CRM_VERSION));
+        if (safe_str_neq(digest, crm_element_value(patch, XML_ATTR_DIGEST))) {
+            reason = "CIB changes do not lead to new input";
+        } else {
+            add_node_copy(patches, patch);
+        }
+        free_xml(patch);
+        free(digest);
+    }
+
+    if (reason != NULL) {
+        crm_info("Sending scheduler input in full: %s", reason);
+        free_xml(patches);
+        reset_sched_baseline();
+        return NULL;
+    }
+    return patches;
+}
+
 static void
 do_pe_invoke_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void *user_data)
 {
     xmlNode *cmd = NULL;
+    xmlNode *patch = NULL;
+    int changes = 0;
     pid_t watchdog = pcmk_locate_sbd();
 
     if (rc != pcmk_ok) {
@@ -443,26 +893,53 @@ do_pe_invoke_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void
      * scheduler is invoked */
     crm_peer_caches_refresh(output);
 
-    crm_xml_add(output, XML_ATTR_DC_UUID, fsa_our_uuid);
-    crm_xml_add_int(output, XML_ATTR_HAVE_QUORUM, fsa_has_quorum);
+    set_sched_input_options(output, watchdog);
 
-    force_local_option(output, XML_ATTR_HAVE_WATCHDOG, watchdog?"true":"false");
-
-    if (ever_had_quorum && crm_have_quorum == FALSE) {
-        crm_xml_add_int(output, XML_ATTR_QUORUM_PANIC, 1);
+    patch = create_sched_patch(output, watchdog, &changes);
+    if (patch != NULL) {
+        cmd = create_request(CRM_OP_PECALC, patch, NULL, CRM_SYSTEM_PENGINE,
+                             CRM_SYSTEM_DC, NULL);
+        crm_xml_add(cmd, F_CRM_SCHED_PATCH, XML_BOOLEAN_TRUE);
+    } else {
+        cmd = create_request(CRM_OP_PECALC, output, NULL, CRM_SYSTEM_PENGINE,
+                             CRM_SYSTEM_DC, NULL);
     }
 
-    cmd = create_request(CRM_OP_PECALC, output, NULL, CRM_SYSTEM_PENGINE, CRM_SYSTEM_DC, NULL);
-
     rc = pe_subsystem_send(cmd);
     if (rc < 0) {
         crm_err("Could not contact the scheduler: %s " CRM_XS " rc=%d",
                 pcmk_strerror(rc), rc);
+        reset_sched_baseline();
         register_fsa_error_adv(C_FSA_INTERNAL, I_ERROR, NULL, NULL, __FUNCTION__);
     } else {
+        char *sent = dump_xml_unformatted((patch != NULL)? patch : output);
+        size_t sent_bytes = (sent == NULL)? 0 : strlen(sent);
+
+        free(sent);
+        if (patch == NULL) {
+            /* Keep a copy for patching the next input against (a patched
+             * input has already been applied to the copy)
+             */
+            reset_sched_baseline();
+            sched_baseline = copy_xml(output);
+            sched_full_bytes = sent_bytes;
+        }
         controld_expect_sched_reply(cmd);
-        crm_debug("Invoking the scheduler: query=%d, ref=%s, seq=%llu, quorate=%d",
-                  fsa_pe_query, fsa_pe_ref, crm_peer_seq, fsa_has_quorum);
+        if (patch != NULL) {
+            crm_debug("Invoking the scheduler: query=%d, ref=%s, seq=%llu, "
+                      "quorate=%d (patch of %d CIB change%s, %llu bytes; "
+                      "last full input %llu bytes)",
+                      fsa_pe_query, fsa_pe_ref, crm_peer_seq, fsa_has_quorum,
+                      changes, ((changes == 1)? "" : "s"),
+                      (unsigned long long) sent_bytes,
+                      (unsigned long long) sched_full_bytes);
+        } else {
+            crm_debug("Invoking the scheduler: query=%d, ref=%s, seq=%llu, "
+                      "quorate=%d (full input, %llu bytes)",
+                      fsa_pe_query, fsa_pe_ref, crm_peer_seq, fsa_has_quorum,
+                      (unsigned long long) sent_bytes);
+        }
     }
+    free_xml(patch);
     free_xml(cmd);
 }
@@ -13,6 +13,7 @@
 
 #include <crm/crm.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include <crm/msg_xml.h>
 #include <crm/cluster.h>        /* For ONLINESTATUS etc */
 
@@ -28,6 +29,15 @@ crm_trigger_t *transition_trigger = NULL;
 /* #define RSC_OP_TEMPLATE "//"XML_TAG_DIFF_ADDED"//"XML_TAG_CIB"//"XML_CIB_TAG_STATE"[@uname='%s']"//"XML_LRM_TAG_RSC_OP"[@id='%s]" */
 #define RSC_OP_TEMPLATE "//"XML_TAG_DIFF_ADDED"//"XML_TAG_CIB"//"XML_LRM_TAG_RSC_OP"[@id='%s']"
 
+/* Constant expressions used to search v1 diffs, compiled on first use */
+static xmlXPathCompExprPtr tickets_added = NULL;
+static xmlXPathCompExprPtr tickets_removed = NULL;
+static xmlXPathCompExprPtr attrs_added = NULL;
+static xmlXPathCompExprPtr attrs_removed = NULL;
+static xmlXPathCompExprPtr rsc_added = NULL;
+static xmlXPathCompExprPtr ops_added = NULL;
+static xmlXPathCompExprPtr ops_removed = NULL;
+
 static void
 te_update_diff_v1(const char *event, xmlNode *diff)
 {
@@ -44,8 +54,9 @@ te_update_diff_v1(const char *event, xmlNode *diff)
 
     /* Tickets Attributes - Added/Updated */
     xpathObj =
-        xpath_search(diff,
-                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_ADDED "//" XML_CIB_TAG_TICKETS);
+        pcmk__xpath_search_const(diff,
+                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_ADDED "//" XML_CIB_TAG_TICKETS,
+                     &tickets_added);
     if (numXpathResults(xpathObj) > 0) {
         xmlNode *aborted = getXpathResult(xpathObj, 0);
 
@@ -57,8 +68,9 @@ te_update_diff_v1(const char *event, xmlNode *diff)
 
     /* Tickets Attributes - Removed */
     xpathObj =
-        xpath_search(diff,
-                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_REMOVED "//" XML_CIB_TAG_TICKETS);
+        pcmk__xpath_search_const(diff,
+                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_REMOVED "//" XML_CIB_TAG_TICKETS,
+                     &tickets_removed);
     if (numXpathResults(xpathObj) > 0) {
         xmlNode *aborted = getXpathResult(xpathObj, 0);
 
@@ -69,9 +81,10 @@ te_update_diff_v1(const char *event, xmlNode *diff)
 
     /* Transient Attributes - Added/Updated */
     xpathObj =
-        xpath_search(diff,
+        pcmk__xpath_search_const(diff,
                      "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_ADDED "//"
-                     XML_TAG_TRANSIENT_NODEATTRS "//" XML_CIB_TAG_NVPAIR);
+                     XML_TAG_TRANSIENT_NODEATTRS "//" XML_CIB_TAG_NVPAIR,
+                     &attrs_added);
     max = numXpathResults(xpathObj);
 
     for (lpc = 0; lpc < max; lpc++) {
@@ -94,9 +107,9 @@ te_update_diff_v1(const char *event, xmlNode *diff)
 
     /* Transient Attributes - Removed */
     xpathObj =
-        xpath_search(diff,
+        pcmk__xpath_search_const(diff,
                      "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_REMOVED "//"
-                     XML_TAG_TRANSIENT_NODEATTRS);
+                     XML_TAG_TRANSIENT_NODEATTRS, &attrs_removed);
     if (numXpathResults(xpathObj) > 0) {
         xmlNode *aborted = getXpathResult(xpathObj, 0);
 
@@ -119,10 +132,11 @@ te_update_diff_v1(const char *event, xmlNode *diff)
      * the cluster will stall waiting for them and time out the operation.
      */
     if (transition_graph->pending == 0) {
-        xpathObj = xpath_search(diff,
-                                "//" F_CIB_UPDATE_RESULT
-                                "//" XML_TAG_DIFF_ADDED
-                                "//" XML_LRM_TAG_RESOURCE);
+        xpathObj = pcmk__xpath_search_const(diff,
+                                            "//" F_CIB_UPDATE_RESULT
+                                            "//" XML_TAG_DIFF_ADDED
+                                            "//" XML_LRM_TAG_RESOURCE,
+                                            &rsc_added);
         max = numXpathResults(xpathObj);
         if (max > 1) {
             crm_debug("Ignoring resource operation updates due to history refresh of %d resources",
@@ -136,8 +150,9 @@ te_update_diff_v1(const char *event, xmlNode *diff)
 
     /* Process operation updates */
     xpathObj =
-        xpath_search(diff,
-                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_ADDED "//" XML_LRM_TAG_RSC_OP);
+        pcmk__xpath_search_const(diff,
+                     "//" F_CIB_UPDATE_RESULT "//" XML_TAG_DIFF_ADDED "//" XML_LRM_TAG_RSC_OP,
+                     &ops_added);
     max = numXpathResults(xpathObj);
     if (max > 0) {
         int lpc = 0;
@@ -152,7 +167,10 @@ te_update_diff_v1(const char *event, xmlNode *diff)
     freeXpathObject(xpathObj);
 
     /* Detect deleted (as opposed to replaced or added) actions - eg. crm_resource -C */
-    xpathObj = xpath_search(diff, "//" XML_TAG_DIFF_REMOVED "//" XML_LRM_TAG_RSC_OP);
+    xpathObj = pcmk__xpath_search_const(diff,
+                                        "//" XML_TAG_DIFF_REMOVED
+                                        "//" XML_LRM_TAG_RSC_OP,
+                                        &ops_removed);
     max = numXpathResults(xpathObj);
     for (lpc = 0; lpc < max; lpc++) {
         int path_max = 0;
@@ -249,123 +267,62 @@ process_resource_updates(const char *node, xmlNode *xml, xmlNode *change,
     }
 }
 
-#define NODE_PATT "/lrm[@id="
-static char *get_node_from_xpath(const char *xpath) 
-{
-    char *nodeid = NULL;
-    char *tmp = strstr(xpath, NODE_PATT);
-
-    if(tmp) {
-        tmp += strlen(NODE_PATT);
-        tmp += 1;
-
-        nodeid = strdup(tmp);
-        tmp = strstr(nodeid, "\'");
-        CRM_ASSERT(tmp);
-        tmp[0] = 0;
-    }
-    return nodeid;
-}
-
-static char *extract_node_uuid(const char *xpath) 
-{
-    char *mutable_path = strdup(xpath);
-    char *node_uuid = NULL;
-    char *search = NULL;
-    char *match = NULL;
-
-    match = strstr(mutable_path, "node_state[@id=\'");
-    if (match == NULL) {
-        free(mutable_path);
-        return NULL;
-    }
-    match += strlen("node_state[@id=\'");
-
-    search = strchr(match, '\'');
-    if (search == NULL) {
-        free(mutable_path);
-        return NULL;
-    }
-    search[0] = 0;
-
-    node_uuid = strdup(match);
-    free(mutable_path);
-    return node_uuid;
-}
-
 static void
-abort_unless_down(const char *xpath, const char *op, xmlNode *change,
-                  const char *reason)
+abort_unless_down(const pcmk__patch_change_t *change, const char *reason)
 {
-    char *node_uuid = NULL;
     crm_action_t *down = NULL;
 
-    if(safe_str_neq(op, "delete")) {
-        abort_transition(INFINITY, tg_restart, reason, change);
+    if (safe_str_neq(change->op, "delete")) {
+        abort_transition(INFINITY, tg_restart, reason, change->change);
         return;
     }
 
-    node_uuid = extract_node_uuid(xpath);
-    if(node_uuid == NULL) {
-        crm_err("Could not extract node ID from %s", xpath);
-        abort_transition(INFINITY, tg_restart, reason, change);
+    if (change->node_id == NULL) {
+        crm_err("Could not extract node ID from %s", change->path);
+        abort_transition(INFINITY, tg_restart, reason, change->change);
         return;
     }
 
-    down = match_down_event(node_uuid);
+    down = match_down_event(change->node_id);
     if (down == NULL) {
-        crm_trace("Not expecting %s to be down (%s)", node_uuid, xpath);
-        abort_transition(INFINITY, tg_restart, reason, change);
+        crm_trace("Not expecting %s to be down (%s)",
+                  change->node_id, change->path);
+        abort_transition(INFINITY, tg_restart, reason, change->change);
     } else {
-        crm_trace("Expecting changes to %s (%s)", node_uuid, xpath);
+        crm_trace("Expecting changes to %s (%s)",
+                  change->node_id, change->path);
     }
-    free(node_uuid);
 }
 
 static void
-process_op_deletion(const char *xpath, xmlNode *change)
+process_op_deletion(const pcmk__patch_change_t *change)
 {
-    char *mutable_key = strdup(xpath);
-    char *key;
-    char *node_uuid;
-
-    // Extract the part of xpath between last pair of single quotes
-    key = strrchr(mutable_key, '\'');
-    if (key != NULL) {
-        *key = '\0';
-        key = strrchr(mutable_key, '\'');
-    }
-    if (key == NULL) {
+    if (change->op_id == NULL) {
         crm_warn("Ignoring malformed CIB update (resource deletion of %s)",
-                 xpath);
-        free(mutable_key);
+                 change->path);
         return;
     }
-    ++key;
 
-    node_uuid = extract_node_uuid(xpath);
-    if (confirm_cancel_action(key, node_uuid) == FALSE) {
+    if (confirm_cancel_action(change->op_id, change->node_id) == FALSE) {
         abort_transition(INFINITY, tg_restart, "Resource operation removal",
-                         change);
+                         change->change);
     }
-    free(mutable_key);
-    free(node_uuid);
 }
 
 static void
-process_delete_diff(const char *xpath, const char *op, xmlNode *change)
+process_delete_diff(const pcmk__patch_change_t *change)
 {
-    if (strstr(xpath, "/" XML_LRM_TAG_RSC_OP "[")) {
-        process_op_deletion(xpath, change);
+    if (pcmk__patch_path_has(change, XML_LRM_TAG_RSC_OP)) {
+        process_op_deletion(change);
 
-    } else if (strstr(xpath, "/" XML_CIB_TAG_LRM "[")) {
-        abort_unless_down(xpath, op, change, "Resource state removal");
+    } else if (pcmk__patch_path_has(change, XML_CIB_TAG_LRM)) {
+        abort_unless_down(change, "Resource state removal");
 
-    } else if (strstr(xpath, "/" XML_CIB_TAG_STATE "[")) {
-        abort_unless_down(xpath, op, change, "Node state removal");
+    } else if (pcmk__patch_path_has(change, XML_CIB_TAG_STATE)) {
+        abort_unless_down(change, "Node state removal");
 
     } else {
-        crm_trace("Ignoring delete of %s", xpath);
+        crm_trace("Ignoring delete of %s", change->path);
     }
 }
 
@@ -404,119 +361,95 @@ process_cib_diff(xmlNode *cib, xmlNode *change, const char *op,
     }
 }
 
-static void
-te_update_diff_v2(xmlNode *diff)
+/*!
+ * \internal
+ * \brief Process one change of a v2 patchset
+ *
+ * \param[in] change     Parsed patchset change
+ * \param[in] user_data  Ignored
+ *
+ * \return 1 if no further changes need processing, otherwise 0
+ */
+static int
+te_update_change(const pcmk__patch_change_t *change, void *user_data)
 {
-    crm_log_xml_trace(diff, "Patch:Raw");
-
-    for (xmlNode *change = __xml_first_child(diff); change != NULL;
-         change = __xml_next(change)) {
-
-        xmlNode *match = NULL;
-        const char *name = NULL;
-        const char *xpath = crm_element_value(change, XML_DIFF_PATH);
-
-        // Possible ops: create, modify, delete, move
-        const char *op = crm_element_value(change, XML_DIFF_OP);
-
-        // Ignore uninteresting updates
-        if (op == NULL) {
-            continue;
-
-        } else if (xpath == NULL) {
-            crm_trace("Ignoring %s change for version field", op);
-            continue;
-
-        } else if (strcmp(op, "move") == 0) {
-            crm_trace("Ignoring move change at %s", xpath);
-            continue;
-        }
-
-        // Find the result of create/modify ops
-        if (strcmp(op, "create") == 0) {
-            match = change->children;
-
-        } else if (strcmp(op, "modify") == 0) {
-            match = first_named_child(change, XML_DIFF_RESULT);
-            if(match) {
-                match = match->children;
-            }
-
-        } else if (strcmp(op, "delete") != 0) {
-            crm_warn("Ignoring malformed CIB update (%s operation on %s is unrecognized)",
-                     op, xpath);
-            continue;
-        }
-
-        if (match) {
-            if (match->type == XML_COMMENT_NODE) {
-                crm_trace("Ignoring %s operation for comment at %s", op, xpath);
-                continue;
-            }
-            name = (const char *)match->name;
-        }
-
-        crm_trace("Handling %s operation for %s%s%s",
-                  op, (xpath? xpath : "CIB"),
-                  (name? " matched by " : ""), (name? name : ""));
-
-        if (strstr(xpath, "/" XML_TAG_CIB "/" XML_CIB_TAG_CONFIGURATION)) {
-            abort_transition(INFINITY, tg_restart, "Configuration change",
-                             change);
-            break; // Won't be packaged with operation results we may be waiting for
-
-        } else if (strstr(xpath, "/" XML_CIB_TAG_TICKETS)
-                   || safe_str_eq(name, XML_CIB_TAG_TICKETS)) {
-            abort_transition(INFINITY, tg_restart, "Ticket attribute change", change);
-            break; // Won't be packaged with operation results we may be waiting for
+    const char *op = change->op;
+    const char *xpath = change->path;
+    const char *name = crm_element_name(change->result);
+
+    // Possible ops: create, modify, delete, move
+    if (strcmp(op, "move") == 0) {
+        crm_trace("Ignoring move change at %s", xpath);
+        return 0;
+
+    } else if ((strcmp(op, "create") != 0) && (strcmp(op, "modify") != 0)
+               && (strcmp(op, "delete") != 0)) {
+        crm_warn("Ignoring malformed CIB update (%s operation on %s is unrecognized)",
+                 op, xpath);
+        return 0;
+    }
 
-        } else if (strstr(xpath, "/" XML_TAG_TRANSIENT_NODEATTRS "[")
-                   || safe_str_eq(name, XML_TAG_TRANSIENT_NODEATTRS)) {
-            abort_unless_down(xpath, op, change, "Transient attribute change");
-            break; // Won't be packaged with operation results we may be waiting for
+    crm_trace("Handling %s operation for %s%s%s",
+              op, xpath, (name? " matched by " : ""), (name? name : ""));
 
-        } else if (strcmp(op, "delete") == 0) {
-            process_delete_diff(xpath, op, change);
+    if (change->section == pcmk__section_configuration) {
+        abort_transition(INFINITY, tg_restart, "Configuration change",
+                         change->change);
+        return 1; // Won't be packaged with operation results we may be waiting for
 
-        } else if (name == NULL) {
-            crm_warn("Ignoring malformed CIB update (%s at %s has no result)",
-                     op, xpath);
+    } else if (pcmk__patch_path_has(change, XML_CIB_TAG_TICKETS)
+               || safe_str_eq(name, XML_CIB_TAG_TICKETS)) {
+        abort_transition(INFINITY, tg_restart, "Ticket attribute change",
+                         change->change);
+        return 1; // Won't be packaged with operation results we may be waiting for
 
-        } else if (strcmp(name, XML_TAG_CIB) == 0) {
-            process_cib_diff(match, change, op, xpath);
+    } else if (pcmk__patch_path_has(change, XML_TAG_TRANSIENT_NODEATTRS)
+               || safe_str_eq(name, XML_TAG_TRANSIENT_NODEATTRS)) {
+        abort_unless_down(change, "Transient attribute change");
+        return 1; // Won't be packaged with operation results we may be waiting for
 
-        } else if (strcmp(name, XML_CIB_TAG_STATUS) == 0) {
-            process_status_diff(match, change, op, xpath);
+    } else if (strcmp(op, "delete") == 0) {
+        process_delete_diff(change);
 
-        } else if (strcmp(name, XML_CIB_TAG_STATE) == 0) {
-            process_node_state_diff(match, change, op, xpath);
+    } else if (name == NULL) {
+        crm_warn("Ignoring malformed CIB update (%s at %s has no result)",
+                 op, xpath);
 
-        } else if (strcmp(name, XML_CIB_TAG_LRM) == 0) {
-            process_resource_updates(ID(match), match, change, op, xpath);
+    } else if (strcmp(name, XML_TAG_CIB) == 0) {
+        process_cib_diff(change->result, change->change, op, xpath);
 
-        } else if (strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else if (strcmp(name, XML_CIB_TAG_STATUS) == 0) {
+        process_status_diff(change->result, change->change, op, xpath);
 
-            process_resource_updates(local_node, match, change, op, xpath);
-            free(local_node);
+    } else if (strcmp(name, XML_CIB_TAG_STATE) == 0) {
+        process_node_state_diff(change->result, change->change, op, xpath);
 
-        } else if (strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else if (strcmp(name, XML_CIB_TAG_LRM) == 0) {
+        process_resource_updates(ID(change->result), change->result,
+                                 change->change, op, xpath);
 
-            process_lrm_resource_diff(match, local_node);
-            free(local_node);
+    } else if (strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
+        process_resource_updates(change->node_id, change->result,
+                                 change->change, op, xpath);
 
-        } else if (strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else if (strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
+        process_lrm_resource_diff(change->result, change->node_id);
 
-            process_graph_event(match, local_node);
-            free(local_node);
+    } else if (strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
+        process_graph_event(change->result, change->node_id);
 
-        } else {
-            crm_warn("Ignoring malformed CIB update (%s at %s has unrecognized result %s)",
-                     op, xpath, name);
-        }
+    } else {
+        crm_warn("Ignoring malformed CIB update (%s at %s has unrecognized result %s)",
+                 op, xpath, name);
     }
+    return 0;
+}
+
+static void
+te_update_diff_v2(xmlNode *diff)
+{
+    crm_log_xml_trace(diff, "Patch:Raw");
+    pcmk__patchset_foreach(diff, te_update_change, NULL);
 }
 
 void
@@ -595,12 +528,14 @@ process_te_message(xmlNode * msg, xmlNode * xml_data)
                && safe_str_eq(sys_from, CRM_SYSTEM_LRMD)
 /* 		  && safe_str_eq(type, XML_ATTR_RESPONSE) */
         ) {
+        static xmlXPathCompExprPtr ack_ops = NULL;
         xmlXPathObject *xpathObj = NULL;
 
         crm_log_xml_trace(msg, "Processing (N)ACK");
         crm_debug("Processing (N)ACK %s from %s", crm_element_value(msg, F_CRM_REFERENCE), from);
 
-        xpathObj = xpath_search(xml_data, "//" XML_LRM_TAG_RSC_OP);
+        xpathObj = pcmk__xpath_search_const(xml_data, "//" XML_LRM_TAG_RSC_OP,
+                                            &ack_ops);
         if (numXpathResults(xpathObj)) {
             int lpc = 0, max = numXpathResults(xpathObj);
 
@@ -199,56 +199,32 @@ update_failcount(xmlNode * event, const char *event_node_uuid, int rc,
 crm_action_t *
 controld_get_action(int id)
 {
-    for (GList *item = transition_graph->synapses; item; item = item->next) {
-        synapse_t *synapse = (synapse_t *) item->data;
-
-        for (GList *item2 = synapse->actions; item2; item2 = item2->next) {
-            crm_action_t *action = (crm_action_t *) item2->data;
-
-            if (action->id == id) {
-                return action;
-            }
-        }
-    }
-    return NULL;
+    return pcmk__graph_action(transition_graph, id);
 }
 
 crm_action_t *
 get_cancel_action(const char *id, const char *node)
 {
-    GListPtr gIter = NULL;
-    GListPtr gIter2 = NULL;
+    GListPtr gIter = pcmk__graph_actions_by_key(transition_graph, id);
 
-    gIter = transition_graph->synapses;
     for (; gIter != NULL; gIter = gIter->next) {
-        synapse_t *synapse = (synapse_t *) gIter->data;
-
-        gIter2 = synapse->actions;
-        for (; gIter2 != NULL; gIter2 = gIter2->next) {
-            const char *task = NULL;
-            const char *target = NULL;
-            crm_action_t *action = (crm_action_t *) gIter2->data;
-
-            task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
-            if (safe_str_neq(CRMD_ACTION_CANCEL, task)) {
-                continue;
-            }
+        const char *task = NULL;
+        const char *target = NULL;
+        crm_action_t *action = (crm_action_t *) gIter->data;
 
-            task = crm_element_value(action->xml, XML_LRM_ATTR_TASK_KEY);
-            if (safe_str_neq(task, id)) {
-                crm_trace("Wrong key %s for %s on %s", task, id, node);
-                continue;
-            }
-
-            target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET_UUID);
-            if (node && safe_str_neq(target, node)) {
-                crm_trace("Wrong node %s for %s on %s", target, id, node);
-                continue;
-            }
+        task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
+        if (safe_str_neq(CRMD_ACTION_CANCEL, task)) {
+            continue;
+        }
 
-            crm_trace("Found %s on %s", id, node);
-            return action;
+        target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET_UUID);
+        if (node && safe_str_neq(target, node)) {
+            crm_trace("Wrong node %s for %s on %s", target, id, node);
+            continue;
         }
+
+        crm_trace("Found %s on %s", id, node);
+        return action;
     }
 
     return NULL;
@@ -275,10 +251,6 @@ confirm_cancel_action(const char *id, const char *node_id)
     return TRUE;
 }
 
-/* downed nodes are listed like: <downed> <node id="UUID1" /> ... </downed> */
-#define XPATH_DOWNED "//" XML_GRAPH_TAG_DOWNED \
-                     "/" XML_CIB_TAG_NODE "[@" XML_ATTR_UUID "='%s']"
-
 /*!
  * \brief Find a transition event that would have made a specified node down
  *
@@ -290,11 +262,8 @@ crm_action_t *
 match_down_event(const char *target)
 {
     crm_action_t *match = NULL;
-    xmlXPathObjectPtr xpath_ret = NULL;
     GListPtr gIter, gIter2;
 
-    char *xpath = crm_strdup_printf(XPATH_DOWNED, target);
-
     for (gIter = transition_graph->synapses;
          gIter != NULL && match == NULL;
          gIter = gIter->next) {
@@ -305,11 +274,18 @@ match_down_event(const char *target)
 
             match = (crm_action_t*)gIter2->data;
             if (match->executed) {
-                xpath_ret = xpath_search(match->xml, xpath);
-                if (numXpathResults(xpath_ret) < 1) {
+                /* Downed nodes are listed directly under the action like:
+                 * <downed> <node id="UUID1" /> ... </downed>
+                 * so look them up without the cost of an XPath search.
+                 */
+                xmlNode *downed = first_named_child(match->xml,
+                                                    XML_GRAPH_TAG_DOWNED);
+
+                if ((downed == NULL)
+                    || (pcmk__xe_match(downed, XML_CIB_TAG_NODE,
+                                       XML_ATTR_UUID, target) == NULL)) {
                     match = NULL;
                 }
-                freeXpathObject(xpath_ret);
             } else {
                 // Only actions that were actually started can match
                 match = NULL;
@@ -317,8 +293,6 @@ match_down_event(const char *target)
         }
     }
 
-    free(xpath);
-
     if (match != NULL) {
         crm_debug("Shutdown action %d (%s) found for node %s", match->id,
                   crm_element_value(match->xml, XML_LRM_ATTR_TASK_KEY), target);
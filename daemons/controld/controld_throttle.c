@@ -15,6 +15,7 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <limits.h>
 
 #include <crm/crm.h>
 #include <crm/msg_xml.h>
@@ -43,9 +44,15 @@ static float throttle_load_target = 0.0;
 #define THROTTLE_FACTOR_MEDIUM 1.6
 #define THROTTLE_FACTOR_HIGH   2.0
 
+#define THROTTLE_INTERVAL_MS     (30 * 1000)
+#define THROTTLE_PSI_INTERVAL_MS (10 * 1000)
+
 static GHashTable *throttle_records = NULL;
 static mainloop_timer_t *throttle_timer = NULL;
 
+// Description of the measurement that determined the current throttle mode
+static char *throttle_reason = NULL;
+
 #if SUPPORT_PROCFS
 /*!
  * \internal
@@ -278,17 +285,272 @@ throttle_handle_load(float load, const char *desc, int cores)
 
     return throttle_check_thresholds(load, desc, thresholds);
 }
+
+/*
+ * Pressure stall information
+ *
+ * Where the kernel supports it (Linux 4.20 and later), the share of recent
+ * time that tasks were stalled waiting for CPU, I/O, or memory is a far more
+ * direct measure of overload than the load average, which lags by about a
+ * minute, and counts tasks rather than how long they wait. The cgroup
+ * containing the cluster daemons (and the resource agents they run) has its
+ * own pressure files under cgroup v2, and those are preferred, since they
+ * show whether cluster work in particular is being held up. Where the
+ * cgroup's CPU usage is limited by a quota, the share of time it was
+ * throttled by that quota also counts as CPU pressure.
+ *
+ * Each measurement is smoothed across checks, rising at once but falling
+ * only by half the difference per check, so that a brief lull during a busy
+ * period does not immediately lift throttling.
+ */
+
+struct throttle_pressure_s {
+    const char *resource;   // as in name of pressure file
+    const char *desc;       // for logging
+    float scale;            // multiplier for thresholds
+    float smoothed;         // smoothed stall percentage
+};
+
+static struct throttle_pressure_s throttle_pressures[] = {
+    { "cpu", "CPU pressure", 1.0, 0.0 },
+    { "io", "I/O pressure", 1.0, 0.0 },
+    { "memory", "memory pressure", 0.5, 0.0 },
+};
+
+/*!
+ * \internal
+ * \brief Find the cgroup v2 directory of this process
+ *
+ * \return Newly allocated directory name, or NULL if not using cgroup v2
+ */
+static char *
+find_cgroup_dir(void)
+{
+    char buffer[PATH_MAX];
+    char *dir = NULL;
+    FILE *stream = fopen("/proc/self/cgroup", "r");
+
+    if (stream == NULL) {
+        return NULL;
+    }
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        // The unified hierarchy's entry is "0::<path>"
+        if (crm_starts_with(buffer, "0::/")) {
+            char *nl = strchr(buffer, '\n');
+
+            if (nl) {
+                nl[0] = '\0';
+            }
+            dir = crm_strdup_printf("/sys/fs/cgroup%s", buffer + 3);
+            break;
+        }
+    }
+    fclose(stream);
+    return dir;
+}
+
+static const char *
+cgroup_dir(void)
+{
+    static char *dir = NULL;
+    static bool searched = FALSE;
+
+    if (!searched) {
+        searched = TRUE;
+        dir = find_cgroup_dir();
+        crm_debug("Using cgroup %s for pressure information",
+                  (dir? dir : "(none)"));
+    }
+    return dir;
+}
+
+/*!
+ * \internal
+ * \brief Read the recent share of time some tasks were stalled on a resource
+ *
+ * \param[in]  file      Pressure file to read
+ * \param[out] pressure  Where to store percentage from "some avg10" value
+ *
+ * \return TRUE if \p pressure was set, otherwise FALSE
+ */
+static bool
+throttle_read_pressure(const char *file, float *pressure)
+{
+    char buffer[256];
+    bool found = FALSE;
+    FILE *stream = fopen(file, "r");
+
+    if (stream == NULL) {
+        // Not all kernels (or cgroups) provide this, so don't complain
+        return FALSE;
+    }
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        if (crm_starts_with(buffer, "some ")) {
+            char *avg = strstr(buffer, "avg10=");
+
+            if (avg != NULL) {
+                *pressure = strtof(avg + strlen("avg10="), NULL);
+                found = TRUE;
+            }
+            break;
+        }
+    }
+    fclose(stream);
+    return found;
+}
+
+/*!
+ * \internal
+ * \brief Calculate the recent share of time the cgroup was held to its quota
+ *
+ * \param[out] throttled  Where to store percentage of time throttled
+ *
+ * \return TRUE if \p throttled was set, otherwise FALSE
+ */
+static bool
+throttle_cgroup_quota(float *throttled)
+{
+    static time_t last_call = 0;
+    static unsigned long long last_usec = 0;
+
+    char buffer[256];
+    char *file = NULL;
+    FILE *stream = NULL;
+    bool found = FALSE;
+    unsigned long long usec = 0;
+    time_t now = time(NULL);
+
+    if (cgroup_dir() == NULL) {
+        return FALSE;
+    }
+    file = crm_strdup_printf("%s/cpu.stat", cgroup_dir());
+    stream = fopen(file, "r");
+    free(file);
+    if (stream == NULL) {
+        return FALSE;
+    }
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        if (sscanf(buffer, "throttled_usec %llu", &usec) == 1) {
+            found = TRUE;
+            break;
+        }
+    }
+    fclose(stream);
+
+    if (!found) {
+        // No cpu controller, or no quota
+        return FALSE;
+    }
+
+    found = FALSE;
+    if ((last_call > 0) && (last_call < now) && (last_usec <= usec)) {
+        *throttled = (float) (usec - last_usec) / 10000.0;
+        *throttled /= (now - last_call);
+        found = TRUE;
+    }
+    last_call = now;
+    last_usec = usec;
+    return found;
+}
+
+static float
+throttle_smooth(float previous, float current)
+{
+    return (current >= previous)? current : ((previous + current) / 2);
+}
+
+/*!
+ * \internal
+ * \brief Raise a throttle mode if a new measurement calls for it
+ *
+ * \param[in,out] mode      Throttle mode to update
+ * \param[in]     new_mode  Throttle mode called for by measurement
+ * \param[in]     desc      Description of measurement
+ * \param[in]     value     Measured value
+ */
+static void
+throttle_note_mode(enum throttle_state_e *mode, enum throttle_state_e new_mode,
+                   const char *desc, float value)
+{
+    if ((new_mode > *mode) || (throttle_reason == NULL)) {
+        *mode = QB_MAX(*mode, new_mode);
+        free(throttle_reason);
+        throttle_reason = crm_strdup_printf("%s %.2f", desc, value);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Check pressure stall information against throttling thresholds
+ *
+ * \param[in,out] mode  Throttle mode to update
+ *
+ * \return TRUE if pressure information was available, otherwise FALSE
+ */
+static bool
+throttle_handle_pressure(enum throttle_state_e *mode)
+{
+    bool available = FALSE;
+    float value = 0.0;
+    float throttled = 0.0;
+    float thresholds[4];
+
+    for (int lpc = 0; lpc < (int) DIMOF(throttle_pressures); lpc++) {
+        struct throttle_pressure_s *p = &throttle_pressures[lpc];
+        char *file = NULL;
+        bool found = FALSE;
+
+        if (cgroup_dir() != NULL) {
+            file = crm_strdup_printf("%s/%s.pressure", cgroup_dir(),
+                                     p->resource);
+            found = throttle_read_pressure(file, &value);
+            free(file);
+        }
+        if (!found) {
+            file = crm_strdup_printf("/proc/pressure/%s", p->resource);
+            found = throttle_read_pressure(file, &value);
+            free(file);
+        }
+        if (!found) {
+            continue;
+        }
+        available = TRUE;
+
+        if ((lpc == 0) && throttle_cgroup_quota(&throttled)) {
+            // CPU quota throttling counts as CPU pressure
+            value = QB_MAX(value, throttled);
+        }
+        p->smoothed = throttle_smooth(p->smoothed, value);
+
+        // Percentages of stalled time, relative to load-threshold
+        thresholds[0] = throttle_load_target * 100 * p->scale * 0.25;
+        thresholds[1] = throttle_load_target * 100 * p->scale * 0.50;
+        thresholds[2] = throttle_load_target * 100 * p->scale * 0.75;
+        thresholds[3] = throttle_load_target * 100 * p->scale;
+
+        throttle_note_mode(mode,
+                           throttle_check_thresholds(p->smoothed, p->desc,
+                                                     thresholds),
+                           p->desc, p->smoothed);
+    }
+    return available;
+}
 #endif
 
 static enum throttle_state_e
 throttle_mode(void)
 {
+    enum throttle_state_e mode = throttle_none;
 #if SUPPORT_PROCFS
     unsigned int cores;
     float load;
     float thresholds[4];
-    enum throttle_state_e mode = throttle_none;
+#endif
+
+    free(throttle_reason);
+    throttle_reason = NULL;
 
+#if SUPPORT_PROCFS
     cores = crm_procfs_num_cores();
     if(throttle_cib_load(&load)) {
         float cib_max_cpu = 0.95;
@@ -317,7 +579,10 @@ throttle_mode(void)
         /* Can only happen on machines with a low number of cores */
         thresholds[3] = cib_max_cpu * 1.5;
 
-        mode |= throttle_check_thresholds(load, "CIB load", thresholds);
+        throttle_note_mode(&mode,
+                           throttle_check_thresholds(load, "CIB load",
+                                                     thresholds),
+                           "CIB load", load);
     }
 
     if(throttle_load_target <= 0) {
@@ -325,22 +590,42 @@ throttle_mode(void)
         return mode;
     }
 
-    if(throttle_load_avg(&load)) {
+    // The load average is only a fallback for kernels without PSI
+    if (!throttle_handle_pressure(&mode) && throttle_load_avg(&load)) {
         crm_debug("Current load is %f across %u core(s)", load, cores);
-        mode |= throttle_handle_load(load, "CPU load", cores);
+        throttle_note_mode(&mode, throttle_handle_load(load, "CPU load", cores),
+                           "CPU load", load);
     }
+#endif // SUPPORT_PROCFS
+    return mode;
+}
 
-    if(mode & throttle_extreme) {
-        return throttle_extreme;
-    } else if(mode & throttle_high) {
-        return throttle_high;
-    } else if(mode & throttle_med) {
-        return throttle_med;
-    } else if(mode & throttle_low) {
-        return throttle_low;
+/*!
+ * \internal
+ * \brief Get the number of jobs a node may run in a given throttle mode
+ *
+ * \param[in] mode  Throttle mode of node
+ * \param[in] max   Maximum number of jobs node supports
+ *
+ * \return Number of jobs node may run
+ */
+static int
+throttle_jobs_for_mode(enum throttle_state_e mode, int max)
+{
+    switch(mode) {
+        case throttle_extreme:
+        case throttle_high:
+            return 1; /* At least one job must always be allowed */
+        case throttle_med:
+            return QB_MAX(1, max / 4);
+        case throttle_low:
+            return QB_MAX(1, max / 2);
+        case throttle_none:
+            return QB_MAX(1, max);
+        default:
+            break;
     }
-#endif // SUPPORT_PROCFS
-    return throttle_none;
+    return -1;
 }
 
 static void
@@ -350,12 +635,16 @@ throttle_send_command(enum throttle_state_e mode)
     static enum throttle_state_e last = -1;
 
     if(mode != last) {
-        crm_info("New throttle mode: %.4x (was %.4x)", mode, last);
+        crm_info("New throttle mode: %.4x (was %.4x) allowing %d of %d jobs: %s",
+                 mode, last, throttle_jobs_for_mode(mode, throttle_job_max),
+                 throttle_job_max,
+                 (throttle_reason? throttle_reason : "no load information"));
         last = mode;
 
         xml = create_request(CRM_OP_THROTTLE, NULL, NULL, CRM_SYSTEM_CRMD, CRM_SYSTEM_CRMD, NULL);
         crm_xml_add_int(xml, F_CRM_THROTTLE_MODE, mode);
         crm_xml_add_int(xml, F_CRM_THROTTLE_MAX, throttle_job_max);
+        crm_xml_add(xml, F_CRM_THROTTLE_REASON, throttle_reason);
 
         send_cluster_message(NULL, crm_msg_crmd, xml, TRUE);
         free_xml(xml);
@@ -414,7 +703,14 @@ throttle_init(void)
     if(throttle_records == NULL) {
         throttle_records = g_hash_table_new_full(
             crm_str_hash, g_str_equal, NULL, throttle_record_free);
-        throttle_timer = mainloop_timer_add("throttle", 30 * 1000, TRUE, throttle_timer_cb, NULL);
+        throttle_timer = mainloop_timer_add("throttle", THROTTLE_INTERVAL_MS,
+                                            TRUE, throttle_timer_cb, NULL);
+#if SUPPORT_PROCFS
+        // Pressure averages react within seconds, so check them more often
+        if (access("/proc/pressure/cpu", R_OK) == 0) {
+            mainloop_timer_set_period(throttle_timer, THROTTLE_PSI_INTERVAL_MS);
+        }
+#endif
     }
 
     throttle_update_job_max(NULL);
@@ -432,6 +728,8 @@ throttle_fini(void)
         g_hash_table_destroy(throttle_records);
         throttle_records = NULL;
     }
+    free(throttle_reason);
+    throttle_reason = NULL;
 }
 
 int
@@ -492,23 +790,10 @@ throttle_get_job_limit(const char *node)
         g_hash_table_insert(throttle_records, r->node, r);
     }
 
-    switch(r->mode) {
-        case throttle_extreme:
-        case throttle_high:
-            jobs = 1; /* At least one job must always be allowed */
-            break;
-        case throttle_med:
-            jobs = QB_MAX(1, r->max / 4);
-            break;
-        case throttle_low:
-            jobs = QB_MAX(1, r->max / 2);
-            break;
-        case throttle_none:
-            jobs = QB_MAX(1, r->max);
-            break;
-        default:
-            crm_err("Unknown throttle mode %.4x on %s", r->mode, node);
-            break;
+    jobs = throttle_jobs_for_mode(r->mode, r->max);
+    if (jobs < 0) {
+        crm_err("Unknown throttle mode %.4x on %s", r->mode, node);
+        jobs = 1;
     }
     return jobs;
 }
@@ -520,6 +805,7 @@ throttle_update(xmlNode *xml)
     enum throttle_state_e mode = 0;
     struct throttle_record_s *r = NULL;
     const char *from = crm_element_value(xml, F_CRM_HOST_FROM);
+    const char *reason = crm_element_value(xml, F_CRM_THROTTLE_REASON);
 
     crm_element_value_int(xml, F_CRM_THROTTLE_MODE, (int*)&mode);
     crm_element_value_int(xml, F_CRM_THROTTLE_MAX, &max);
@@ -535,6 +821,7 @@ throttle_update(xmlNode *xml)
     r->max = max;
     r->mode = mode;
 
-    crm_debug("Host %s supports a maximum of %d jobs and throttle mode %.4x.  New job limit is %d",
-              from, max, mode, throttle_get_job_limit(from));
+    crm_debug("Host %s supports a maximum of %d jobs and throttle mode %.4x.  New job limit is %d%s%s",
+              from, max, mode, throttle_get_job_limit(from),
+              (reason? " due to " : ""), (reason? reason : ""));
 }
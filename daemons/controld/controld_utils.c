@@ -954,6 +954,7 @@ erase_status_tag(const char *uname, const char *tag, int options)
 
         crm_info("Deleting %s status entries for %s " CRM_XS " xpath=%s",
                  tag, uname, xpath);
+        controld_flush_rsc_updates();
         call_id = fsa_cib_conn->cmds->remove(fsa_cib_conn, xpath, NULL,
                                              cib_quorum_override | cib_xpath | options);
         fsa_register_cib_callback(call_id, FALSE, xpath, erase_xpath_callback);
@@ -961,6 +962,80 @@ erase_status_tag(const char *uname, const char *tag, int options)
     }
 }
 
+#define XPATH_NODE_HISTORY "//" XML_CIB_TAG_STATE "[@" XML_ATTR_ID "='%s']/" \
+                           XML_CIB_TAG_LRM
+
+/*!
+ * \internal
+ * \brief Get a node's resource history from the local CIB
+ *
+ * \param[in] node_uuid  UUID of node to get resource history for
+ * \param[in] options    Additional CIB call options (such as cib_no_children)
+ *
+ * \return Copy of the node's \<lrm\> element, or NULL if it has none (or the
+ *         query failed)
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+controld_query_node_history(const char *node_uuid, int options)
+{
+    int rc = pcmk_ok;
+    xmlNode *output = NULL;
+    char *xpath = NULL;
+
+    CRM_CHECK((fsa_cib_conn != NULL) && (node_uuid != NULL), return NULL);
+
+    xpath = crm_strdup_printf(XPATH_NODE_HISTORY, node_uuid);
+    rc = fsa_cib_conn->cmds->query(fsa_cib_conn, xpath, &output,
+                                   cib_scope_local|cib_xpath|cib_sync_call|options);
+    if (rc != pcmk_ok) {
+        crm_trace("No resource history for %s in CIB: %s "
+                  CRM_XS " xpath=%s", node_uuid, pcmk_strerror(rc), xpath);
+        free_xml(output);
+        output = NULL;
+
+    } else if (safe_str_neq(crm_element_name(output), XML_CIB_TAG_LRM)) {
+        crm_warn("Ignoring ambiguous resource history for %s in CIB "
+                 CRM_XS " xpath=%s", node_uuid, xpath);
+        free_xml(output);
+        output = NULL;
+    }
+    free(xpath);
+    return output;
+}
+
+/*!
+ * \internal
+ * \brief Ask a peer to bring the local CIB up to date with its own
+ *
+ * \param[in] host   Node to sync the CIB from
+ * \param[in] delta  If TRUE, ask for only the changes the local CIB is missing
+ *                   (the peer sends its whole CIB if it does not have them)
+ *
+ * \return Call ID of CIB request (or negative error code on failure)
+ * \note Unlike a sync_from() request, which the peer broadcasts to every node,
+ *       this affects only the local CIB.
+ */
+int
+controld_sync_cib_from(const char *host, gboolean delta)
+{
+    int rc = pcmk_ok;
+    xmlNode *version = NULL;
+
+    CRM_CHECK((fsa_cib_conn != NULL) && (host != NULL), return -EINVAL);
+
+    /* The local CIB manager adds its current version when forwarding the
+     * request, so the peer knows which changes we are missing
+     */
+    if (delta) {
+        version = create_xml_node(NULL, XML_CIB_TAG_GENERATION_TUPPLE);
+    }
+    rc = cib_internal_op(fsa_cib_conn, CIB_OP_SYNC_ONE, host, NULL, version,
+                         NULL, cib_quorum_override, NULL);
+    free_xml(version);
+    return rc;
+}
+
 void crmd_peer_down(crm_node_t *peer, bool full) 
 {
     if(full && peer->state == NULL) {
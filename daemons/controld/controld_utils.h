@@ -65,6 +65,12 @@ void pe_subsystem_free(void);
 void controld_stop_sched_timer(void);
 void controld_free_sched_timer(void);
 void controld_expect_sched_reply(xmlNode *msg);
+void controld_resend_sched_input(void);
+void controld_set_sched_max_delay(const char *value);
+void controld_request_sched_run(void);
+void controld_cancel_sched_run(void);
+void controld_sched_reply_received(gboolean current);
+void controld_sched_cib_changed(xmlNode *msg);
 
 void fsa_dump_actions(long long action, const char *text);
 void fsa_dump_inputs(int log_level, const char *text, long long input_register);
@@ -76,6 +82,8 @@ xmlNode *create_node_state_update(crm_node_t *node, int flags,
 void populate_cib_nodes(enum node_update_flags flags, const char *source);
 void crm_update_quorum(gboolean quorum, gboolean force_update);
 void erase_status_tag(const char *uname, const char *tag, int options);
+xmlNode *controld_query_node_history(const char *node_uuid, int options);
+int controld_sync_cib_from(const char *host, gboolean delta);
 void controld_close_attrd_ipc(void);
 void update_attrd(const char *host, const char *name, const char *value, const char *user_name, gboolean is_remote_node);
 void update_attrd_remote_node_removed(const char *host, const char *user_name);
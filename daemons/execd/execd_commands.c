@@ -972,6 +972,13 @@ action_complete(svc_action_t * action)
         cmd->output = strdup(action->stdout_data);
     }
 
+    if (rsc && safe_str_eq(cmd->action, CRMD_ACTION_METADATA)
+        && (cmd->lrmd_op_status == PCMK_LRM_OP_DONE)
+        && (cmd->exec_rc == PCMK_OCF_OK)) {
+        pcmk__metadata_cache_put(rsc->class, rsc->provider, rsc->type,
+                                 action->stdout_data);
+    }
+
     cmd_finalize(cmd, rsc);
 }
 
@@ -1279,6 +1286,24 @@ lrmd_rsc_execute_service_lib(lrmd_rsc_t * rsc, lrmd_cmd_t * cmd)
     }
 #endif
 
+    // Meta-data doesn't change unless the agent does, so don't re-run it
+    if (safe_str_eq(cmd->action, CRMD_ACTION_METADATA)) {
+        char *metadata = pcmk__metadata_cache_get(rsc->class, rsc->provider,
+                                                  rsc->type);
+
+        if (metadata != NULL) {
+            crm_trace("Using cached meta-data for %s", rsc->rsc_id);
+            cmd->exec_rc = PCMK_OCF_OK;
+            cmd->lrmd_op_status = PCMK_LRM_OP_DONE;
+            cmd->output = metadata;
+            goto exec_done;
+        }
+
+    } else {
+        // Cache the agent's meta-data for the controller (see execd_metadata.c)
+        execd_metadata_cache_fill(rsc, cmd->params);
+    }
+
     params_copy = crm_str_table_dup(cmd->params);
 
     action = resources_action_create(rsc->rsc_id, rsc->class, rsc->provider,
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <glib.h>
+#include <unistd.h>
+
+#include <crm/crm.h>
+#include <crm/services.h>
+#include <crm/msg_xml.h>
+
+#include "pacemaker-execd.h"
+
+/*
+ * The agent meta-data cache on disk may be written only by root, and the
+ * controller (which needs the meta-data most) does not run as root. So, the
+ * executor fills the cache: the first time it runs an agent whose meta-data is
+ * not cached (or is stale), it gets the meta-data in the background and stores
+ * it, for the controller to find there after its next restart.
+ */
+
+// Maximum number of agents to get meta-data for at once
+#define METADATA_FILL_MAX 2
+
+static GList *fill_queue = NULL;        // svc_action_t *
+static int fill_active = 0;
+
+// Agents (as from crm_generate_ra_key()) being filled, or that failed
+static GHashTable *fill_requested = NULL;
+
+static void fill_next(void);
+
+static void
+fill_done(svc_action_t *action)
+{
+    fill_active--;
+    if ((action->rc == PCMK_OCF_OK) && (action->stdout_data != NULL)) {
+        char *key = crm_generate_ra_key(action->standard, action->provider,
+                                        action->agent);
+
+        crm_debug("Caching meta-data for %s", key);
+        pcmk__metadata_cache_put(action->standard, action->provider,
+                                 action->agent, action->stdout_data);
+
+        // Allow another fill if the agent changes later
+        if (fill_requested != NULL) {
+            g_hash_table_remove(fill_requested, key);
+        }
+        free(key);
+
+    } else {
+        crm_info("Could not get meta-data for %s:%s:%s to cache "
+                 CRM_XS " rc=%d status=%d", action->standard,
+                 crm_str(action->provider), action->agent, action->rc,
+                 action->status);
+    }
+    fill_next();
+}
+
+static void
+fill_next(void)
+{
+    while ((fill_queue != NULL) && (fill_active < METADATA_FILL_MAX)) {
+        svc_action_t *action = fill_queue->data;
+
+        fill_queue = g_list_delete_link(fill_queue, fill_queue);
+        if (services_action_async(action, fill_done)) {
+            fill_active++;
+        } else {
+            services_action_free(action);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Load the agent meta-data cache, dropping entries for removed agents
+ */
+void
+execd_metadata_cache_init(void)
+{
+    if (geteuid() == 0) {
+        pcmk__metadata_cache_load();
+    }
+}
+
+/*!
+ * \internal
+ * \brief Cache an agent's meta-data in the background if not already cached
+ *
+ * \param[in] rsc     Resource whose agent is about to be run
+ * \param[in] params  Parameters of the action about to be run
+ */
+void
+execd_metadata_cache_fill(lrmd_rsc_t *rsc, GHashTable *params)
+{
+    char *key = NULL;
+    char *metadata = NULL;
+    const char *node_name = NULL;
+    GHashTable *md_params = NULL;
+    svc_action_t *action = NULL;
+
+    // Only root may write to the cache
+    if ((geteuid() != 0)
+        || !pcmk__metadata_cacheable(rsc->class, rsc->provider, rsc->type)) {
+        return;
+    }
+
+    key = crm_generate_ra_key(rsc->class, rsc->provider, rsc->type);
+    if (fill_requested == NULL) {
+        fill_requested = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                               free, NULL);
+    } else if (g_hash_table_lookup_extended(fill_requested, key, NULL, NULL)) {
+        free(key);
+        return;
+    }
+
+    metadata = pcmk__metadata_cache_get(rsc->class, rsc->provider, rsc->type);
+    if (metadata != NULL) {
+        free(metadata);
+        free(key);
+        return;
+    }
+
+    // As with lrm_state_get_metadata(), some agents need the node name
+    md_params = crm_str_table_new();
+    node_name = crm_meta_value(params, XML_LRM_ATTR_TARGET);
+    if (node_name != NULL) {
+        g_hash_table_insert(md_params,
+                            strdup(CRM_META "_" XML_LRM_ATTR_TARGET),
+                            strdup(node_name));
+    }
+
+    // Name the action after the agent, so it never blocks a real resource
+    action = resources_action_create(key, rsc->class, rsc->provider,
+                                     rsc->type, CRMD_ACTION_METADATA, 0,
+                                     CRMD_METADATA_CALL_TIMEOUT, md_params, 0);
+    if (action == NULL) {
+        free(key);
+        return;
+    }
+
+    crm_trace("Queuing meta-data for %s to be cached", key);
+    g_hash_table_insert(fill_requested, key, NULL);
+    fill_queue = g_list_append(fill_queue, action);
+    fill_next();
+}
+
+/*!
+ * \internal
+ * \brief Free the executor's agent meta-data cache state
+ */
+void
+execd_metadata_cache_fini(void)
+{
+    g_list_free_full(fill_queue, (GDestroyNotify) services_action_free);
+    fill_queue = NULL;
+    if (fill_requested != NULL) {
+        g_hash_table_destroy(fill_requested);
+        fill_requested = NULL;
+    }
+    pcmk__metadata_cache_cleanup();
+}
@@ -285,6 +285,7 @@ lrmd_exit(gpointer data)
 
     crm_client_cleanup();
     g_hash_table_destroy(rsc_list);
+    execd_metadata_cache_fini();
 
     if (mainloop) {
         lrmd_drain_alerts(mainloop);
@@ -610,6 +611,7 @@ main(int argc, char **argv, char **envp)
     crm_build_path(CRM_RSCTMP_DIR, 0755);
 
     rsc_list = g_hash_table_new_full(crm_str_hash, g_str_equal, NULL, free_rsc);
+    execd_metadata_cache_init();
     ipcs = mainloop_add_ipc_server(CRM_SYSTEM_LRMD, QB_IPC_SHM, &lrmd_ipc_callbacks);
     if (ipcs == NULL) {
         crm_err("Failed to create IPC server: shutting down and inhibiting respawn");
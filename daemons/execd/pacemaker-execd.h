@@ -97,4 +97,8 @@ int ipc_proxy_shutdown_req(crm_client_t *ipc_proxy);
 int process_lrmd_alert_exec(crm_client_t *client, uint32_t id, xmlNode *request);
 void lrmd_drain_alerts(GMainLoop *mloop);
 
+void execd_metadata_cache_init(void);
+void execd_metadata_cache_fill(lrmd_rsc_t *rsc, GHashTable *params);
+void execd_metadata_cache_fini(void);
+
 #endif // PACEMAKER_EXECD__H
@@ -28,6 +28,7 @@
 #include <crm/common/ipcs.h>
 #include <crm/cluster/internal.h>
 #include <crm/common/mainloop.h>
+#include <crm/services.h>
 
 #include <crm/stonith-ng.h>
 #include <crm/fencing/internal.h>
@@ -625,6 +626,7 @@ free_metadata_cache() {
         g_hash_table_destroy(metadata_cache);
         metadata_cache = NULL;
     }
+    pcmk__metadata_cache_cleanup();
 }
 
 static void
@@ -646,9 +648,17 @@ get_agent_metadata(const char *agent)
         return NULL;
 
     } else if(buffer == NULL) {
-        stonith_t *st = stonith_api_new();
+        stonith_t *st = NULL;
         int rc;
 
+        buffer = pcmk__metadata_cache_get(PCMK_RESOURCE_CLASS_STONITH, NULL,
+                                          agent);
+        if (buffer != NULL) {
+            g_hash_table_replace(metadata_cache, strdup(agent), buffer);
+            return string2xml(buffer);
+        }
+
+        st = stonith_api_new();
         if (st == NULL) {
             crm_warn("Could not get agent meta-data: "
                      "API memory allocation failed");
@@ -660,6 +670,8 @@ get_agent_metadata(const char *agent)
             crm_err("Could not retrieve metadata for fencing agent %s", agent);
             return NULL;
         }
+        pcmk__metadata_cache_put(PCMK_RESOURCE_CLASS_STONITH, NULL, agent,
+                                 buffer);
         g_hash_table_replace(metadata_cache, strdup(agent), buffer);
     }
 
@@ -30,6 +30,7 @@
 #include <crm/stonith-ng.h>
 #include <crm/fencing/internal.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 
 #include <crm/common/mainloop.h>
 
@@ -712,59 +713,67 @@ cib_devices_update(void)
     pe_reset_working_set(fenced_data_set);
 }
 
-static void
-update_cib_stonith_devices_v2(const char *event, xmlNode * msg)
+/*!
+ * \internal
+ * \brief Check whether a configuration change could affect fencing devices
+ *
+ * \param[in]     change     Parsed patchset change
+ * \param[in,out] user_data  Where to store reason for update (char **)
+ *
+ * \return 1 if the device list needs to be updated, otherwise 0
+ */
+static int
+check_device_change(const pcmk__patch_change_t *change, void *user_data)
 {
-    xmlNode *change = NULL;
-    char *reason = NULL;
-    bool needs_update = FALSE;
-    xmlNode *patchset = get_message_xml(msg, F_CIB_UPDATE_RESULT);
+    char **reason = user_data;
+    const pcmk__path_step_t *last = NULL;
 
-    for (change = __xml_first_child(patchset); change != NULL; change = __xml_next(change)) {
-        const char *op = crm_element_value(change, XML_DIFF_OP);
-        const char *xpath = crm_element_value(change, XML_DIFF_PATH);
-        const char *shortpath = NULL;
+    if ((strcmp(change->op, "move") == 0)
+        || (change->section == pcmk__section_status)
+        || (change->n_steps == 0)) {
+        return 0;
+    }
 
-        if ((op == NULL) ||
-            (strcmp(op, "move") == 0) ||
-            strstr(xpath, "/"XML_CIB_TAG_STATUS)) {
-            continue;
-        } else if (safe_str_eq(op, "delete") && strstr(xpath, "/"XML_CIB_TAG_RESOURCE)) {
-            const char *rsc_id = NULL;
-            char *search = NULL;
-            char *mutable = NULL;
+    last = &(change->steps[change->n_steps - 1]);
 
-            if (strstr(xpath, XML_TAG_ATTR_SETS) ||
-                strstr(xpath, XML_TAG_META_SETS)) {
-                needs_update = TRUE;
-                reason = strdup("(meta) attribute deleted from resource");
-                break;
-            } 
-            mutable = strdup(xpath);
-            rsc_id = strstr(mutable, "primitive[@id=\'");
-            if (rsc_id != NULL) {
-                rsc_id += strlen("primitive[@id=\'");
-                search = strchr(rsc_id, '\'');
-            }
-            if (search != NULL) {
-                *search = 0;
-                stonith_device_remove(rsc_id, TRUE);
-            } else {
-                crm_warn("Ignoring malformed CIB update (resource deletion)");
-            }
-            free(mutable);
+    if (safe_str_eq(change->op, "delete")
+        && pcmk__patch_path_has(change, XML_CIB_TAG_RESOURCE)) {
+        const char *rsc_id = NULL;
 
-        } else if (strstr(xpath, "/"XML_CIB_TAG_RESOURCES) ||
-                   strstr(xpath, "/"XML_CIB_TAG_CONSTRAINTS) ||
-                   strstr(xpath, "/"XML_CIB_TAG_RSCCONFIG)) {
-            shortpath = strrchr(xpath, '/'); CRM_ASSERT(shortpath);
-            reason = crm_strdup_printf("%s %s", op, shortpath+1);
-            needs_update = TRUE;
-            break;
+        if (pcmk__patch_path_has(change, XML_TAG_ATTR_SETS)
+            || pcmk__patch_path_has(change, XML_TAG_META_SETS)) {
+            *reason = strdup("(meta) attribute deleted from resource");
+            return 1;
+        }
+
+        rsc_id = pcmk__patch_path_id(change, XML_CIB_TAG_RESOURCE);
+        if (rsc_id != NULL) {
+            stonith_device_remove(rsc_id, TRUE);
+        } else {
+            crm_warn("Ignoring malformed CIB update (resource deletion)");
         }
+
+    } else if (pcmk__patch_path_has(change, XML_CIB_TAG_RESOURCES)
+               || pcmk__patch_path_has(change, XML_CIB_TAG_CONSTRAINTS)
+               || pcmk__patch_path_has(change, XML_CIB_TAG_RSCCONFIG)) {
+        if (last->id != NULL) {
+            *reason = crm_strdup_printf("%s %s[@id='%s']",
+                                        change->op, last->name, last->id);
+        } else {
+            *reason = crm_strdup_printf("%s %s", change->op, last->name);
+        }
+        return 1;
     }
+    return 0;
+}
 
-    if(needs_update) {
+static void
+update_cib_stonith_devices_v2(const char *event, xmlNode * msg)
+{
+    char *reason = NULL;
+    xmlNode *patchset = get_message_xml(msg, F_CIB_UPDATE_RESULT);
+
+    if (pcmk__patchset_foreach(patchset, check_device_change, &reason) != 0) {
         crm_info("Updating device list from the cib: %s", reason);
         cib_devices_update();
     } else {
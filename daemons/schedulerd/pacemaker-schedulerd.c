@@ -50,6 +50,65 @@ series_t series[] = {
 
 void pengine_shutdown(int nsig);
 
+/* Last input processed, which the controller may send the next input as a
+ * patch against (see controld_schedulerd.c)
+ */
+static xmlNode *last_input = NULL;
+
+/*!
+ * \internal
+ * \brief Apply patches from the controller to the last input processed
+ *
+ * \param[in] patches  Patchsets to apply in order (the last of which must
+ *                     include a digest of the result)
+ *
+ * \return pcmk_ok on success, -errno otherwise (in which case the last input
+ *         is discarded, and the controller must send the next one in full)
+ */
+static int
+apply_input_patch(xmlNode *patches)
+{
+    int rc = pcmk_ok;
+    xmlNode *patch = NULL;
+    xmlNode *last = NULL;
+
+    for (patch = __xml_first_child_element(patches); patch != NULL;
+         patch = __xml_next_element(patch)) {
+        last = patch;
+    }
+
+    if (last_input == NULL) {
+        rc = -pcmk_err_diff_resync;
+        crm_info("Cannot apply CIB patch without a previous input");
+
+    } else if ((last == NULL)
+               || (crm_element_value(last, XML_ATTR_DIGEST) == NULL)) {
+        rc = -pcmk_err_diff_failed;
+        crm_warn("Cannot apply CIB patch without a digest");
+
+    } else {
+        for (patch = __xml_first_child_element(patches);
+             (patch != NULL) && (rc == pcmk_ok);
+             patch = __xml_next_element(patch)) {
+
+            /* Each is applied separately, since the changes within a v2
+             * patchset are not applied in order
+             */
+            rc = xml_apply_patchset(last_input, patch, FALSE);
+        }
+        if (rc != pcmk_ok) {
+            crm_notice("Could not apply CIB patch to previous input: %s "
+                       CRM_XS " rc=%d", pcmk_strerror(rc), rc);
+        }
+    }
+
+    if (rc != pcmk_ok) {
+        free_xml(last_input);
+        last_input = NULL;
+    }
+    return rc;
+}
+
 static gboolean
 process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
 {
@@ -83,10 +142,28 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
         char *digest = NULL;
         const char *value = NULL;
         xmlNode *converted = NULL;
+        xmlNode *patched = NULL;
         xmlNode *reply = NULL;
         gboolean is_repoke = FALSE;
         gboolean process = TRUE;
 
+        if (crm_is_true(crm_element_value(msg, F_CRM_SCHED_PATCH))) {
+            if (apply_input_patch(xml_data) != pcmk_ok) {
+                reply = create_reply(msg, NULL);
+                CRM_ASSERT(reply != NULL);
+                crm_xml_add(reply, F_CRM_SCHED_RESYNC, XML_BOOLEAN_TRUE);
+                crm_ipcs_send(sender, 0, reply, crm_ipc_server_event);
+                free_xml(reply);
+                return TRUE;
+            }
+            patched = copy_xml(last_input);
+            xml_data = patched;
+
+        } else {
+            free_xml(last_input);
+            last_input = copy_xml(xml_data);
+        }
+
         crm_config_error = FALSE;
         crm_config_warning = FALSE;
 
@@ -191,6 +268,7 @@ process_pe_message(xmlNode * msg, xmlNode * xml_data, crm_client_t * sender)
         }
 
         free_xml(converted);
+        free_xml(patched);
     }
 
     return TRUE;
@@ -347,5 +425,6 @@ pengine_shutdown(int nsig)
 {
     mainloop_del_ipc_server(ipcs);
     pe_free_working_set(sched_data_set);
+    free_xml(last_input);
     crm_exit(CRM_EX_OK);
 }
@@ -28,6 +28,9 @@
 #  define CIB_OP_APPLY_DIFF "cib_apply_diff"
 #  define CIB_OP_UPGRADE    "cib_upgrade"
 #  define CIB_OP_DELETE_ALT	"cib_delete_alt"
+#  define CIB_OP_MULTI	"cib_multi"
+#  define CIB_OP_APPLY_DELTA	"cib_apply_delta"
+#  define CIB_OP_STATS	"cib_stats"
 
 #  define F_CIB_CLIENTID  "cib_clientid"
 #  define F_CIB_CALLOPTS  "cib_callopt"
@@ -52,11 +55,14 @@
 #  define F_CIB_CLIENTNAME	"cib_clientname"
 #  define F_CIB_NOTIFY_TYPE	"cib_notify_type"
 #  define F_CIB_NOTIFY_ACTIVATE	"cib_notify_activate"
+#  define F_CIB_NOTIFY_FILTER	"cib_notify_filter"
 #  define F_CIB_UPDATE_DIFF	"cib_update_diff"
 #  define F_CIB_USER		"cib_user"
 #  define F_CIB_LOCAL_NOTIFY_ID	"cib_local_notify_id"
 #  define F_CIB_PING_ID         "cib_ping_id"
 #  define F_CIB_SCHEMA_MAX      "cib_schema_max"
+#  define F_CIB_TRANSACTION     "cib_transaction"
+#  define F_CIB_COMMAND         "cib_command"
 
 #  define T_CIB			"cib"
 #  define T_CIB_NOTIFY		"cib_notify"
@@ -113,6 +119,15 @@ int cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_
                    xmlNode * current_cib, xmlNode ** result_cib, xmlNode ** diff,
                    xmlNode ** output);
 
+/* Time spent in the phases of the most recent cib_perform_op() call */
+typedef struct cib_op_times_s {
+    long long validate_us;  // schema validation of the result
+    long long diff_us;      // patchset creation (including digest)
+} cib_op_times_t;
+
+const cib_op_times_t *cib_last_op_times(void);
+long long cib_now_us(void);
+
 xmlNode *cib_create_op(int call_id, const char *token, const char *op, const char *host,
                        const char *section, xmlNode * data, int call_options,
                        const char *user_name);
@@ -120,6 +135,11 @@ xmlNode *cib_create_op(int call_id, const char *token, const char *op, const cha
 void cib_native_callback(cib_t * cib, xmlNode * msg, int call_id, int rc);
 void cib_native_notify(gpointer data, gpointer user_data);
 int cib_native_register_notification(cib_t * cib, const char *callback, int enabled);
+int cib_native_set_diff_notify_filter(cib_t *cib, const char *const *paths);
+int cib_remote_set_diff_notify_filter(cib_t *cib, const char *const *paths);
+xmlNode *cib__create_notify_request(const char *event, int enabled,
+                                    const char *const *paths);
+int cib__set_diff_notify_filter(cib_t *cib, const char *const *paths);
 gboolean cib_client_register_callback(cib_t * cib, int call_id, int timeout, gboolean only_success,
                                       void *user_data, const char *callback_name,
                                       void (*callback) (xmlNode *, int, int, xmlNode *, void *));
@@ -167,6 +187,16 @@ int cib_process_upgrade(const char *op, int options, const char *section, xmlNod
                         xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
                         xmlNode ** answer);
 
+int cib_process_multi(const char *op, int options, const char *section, xmlNode * req,
+                      xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
+                      xmlNode ** answer);
+
+xmlNode *cib_transaction_new(void);
+int cib_transaction_add(xmlNode *transaction, const char *op,
+                        const char *section, xmlNode *data, int call_options);
+int cib_transaction_commit(cib_t *cib, xmlNode *transaction, const char *host,
+                           int call_options, const char *user_name);
+
 /*!
  * \internal
  * \brief Core function to manipulate with/query CIB/XML per xpath + arguments
@@ -203,5 +233,6 @@ int cib_file_read_and_verify(const char *filename, const char *sigfile,
                              xmlNode **root);
 int cib_file_write_with_digest(xmlNode *cib_root, const char *cib_dirname,
                                const char *cib_filename);
+void cib_file_prepare_xml(xmlNode *root);
 
 #endif
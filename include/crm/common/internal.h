@@ -12,6 +12,7 @@
 
 #include <glib.h>       /* for gboolean */
 #include <dirent.h>     /* for struct dirent */
+#include <stdint.h>     /* for uint8_t */
 #include <unistd.h>     /* for getpid() */
 #include <sys/types.h>  /* for uid_t and gid_t */
 
@@ -21,6 +22,7 @@
 
 char *generate_series_filename(const char *directory, const char *series, int sequence,
                                gboolean bzip);
+int pcmk__compress_file(const char *source, const char *target);
 int get_last_sequence(const char *directory, const char *series);
 void write_last_sequence(const char *directory, const char *series, int sequence, int max);
 int crm_chown_last_sequence(const char *directory, const char *series, uid_t uid, gid_t gid);
@@ -34,6 +36,18 @@ int crm_set_nonblocking(int fd);
 const char *crm_get_tmpdir(void);
 
 
+/* internal agent meta-data cache functions (from metadata_cache.c) */
+
+void pcmk__metadata_cache_load(void);
+gboolean pcmk__metadata_cacheable(const char *standard, const char *provider,
+                                  const char *type);
+char *pcmk__metadata_cache_get(const char *standard, const char *provider,
+                               const char *type);
+void pcmk__metadata_cache_put(const char *standard, const char *provider,
+                              const char *type, const char *metadata);
+void pcmk__metadata_cache_cleanup(void);
+
+
 /* internal procfs utilities (from procfs.c) */
 
 int crm_procfs_process_info(struct dirent *entry, char *name, int *pid);
@@ -102,6 +116,27 @@ gboolean crm_ends_with_ext(const char *s, const char *match);
 char *add_list_element(char *list, const char *value);
 bool crm_compress_string(const char *data, int length, int max, char **result,
                          unsigned int *result_len);
+
+/* Compression codecs (values are used on the wire, so must not change) */
+enum pcmk__codec {
+    pcmk__codec_bzip2   = 0,    /* always available */
+    pcmk__codec_lz4     = 1,    /* if built with liblz4 */
+    pcmk__codec_zstd    = 2,    /* if built with libzstd */
+};
+
+uint8_t pcmk__supported_codecs(void);
+enum pcmk__codec pcmk__best_codec(uint8_t accepted);
+const char *pcmk__codec_text(enum pcmk__codec codec);
+const char *pcmk__codec_ext(enum pcmk__codec codec);
+enum pcmk__codec pcmk__file_codec(void);
+unsigned int pcmk__decompressed_size(enum pcmk__codec codec, const char *data,
+                                     unsigned int length);
+bool pcmk__compress(enum pcmk__codec codec, const char *data,
+                    unsigned int length, unsigned int max, char **result,
+                    unsigned int *result_len);
+int pcmk__decompress(enum pcmk__codec codec, const char *data,
+                     unsigned int length, char *result,
+                     unsigned int *result_len);
 gint crm_alpha_sort(gconstpointer a, gconstpointer b);
 
 static inline char *
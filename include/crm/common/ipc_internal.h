@@ -10,9 +10,15 @@
 #ifndef PCMK__IPC_INTERNAL_H
 #define PCMK__IPC_INTERNAL_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <crm_config.h>  /* US_AUTH_GETPEEREID */
+#include <crm/common/ipc.h>
+#include <crm/common/ipcs.h>
+#include <crm/common/internal.h>    /* enum pcmk__codec */
 
 
 /* denotes "non yieldable PID" on FreeBSD, or actual PID1 in scenarios that
@@ -66,4 +72,32 @@
 int pcmk__ipc_is_authentic_process_active(const char *name, uid_t refuid,
                                           gid_t refgid, pid_t *gotpid);
 
+/* IPC header flags used only between Pacemaker's own clients and servers;
+ * the values must not overlap those of the public enum crm_ipc_flags
+ */
+enum pcmk__ipc_flags {
+    pcmk__ipc_binary        = 0x00000002, // Message is binary-encoded XML
+    pcmk__ipc_accept_binary = 0x00000004, // Sender can decode binary XML
+};
+
+ssize_t pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
+                              uint32_t max_send_size, bool binary,
+                              enum pcmk__codec codec, struct iovec **result);
+ssize_t pcmk__ipc_prepare_text_iov(uint32_t request, char *text,
+                                   uint32_t max_send_size,
+                                   enum pcmk__codec codec,
+                                   struct iovec **result);
+void pcmk__ipc_set_binary(crm_ipc_t *client, bool accept);
+xmlNode *pcmk__ipc_buffer_xml(crm_ipc_t *client);
+
+void pcmk__add_ipc_client_stats(xmlNode *parent);
+
+/* An IPC event that can be queued for many clients without copying it */
+typedef struct pcmk__ipc_shared_s pcmk__ipc_shared_t;
+
+pcmk__ipc_shared_t *pcmk__ipc_shared_new(struct iovec *iov);
+void pcmk__ipc_shared_unref(pcmk__ipc_shared_t *shared);
+ssize_t pcmk__ipcs_send_shared(crm_client_t *c, pcmk__ipc_shared_t *shared,
+                               enum crm_ipc_flags flags);
+
 #endif
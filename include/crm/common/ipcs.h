@@ -58,6 +58,7 @@ enum crm_client_flags
 {
     crm_client_flag_ipc_proxied    = 0x00001, /* ipc_proxy code only */
     crm_client_flag_ipc_privileged = 0x00002, /* root or cluster user */
+    crm_client_flag_ipc_binary     = 0x00004, /* client accepts binary XML */
 };
 
 struct crm_client_s {
@@ -92,6 +93,16 @@ struct crm_client_s {
 
     unsigned int queue_backlog; /* IPC queue length after last flush */
     unsigned int queue_max;     /* Evict client whose queue grows this big */
+
+    uint8_t codecs;             /* Compression codecs client can decompress */
+
+    /* Event queue flow control and statistics */
+    size_t queue_bytes;         /* Total size of queued events */
+    size_t queue_bytes_max;     /* Largest queue_bytes seen */
+    unsigned int flush_delay;   /* Current retry delay (ms) while blocked */
+    unsigned long long events_sent;     /* Events delivered so far */
+    unsigned long long latency_total;   /* Sum of event queue times (ms) */
+    unsigned int latency_max;           /* Longest event queue time (ms) */
 };
 
 extern GHashTable *client_connections;
@@ -30,6 +30,8 @@
 
 #  include <crm/crm.h>  /* transitively imports qblog.h */
 
+#  include <libxml/xpath.h>
+
 
 /*!
  * \brief Base for directing lib{xml2,xslt} log into standard libqb backend
@@ -133,4 +135,67 @@ do {
     }                                                                           \
 } while (0)
 
+/* internal XML search functions (from xml.c and xpath.c) */
+
+xmlNode *pcmk__xe_match(xmlNode *parent, const char *node_name,
+                        const char *attr_n, const char *attr_v);
+
+xmlXPathCompExprPtr pcmk__xpath_compile(const char *path);
+xmlXPathObjectPtr pcmk__xpath_search_compiled(xmlNode *xml_top,
+                                              xmlXPathCompExprPtr expr);
+xmlXPathObjectPtr pcmk__xpath_search_const(xmlNode *xml_top, const char *path,
+                                           xmlXPathCompExprPtr *expr);
+void pcmk__xpath_cleanup(void);
+
+/* internal binary XML encoding functions (from xml_binary.c) */
+
+char *pcmk__xml_binary_dump(xmlNode *xml, unsigned int *len);
+xmlNode *pcmk__xml_binary_parse(const char *data, size_t len);
+bool pcmk__xml_is_binary(const char *data, size_t len);
+
+/* internal patchset iteration functions (from patchset.c) */
+
+enum pcmk__cib_section {
+    pcmk__section_none,             // unknown, or outside any section
+    pcmk__section_cib,              // CIB root element itself
+    pcmk__section_configuration,
+    pcmk__section_status,
+};
+
+// One element of a patchset change's path
+typedef struct pcmk__path_step_s {
+    const char *name;
+    const char *id;                 // NULL if path doesn't give an ID
+} pcmk__path_step_t;
+
+typedef struct pcmk__patch_change_s {
+    const char *op;                 // create, modify, delete or move
+    const char *path;               // XPath of change (parent, for creates)
+    xmlNode *change;                // change element in patchset
+    xmlNode *result;                // created or modified element, if any
+    enum pcmk__cib_section section; // section that was changed
+
+    // IDs from path (or from result, for elements changed as a whole)
+    const char *node_id;            // node_state or lrm
+    const char *rsc_id;             // lrm_resource
+    const char *op_id;              // lrm_rsc_op
+
+    int n_steps;
+    pcmk__path_step_t *steps;       // parsed path
+} pcmk__patch_change_t;
+
+typedef int (*pcmk__patch_change_fn)(const pcmk__patch_change_t *change,
+                                     void *user_data);
+typedef void (*pcmk__rsc_op_fn)(xmlNode *rsc_op, const char *node_id,
+                                const char *rsc_id, void *user_data);
+
+int pcmk__patchset_foreach(xmlNode *patchset, pcmk__patch_change_fn fn,
+                           void *user_data);
+bool pcmk__patch_path_has(const pcmk__patch_change_t *change,
+                          const char *name);
+const char *pcmk__patch_path_id(const pcmk__patch_change_t *change,
+                                const char *name);
+void pcmk__patch_change_rsc_ops(const pcmk__patch_change_t *change,
+                                pcmk__rsc_op_fn fn, void *user_data);
+
 #endif
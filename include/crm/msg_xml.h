@@ -61,15 +61,20 @@ extern "C" {
 #  define F_CRM_USER			"crm_user"
 #  define F_CRM_JOIN_ID			"join_id"
 #  define F_CRM_DC_LEAVING      "dc-leaving"
+#  define F_CRM_JOIN_HISTORY    "join-history"
+#  define F_CRM_JOIN_SYNC       "join-sync"
 #  define F_CRM_ELECTION_ID		"election-id"
 #  define F_CRM_ELECTION_AGE_S		"election-age-sec"
 #  define F_CRM_ELECTION_AGE_US		"election-age-nano-sec"
 #  define F_CRM_ELECTION_OWNER		"election-owner"
 #  define F_CRM_TGRAPH			"crm-tgraph-file"
 #  define F_CRM_TGRAPH_INPUT		"crm-tgraph-in"
+#  define F_CRM_SCHED_PATCH		"crm-sched-patch"
+#  define F_CRM_SCHED_RESYNC		"crm-sched-resync"
 
 #  define F_CRM_THROTTLE_MODE		"crm-limit-mode"
 #  define F_CRM_THROTTLE_MAX		"crm-limit-max"
+#  define F_CRM_THROTTLE_REASON		"crm-limit-reason"
 
 /*---- Common tags/attrs */
 #  define XML_DIFF_MARKER		"__crm_diff_marker__"
@@ -125,6 +130,7 @@ extern "C" {
 #  define XML_PING_ATTR_CRMDSTATE   "crmd_state"
 
 #  define XML_TAG_FRAGMENT		"cib_fragment"
+#  define XML_TAG_SCHED_PATCHES		"sched-patches"
 
 #  define XML_FAIL_TAG_CIB		"failed_update"
 
@@ -226,6 +232,10 @@ extern "C" {
 #  define XML_LRM_TAG_RESOURCES     	"lrm_resources"
 #  define XML_LRM_TAG_RESOURCE     	"lrm_resource"
 #  define XML_LRM_TAG_RSC_OP		"lrm_rsc_op"
+#  define XML_LRM_ATTR_HISTORY_EPOCH	"history-epoch"
+#  define XML_LRM_ATTR_HISTORY_SEQ	"history-seq"
+#  define XML_LRM_ATTR_HISTORY_BASE	"history-base"
+#  define XML_LRM_ATTR_HISTORY_REMOVED	"history-removed"
 #  define XML_AGENT_ATTR_CLASS		"class"
 #  define XML_AGENT_ATTR_PROVIDER	"provider"
 
@@ -38,6 +38,10 @@ typedef struct synapse_s {
 
     GListPtr actions;           /* crm_action_t* */
     GListPtr inputs;            /* crm_action_t* */
+
+    int position;               /* index in graph's list of synapses */
+    int pending_inputs;         /* number of inputs not yet confirmed */
+    int counted;                /* state as last counted in graph statistics */
 } synapse_t;
 
 typedef struct crm_action_s {
@@ -101,6 +105,13 @@ struct crm_graph_s {
     GListPtr synapses;          /* synapse_t* */
 
     int migration_limit;
+
+    GHashTable *actions;        /* action ID -> crm_action_t* */
+    GHashTable *actions_by_key; /* operation key -> GList of crm_action_t* */
+    GHashTable *dependents;     /* action ID -> GList of synapse_t* with it as input */
+    GSequence *ready;           /* synapse_t* with all inputs confirmed, in graph order */
+    int num_failed;             /* synapses marked failed */
+    int num_waiting;            /* synapses not yet executed, confirmed or failed */
 };
 
 typedef struct crm_graph_functions_s {
@@ -126,6 +137,8 @@ void set_graph_functions(crm_graph_functions_t * fns);
 crm_graph_t *unpack_graph(xmlNode * xml_graph, const char *reference);
 int run_graph(crm_graph_t * graph);
 gboolean update_graph(crm_graph_t * graph, crm_action_t * action);
+crm_action_t *pcmk__graph_action(crm_graph_t *graph, int id);
+GList *pcmk__graph_actions_by_key(crm_graph_t *graph, const char *key);
 void destroy_graph(crm_graph_t * graph);
 const char *transition_status(enum transition_status state);
 void print_graph(unsigned int log_level, crm_graph_t * graph);
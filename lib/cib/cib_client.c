@@ -479,6 +479,45 @@ cib_client_add_notify_callback(cib_t * cib, const char *event,
     return pcmk_ok;
 }
 
+/*!
+ * \internal
+ * \brief Limit the change notifications sent to a CIB connection
+ *
+ * Ask the CIB manager to send T_CIB_DIFF_NOTIFY notifications to this
+ * connection only for patchsets with a change at, above, or below one of the
+ * given paths. Paths must be in the form used by v2 patchsets, for example
+ * "/cib/configuration/alerts" or "/cib/status/node_state[@id='1']". The
+ * filter applies to the connection as a whole (not individual callbacks), and
+ * is cleared when diff notifications are disabled.
+ *
+ * \param[in] cib    CIB connection with a T_CIB_DIFF_NOTIFY callback
+ * \param[in] paths  NULL-terminated list of CIB paths (NULL to clear filter)
+ *
+ * \return pcmk_ok on success, -errno otherwise
+ * \note The CIB manager may be an older version that ignores the filter, and
+ *       it does not filter legacy (v1) patchsets, so callbacks must still check
+ *       whether a change is of interest.
+ */
+int
+cib__set_diff_notify_filter(cib_t *cib, const char *const *paths)
+{
+    int rc = -EPROTONOSUPPORT;
+
+    CRM_CHECK(cib != NULL, return -EINVAL);
+
+    switch (cib->variant) {
+        case cib_native:
+            rc = cib_native_set_diff_notify_filter(cib, paths);
+            break;
+        case cib_remote:
+            rc = cib_remote_set_diff_notify_filter(cib, paths);
+            break;
+        default:
+            break;
+    }
+    return (rc > 0)? pcmk_ok : rc;
+}
+
 static int 
 get_notify_list_event_count(cib_t * cib, const char *event)
 {
@@ -163,9 +163,6 @@ cib_file_read_and_verify(const char *filename, const char *sigfile, xmlNode **ro
 
 #define CIB_SERIES "cib"
 #define CIB_SERIES_MAX 100
-#define CIB_SERIES_BZIP FALSE /* Must be false because archived copies are
-                                 created with hard links
-                               */
 
 #define CIB_LIVE_NAME CIB_SERIES ".xml"
 
@@ -224,23 +221,43 @@ cib_file_backup(const char *cib_dirname, const char *cib_filename)
     char *cib_path = crm_concat(cib_dirname, cib_filename, '/');
     char *cib_digest = crm_concat(cib_path, "sig", '.');
 
+    /* Archives are compressed when a codec faster than bzip2 is available,
+     * and otherwise are hard links to the previous CIB
+     */
+    gboolean compress = (pcmk__file_codec() != pcmk__codec_bzip2);
+
     /* Figure out what backup file sequence number to use */
     int seq = get_last_sequence(cib_dirname, CIB_SERIES);
     char *backup_path = generate_series_filename(cib_dirname, CIB_SERIES, seq,
-                                                 CIB_SERIES_BZIP);
+                                                 compress);
+    char *other_path = generate_series_filename(cib_dirname, CIB_SERIES, seq,
+                                                !compress);
     char *backup_digest = crm_concat(backup_path, "sig", '.');
+    char *other_digest = crm_concat(other_path, "sig", '.');
+    int archive_rc = pcmk_ok;
 
     CRM_ASSERT((cib_path != NULL) && (cib_digest != NULL)
-               && (backup_path != NULL) && (backup_digest != NULL));
+               && (backup_path != NULL) && (backup_digest != NULL)
+               && (other_path != NULL) && (other_digest != NULL));
 
-    /* Remove the old backups if they exist */
+    /* Remove the old backups if they exist (including any left with the other
+     * extension, for example by a build with different compression support)
+     */
     unlink(backup_path);
     unlink(backup_digest);
+    unlink(other_path);
+    unlink(other_digest);
 
-    /* Back up the CIB, by hard-linking it to the backup name */
-    if ((link(cib_path, backup_path) < 0) && (errno != ENOENT)) {
-        crm_perror(LOG_ERR, "Could not archive %s by linking to %s",
-                   cib_path, backup_path);
+    /* Back up the CIB */
+    if (compress) {
+        archive_rc = pcmk__compress_file(cib_path, backup_path);
+    } else if (link(cib_path, backup_path) < 0) {
+        archive_rc = -errno;
+    }
+
+    if ((archive_rc != pcmk_ok) && (archive_rc != -ENOENT)) {
+        crm_err("Could not archive %s as %s: %s " CRM_XS " rc=%d",
+                cib_path, backup_path, pcmk_strerror(archive_rc), archive_rc);
         rc = -1;
 
     /* Back up the CIB signature similarly */
@@ -279,6 +296,8 @@ cib_file_backup(const char *cib_dirname, const char *cib_filename)
     free(cib_digest);
     free(backup_path);
     free(backup_digest);
+    free(other_path);
+    free(other_digest);
     return rc;
 }
 
@@ -293,7 +312,7 @@ cib_file_backup(const char *cib_dirname, const char *cib_filename)
  *
  * \return void
  */
-static void
+void
 cib_file_prepare_xml(xmlNode *root)
 {
     xmlNode *cib_status_root = NULL;
@@ -678,9 +697,12 @@ cib_file_signoff(cib_t * cib)
 
         /* Otherwise, it's a simple write */
         } else {
-            gboolean do_bzip = crm_ends_with_ext(private->filename, ".bz2");
+            gboolean do_compress = crm_ends_with_ext(private->filename, ".bz2")
+                                   || crm_ends_with_ext(private->filename,
+                                                        ".zst");
 
-            if (write_xml_file(in_mem_cib, private->filename, do_bzip) <= 0) {
+            if (write_xml_file(in_mem_cib, private->filename,
+                               do_compress) <= 0) {
                 rc = pcmk_err_generic;
             }
         }
@@ -740,6 +762,7 @@ static struct cib_func_entry cib_file_ops[] = {
     {CIB_OP_DELETE,     FALSE, cib_process_delete},
     {CIB_OP_ERASE,      FALSE, cib_process_erase},
     {CIB_OP_UPGRADE,    FALSE, cib_process_upgrade},
+    {CIB_OP_MULTI,      FALSE, cib_process_multi},
 };
 /* *INDENT-ON* */
 
@@ -26,6 +26,7 @@
 
 #include <crm/msg_xml.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
 
 typedef struct cib_native_opaque_s {
     char *token;
@@ -92,6 +93,7 @@ cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userda
     xmlNode *msg = NULL;
 
     cib_t *cib = userdata;
+    cib_native_opaque_t *native = NULL;
 
     crm_trace("dispatching %p", userdata);
 
@@ -100,7 +102,11 @@ cib_native_dispatch_internal(const char *buffer, ssize_t length, gpointer userda
         return 0;
     }
 
-    msg = string2xml(buffer);
+    /* buffer is always the connection's IPC buffer, which may hold binary XML
+     * rather than text
+     */
+    native = cib->variant_opaque;
+    msg = pcmk__ipc_buffer_xml(native->ipc);
 
     if (msg == NULL) {
         crm_warn("Received a NULL message from the CIB manager");
@@ -141,10 +147,11 @@ cib_native_dispatch(cib_t * cib)
     native = cib->variant_opaque;
     while (crm_ipc_ready(native->ipc)) {
 
-        if (crm_ipc_read(native->ipc) > 0) {
-            const char *msg = crm_ipc_buffer(native->ipc);
+        long len = crm_ipc_read(native->ipc);
 
-            cib_native_dispatch_internal(msg, strlen(msg), cib);
+        if (len > 0) {
+            cib_native_dispatch_internal(crm_ipc_buffer(native->ipc), len,
+                                         cib);
         }
 
         if (crm_ipc_connected(native->ipc) == FALSE) {
@@ -231,6 +238,11 @@ cib_native_signon_raw(cib_t * cib, const char *name, enum cib_conn_type type, in
         xmlNode *reply = NULL;
         xmlNode *hello = create_xml_node(NULL, "cib_command");
 
+        /* All messages on this connection are parsed with
+         * pcmk__ipc_buffer_xml(), so let the server send binary XML
+         */
+        pcmk__ipc_set_binary(native->ipc, TRUE);
+
         crm_xml_add(hello, F_TYPE, T_CIB);
         crm_xml_add(hello, F_CIB_OPERATION, CRM_OP_REGISTER);
         crm_xml_add(hello, F_CIB_CLIENTNAME, name);
@@ -485,17 +497,13 @@ cib_native_set_connection_dnotify(cib_t * cib, void (*dnotify) (gpointer user_da
     return pcmk_ok;
 }
 
-int
-cib_native_register_notification(cib_t * cib, const char *callback, int enabled)
+static int
+cib_native_send_notify_request(cib_t *cib, xmlNode *notify_msg)
 {
     int rc = pcmk_ok;
-    xmlNode *notify_msg = create_xml_node(NULL, "cib-callback");
     cib_native_opaque_t *native = cib->variant_opaque;
 
     if (cib->state != cib_disconnected) {
-        crm_xml_add(notify_msg, F_CIB_OPERATION, T_CIB_NOTIFY);
-        crm_xml_add(notify_msg, F_CIB_NOTIFY_TYPE, callback);
-        crm_xml_add_int(notify_msg, F_CIB_NOTIFY_ACTIVATE, enabled);
         rc = crm_ipc_send(native->ipc, notify_msg, crm_ipc_client_response,
                           1000 * cib->call_timeout, NULL);
         if (rc <= 0) {
@@ -507,3 +515,20 @@ cib_native_register_notification(cib_t * cib, const char *callback, int enabled)
     free_xml(notify_msg);
     return rc;
 }
+
+int
+cib_native_register_notification(cib_t * cib, const char *callback, int enabled)
+{
+    return cib_native_send_notify_request(cib,
+                                          cib__create_notify_request(callback,
+                                                                     enabled,
+                                                                     NULL));
+}
+
+int
+cib_native_set_diff_notify_filter(cib_t *cib, const char *const *paths)
+{
+    return cib_native_send_notify_request(cib,
+                                          cib__create_notify_request(T_CIB_DIFF_NOTIFY,
+                                                                     1, paths));
+}
@@ -803,6 +803,119 @@ cib_process_xpath(const char *op, int options, const char *section, xmlNode * re
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Look up the function implementing one step of a CIB transaction
+ *
+ * \param[in] op       Operation requested by the step
+ * \param[in] section  Section the step applies to
+ * \param[in] input    Data supplied with the step
+ *
+ * \return Operation function, or NULL if \p op may not be part of a transaction
+ */
+static cib_op_t
+transaction_step_fn(const char *op, const char *section, xmlNode *input)
+{
+    if (safe_str_eq(op, CIB_OP_CREATE)) {
+        return cib_process_create;
+
+    } else if (safe_str_eq(op, CIB_OP_MODIFY)) {
+        return cib_process_modify;
+
+    } else if (safe_str_eq(op, CIB_OP_DELETE)) {
+        return cib_process_delete;
+
+    } else if (safe_str_eq(op, CIB_OP_REPLACE)) {
+        /* Replacing the whole CIB has side effects (version checks, sync state)
+         * that make no sense in the middle of a transaction.
+         */
+        if ((section == NULL)
+            || safe_str_eq(section, XML_CIB_TAG_SECTION_ALL)
+            || safe_str_eq(crm_element_name(input), XML_TAG_CIB)) {
+            return NULL;
+        }
+        return cib_process_replace;
+    }
+    return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Apply an ordered list of CIB modifications as a single operation
+ *
+ * Each child F_CIB_COMMAND element of \p input describes one step, using the
+ * same fields as a stand-alone request (operation, section, call options and
+ * call data). Steps are applied in order to \p result_cib, stopping at the
+ * first failure. Because cib_perform_op() works on a scratch copy, a failure
+ * leaves the CIB untouched, and on success the caller validates, diffs and
+ * notifies once for the whole transaction.
+ *
+ * \return pcmk_ok on success, -errno otherwise
+ */
+int
+cib_process_multi(const char *op, int options, const char *section, xmlNode * req,
+                  xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
+                  xmlNode ** answer)
+{
+    int rc = pcmk_ok;
+    int step = 0;
+    xmlNode *command = NULL;
+    const int step_options = cib_xpath|cib_multiple|cib_can_create|cib_mixed_update;
+
+    crm_trace("Processing \"%s\" event", op);
+    *answer = NULL;
+
+    if ((input == NULL) || safe_str_neq(crm_element_name(input), F_CIB_TRANSACTION)) {
+        crm_err("Cannot perform %s without a transaction", op);
+        return -EINVAL;
+    }
+
+    for (command = first_named_child(input, F_CIB_COMMAND); command != NULL;
+         command = crm_next_same_xml(command)) {
+
+        int call_options = 0;
+        xmlNode *output = NULL;
+        const char *sub_op = crm_element_value(command, F_CIB_OPERATION);
+        const char *sub_section = crm_element_value(command, F_CIB_SECTION);
+        xmlNode *data = get_message_xml(command, F_CIB_CALLDATA);
+        cib_op_t fn = NULL;
+
+        step++;
+        crm_element_value_int(command, F_CIB_CALLOPTS, &call_options);
+        call_options = (call_options & step_options) | (options & ~step_options);
+
+        if (((call_options & cib_xpath) == 0) && (data != NULL)
+            && (sub_section != NULL)
+            && safe_str_eq(crm_element_name(data), XML_TAG_CIB)) {
+            data = get_object_root(sub_section, data);
+        }
+
+        fn = transaction_step_fn(sub_op, sub_section, data);
+        if (fn == NULL) {
+            crm_err("Cannot perform %s: step %d (%s) is not allowed in a transaction",
+                    op, step, crm_str(sub_op));
+            rc = -EOPNOTSUPP;
+            break;
+        }
+
+        crm_trace("Transaction step %d: %s of %s", step, sub_op, crm_str(sub_section));
+        rc = fn(sub_op, call_options, sub_section, command, data, *result_cib,
+                result_cib, &output);
+        free_xml(output);
+
+        if (rc != pcmk_ok) {
+            crm_info("Transaction step %d (%s of %s) failed: %s",
+                     step, sub_op, crm_str(sub_section), pcmk_strerror(rc));
+            break;
+        }
+    }
+
+    if ((rc == pcmk_ok) && (step == 0)) {
+        crm_debug("Ignoring empty %s transaction", op);
+    }
+    return rc;
+}
+
 /* remove this function */
 gboolean
 update_results(xmlNode * failed, xmlNode * target, const char *operation, int return_code)
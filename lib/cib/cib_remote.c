@@ -88,19 +88,32 @@ cib_remote_set_connection_dnotify(cib_t * cib, void (*dnotify) (gpointer user_da
 }
 
 static int
-cib_remote_register_notification(cib_t * cib, const char *callback, int enabled)
+cib_remote_send_notify_request(cib_t *cib, xmlNode *notify_msg)
 {
-    xmlNode *notify_msg = create_xml_node(NULL, "cib_command");
     cib_remote_opaque_t *private = cib->variant_opaque;
 
-    crm_xml_add(notify_msg, F_CIB_OPERATION, T_CIB_NOTIFY);
-    crm_xml_add(notify_msg, F_CIB_NOTIFY_TYPE, callback);
-    crm_xml_add_int(notify_msg, F_CIB_NOTIFY_ACTIVATE, enabled);
     crm_remote_send(&private->callback, notify_msg);
     free_xml(notify_msg);
     return pcmk_ok;
 }
 
+static int
+cib_remote_register_notification(cib_t * cib, const char *callback, int enabled)
+{
+    return cib_remote_send_notify_request(cib,
+                                          cib__create_notify_request(callback,
+                                                                     enabled,
+                                                                     NULL));
+}
+
+int
+cib_remote_set_diff_notify_filter(cib_t *cib, const char *const *paths)
+{
+    return cib_remote_send_notify_request(cib,
+                                          cib__create_notify_request(T_CIB_DIFF_NOTIFY,
+                                                                     1, paths));
+}
+
 cib_t *
 cib_remote_new(const char *server, const char *user, const char *passwd, int port,
                gboolean encrypted)
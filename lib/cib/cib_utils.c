@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
 #include <sys/utsname.h>
 
 #include <glib.h>
@@ -22,6 +24,7 @@
 #include <crm/msg_xml.h>
 #include <crm/common/iso8601_internal.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include <crm/pengine/rules.h>
 
 struct config_root_s {
@@ -201,6 +204,152 @@ cib_acl_enabled(xmlNode *xml, const char *user)
     return rc;
 }
 
+static cib_op_times_t last_op_times = { 0, 0 };
+
+#define STATUS_PATH "/" XML_TAG_CIB "/" XML_CIB_TAG_STATUS
+
+static bool
+is_counter(const char *value)
+{
+    if ((value == NULL) || (*value == '\0')) {
+        return FALSE;
+    }
+    for (; *value != '\0'; value++) {
+        if (!isdigit((int) *value)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a change to the CIB root element could affect validity
+ *
+ * \param[in] change  Patchset change modifying the CIB root
+ *
+ * \return TRUE if the root now needs to be validated, FALSE otherwise
+ */
+static bool
+root_change_needs_validation(xmlNode *change)
+{
+    xmlNode *attr = NULL;
+    xmlNode *list = first_named_child(change, XML_DIFF_LIST);
+
+    for (attr = first_named_child(list, XML_DIFF_ATTR); attr != NULL;
+         attr = crm_next_same_xml(attr)) {
+
+        const char *name = crm_element_value(attr, XML_NVPAIR_ATTR_NAME);
+        const char *value = crm_element_value(attr, XML_NVPAIR_ATTR_VALUE);
+
+        if (safe_str_neq(crm_element_value(attr, XML_DIFF_OP), "set")) {
+            return TRUE;
+
+        } else if (safe_str_eq(name, XML_ATTR_NUMUPDATES)
+                   || safe_str_eq(name, XML_ATTR_GENERATION)
+                   || safe_str_eq(name, XML_ATTR_GENERATION_ADMIN)) {
+            if (!is_counter(value)) {
+                return TRUE;
+            }
+
+        } else if (safe_str_neq(name, XML_ATTR_UPDATE_ORIG)
+                   && safe_str_neq(name, XML_ATTR_UPDATE_CLIENT)
+                   && safe_str_neq(name, XML_ATTR_UPDATE_USER)
+                   && safe_str_neq(name, XML_CIB_ATTR_WRITTEN)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a CIB change requires the result to be validated
+ *
+ * Every CIB schema defines the status section as free-form, so a change
+ * confined to the contents of the status section (plus the version counters
+ * and update-* attributes that accompany every change) cannot make a valid CIB
+ * invalid. Anything else requires validation of the whole document.
+ *
+ * \param[in] patchset  Patchset describing the change
+ *
+ * \return TRUE if the changed CIB must be validated, FALSE otherwise
+ */
+static bool
+cib_change_needs_validation(xmlNode *patchset)
+{
+    int format = 1;
+    xmlNode *change = NULL;
+
+    if (patchset == NULL) {
+        return TRUE;
+    }
+    crm_element_value_int(patchset, "format", &format);
+    if (format != 2) {
+        return TRUE;
+    }
+
+    for (change = first_named_child(patchset, XML_DIFF_CHANGE); change != NULL;
+         change = crm_next_same_xml(change)) {
+
+        const char *op = crm_element_value(change, XML_DIFF_OP);
+        const char *path = crm_element_value(change, XML_DIFF_PATH);
+
+        if (path == NULL) {
+            return TRUE;
+
+        } else if (safe_str_eq(path, "/" XML_TAG_CIB)) {
+            if (safe_str_neq(op, "modify")
+                || root_change_needs_validation(change)) {
+                return TRUE;
+            }
+
+        } else if (safe_str_eq(path, STATUS_PATH)) {
+            /* Changes of the status element itself (rather than its
+             * contents) could affect its placement
+             */
+            if (safe_str_neq(op, "modify") && safe_str_neq(op, "create")) {
+                return TRUE;
+            }
+
+        } else if (!crm_starts_with(path, STATUS_PATH "/")) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Get the current time in microseconds, for measuring intervals
+ *
+ * \return Current value of a monotonic clock (if available) in microseconds
+ */
+long long
+cib_now_us(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+    }
+#endif
+    return time(NULL) * 1000000LL;
+}
+
+/*!
+ * \internal
+ * \brief Get the phase timings of the most recent cib_perform_op() call
+ *
+ * \return Timings (valid until the next cib_perform_op() call)
+ */
+const cib_op_times_t *
+cib_last_op_times(void)
+{
+    return &last_op_times;
+}
+
 int
 cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_query,
                const char *section, xmlNode * req, xmlNode * input,
@@ -217,6 +366,10 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
     static struct qb_log_callsite *diff_cs = NULL;
     const char *user = crm_element_value(req, F_CIB_USER);
     bool with_digest = FALSE;
+    long long started = 0;
+
+    last_op_times.validate_us = 0;
+    last_op_times.diff_us = 0;
 
     crm_trace("Begin %s%s%s op", is_set(call_options, cib_dryrun)?"dry-run of ":"", is_query ? "read-only " : "", op);
 
@@ -358,6 +511,7 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
     strip_text_nodes(scratch);
     fix_plus_plus_recursive(scratch);
 
+    started = cib_now_us();
     if (is_set(call_options, cib_zero_copy)) {
         /* At this point, current_cib is just the 'cib' tag and its properties,
          *
@@ -391,6 +545,7 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
         xml_log_patchset(LOG_INFO, __FUNCTION__, local_diff);
         crm_log_xml_trace(local_diff, "raw patch");
     }
+    last_op_times.diff_us = cib_now_us() - started;
 
     if (is_not_set(call_options, cib_zero_copy) /* The original to compare against doesn't exist */
         && local_diff
@@ -461,13 +616,20 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
     }
 
     crm_trace("Perform validation: %s", (check_schema? "true" : "false"));
-    if ((rc == pcmk_ok) && check_schema && !validate_xml(scratch, NULL, TRUE)) {
-        const char *current_schema = crm_element_value(scratch,
-                                                       XML_ATTR_VALIDATION);
-
-        crm_warn("Updated CIB does not validate against %s schema",
-                 crm_str(current_schema));
-        rc = -pcmk_err_schema_validation;
+    if ((rc == pcmk_ok) && check_schema && !cib_change_needs_validation(local_diff)) {
+        crm_trace("Skipping validation of status-only change");
+
+    } else if ((rc == pcmk_ok) && check_schema) {
+        started = cib_now_us();
+        if (!validate_xml(scratch, NULL, TRUE)) {
+            const char *current_schema = crm_element_value(scratch,
+                                                           XML_ATTR_VALIDATION);
+
+            crm_warn("Updated CIB does not validate against %s schema",
+                     crm_str(current_schema));
+            rc = -pcmk_err_schema_validation;
+        }
+        last_op_times.validate_us = cib_now_us() - started;
     }
 
   done:
@@ -680,6 +842,83 @@ cib_read_config(GHashTable * options, xmlNode * current_cib)
     return TRUE;
 }
 
+/*!
+ * \internal
+ * \brief Create an empty CIB transaction
+ *
+ * \return Newly allocated transaction, to be filled in with
+ *         cib_transaction_add() and submitted with cib_transaction_commit()
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+cib_transaction_new(void)
+{
+    return create_xml_node(NULL, F_CIB_TRANSACTION);
+}
+
+/*!
+ * \internal
+ * \brief Append a step to a CIB transaction
+ *
+ * \param[in,out] transaction   Transaction created by cib_transaction_new()
+ * \param[in]     op            One of CIB_OP_CREATE, CIB_OP_MODIFY,
+ *                              CIB_OP_DELETE or CIB_OP_REPLACE (the latter for
+ *                              a single section only)
+ * \param[in]     section       CIB section (or XPath, with cib_xpath)
+ * \param[in]     data          Step input (copied)
+ * \param[in]     call_options  Any of cib_xpath, cib_multiple, cib_can_create
+ *                              and cib_mixed_update (other options are taken
+ *                              from the transaction as a whole)
+ *
+ * \return pcmk_ok on success, -errno otherwise
+ */
+int
+cib_transaction_add(xmlNode *transaction, const char *op, const char *section,
+                    xmlNode *data, int call_options)
+{
+    xmlNode *command = NULL;
+
+    CRM_CHECK((transaction != NULL) && (op != NULL), return -EINVAL);
+
+    command = create_xml_node(transaction, F_CIB_COMMAND);
+    crm_xml_add(command, F_CIB_OPERATION, op);
+    crm_xml_add(command, F_CIB_SECTION, section);
+    crm_xml_add_int(command, F_CIB_CALLOPTS, call_options);
+    if (data != NULL) {
+        add_message_xml(command, F_CIB_CALLDATA, data);
+    }
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Apply a CIB transaction atomically
+ *
+ * All steps are applied in order, or none are. The result is validated, and
+ * peers and notification clients are updated, once for the whole transaction.
+ *
+ * \param[in] cib           CIB connection
+ * \param[in] transaction   Transaction built with cib_transaction_add()
+ * \param[in] host          Node to send the request to (or NULL for any)
+ * \param[in] call_options  Group of enum cib_call_options flags
+ * \param[in] user_name     User to apply ACLs as (or NULL for the caller)
+ *
+ * \return Call ID for asynchronous requests, otherwise pcmk_ok on success
+ *         or -errno on failure (including that of the first failing step)
+ */
+int
+cib_transaction_commit(cib_t *cib, xmlNode *transaction, const char *host,
+                       int call_options, const char *user_name)
+{
+    CRM_CHECK((cib != NULL) && (transaction != NULL), return -EINVAL);
+
+    if (cib->state == cib_disconnected) {
+        return -ENOTCONN;
+    }
+    return cib_internal_op(cib, CIB_OP_MULTI, host, NULL, transaction, NULL,
+                           call_options, user_name);
+}
+
 int
 cib_apply_patch_event(xmlNode * event, xmlNode * input, xmlNode ** output, int level)
 {
@@ -729,10 +968,13 @@ cib_apply_patch_event(xmlNode * event, xmlNode * input, xmlNode ** output, int l
 gboolean
 cib_internal_config_changed(xmlNode *diff)
 {
+    static xmlXPathCompExprPtr config_change = NULL;
     gboolean changed = FALSE;
 
     if (diff) {
-        xmlXPathObject *xpathObj = xpath_search(diff, XPATH_CONFIG_CHANGE);
+        xmlXPathObject *xpathObj = pcmk__xpath_search_const(diff,
+                                                            XPATH_CONFIG_CHANGE,
+                                                            &config_change);
 
         if (numXpathResults(xpathObj) > 0) {
             changed = TRUE;
@@ -760,3 +1002,34 @@ cib_internal_op(cib_t * cib, const char *op, const char *host,
 
     return delegate(cib, op, host, section, data, output_data, call_options, user_name);
 }
+
+/*!
+ * \internal
+ * \brief Create a request to (un)register for a type of CIB notification
+ *
+ * \param[in] event    Notification type (such as T_CIB_DIFF_NOTIFY)
+ * \param[in] enabled  Whether to enable (1) or disable (0) notifications
+ * \param[in] paths    For T_CIB_DIFF_NOTIFY, NULL-terminated list of CIB
+ *                     paths that the client wants to hear about changes to,
+ *                     or NULL for all changes
+ *
+ * \return Newly created request
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+cib__create_notify_request(const char *event, int enabled,
+                           const char *const *paths)
+{
+    xmlNode *notify_msg = create_xml_node(NULL, "cib-callback");
+
+    crm_xml_add(notify_msg, F_CIB_OPERATION, T_CIB_NOTIFY);
+    crm_xml_add(notify_msg, F_CIB_NOTIFY_TYPE, event);
+    crm_xml_add_int(notify_msg, F_CIB_NOTIFY_ACTIVATE, enabled);
+
+    for (; (paths != NULL) && (*paths != NULL); paths++) {
+        xmlNode *filter = create_xml_node(notify_msg, F_CIB_NOTIFY_FILTER);
+
+        crm_xml_add(filter, XML_DIFF_PATH, *paths);
+    }
+    return notify_msg;
+}
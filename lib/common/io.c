@@ -68,7 +68,8 @@ crm_build_path(const char *path_c, mode_t mode)
  * \param[in] directory Directory that contains the file series
  * \param[in] series Start of file name
  * \param[in] sequence Sequence number (MUST be less than 33 digits)
- * \param[in] bzip Whether to use ".bz2" instead of ".raw" as extension
+ * \param[in] bzip Whether to use the extension for compressed files (as
+ *                 chosen by pcmk__file_codec()) instead of ".raw"
  *
  * \return Newly allocated file path, or NULL on error
  * \note Caller is responsible for freeing the returned memory
@@ -82,11 +83,86 @@ generate_series_filename(const char *directory, const char *series, int sequence
     CRM_CHECK(series != NULL, return NULL);
 
     if (bzip) {
-        ext = "bz2";
+        ext = pcmk__codec_ext(pcmk__file_codec());
     }
     return crm_strdup_printf("%s/%s-%d.%s", directory, series, sequence, ext);
 }
 
+/*!
+ * \internal
+ * \brief Write a compressed copy of a file
+ *
+ * \param[in] source  Name of file to copy
+ * \param[in] target  Name of file to create or replace (should use the
+ *                    extension for the codec chosen by pcmk__file_codec())
+ *
+ * \return pcmk_ok on success, -errno otherwise (-ENOENT if \p source does not
+ *         exist)
+ */
+int
+pcmk__compress_file(const char *source, const char *target)
+{
+    gchar *data = NULL;
+    gsize length = 0;
+    char *compressed = NULL;
+    unsigned int compressed_len = 0;
+    GError *error = NULL;
+    int fd = -1;
+    int rc = pcmk_ok;
+
+    CRM_CHECK((source != NULL) && (target != NULL), return -EINVAL);
+
+    if (!g_file_get_contents(source, &data, &length, &error)) {
+        rc = (error->code == G_FILE_ERROR_NOENT)? -ENOENT : -EIO;
+        if (rc != -ENOENT) {
+            crm_err("Could not read %s: %s", source, error->message);
+        }
+        g_error_free(error);
+        return rc;
+    }
+
+    if (!pcmk__compress(pcmk__file_codec(), data, (unsigned int) length, 0,
+                        &compressed, &compressed_len)) {
+        rc = -EILSEQ;
+        goto done;
+    }
+
+    fd = open(target, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    if (fd < 0) {
+        rc = -errno;
+        crm_perror(LOG_ERR, "Could not open %s for writing", target);
+        goto done;
+    }
+    for (unsigned int written = 0; written < compressed_len; ) {
+        ssize_t n = write(fd, compressed + written, compressed_len - written);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -errno;
+            crm_perror(LOG_ERR, "Could not write %s", target);
+            break;
+        }
+        written += (unsigned int) n;
+    }
+    if ((rc == pcmk_ok) && (fsync(fd) < 0)) {
+        rc = -errno;
+        crm_perror(LOG_ERR, "Could not synchronize %s", target);
+    }
+    close(fd);
+
+    if (rc == pcmk_ok) {
+        crm_trace("Compressed %s (%lu bytes) into %s (%u bytes)",
+                  source, (unsigned long) length, target, compressed_len);
+    }
+
+  done:
+    g_free(data);
+    free(compressed);
+    return rc;
+}
+
 /*!
  * \internal
  * \brief Read and return sequence number stored in a file series' .last file
@@ -30,7 +30,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <bzlib.h>
+#include <time.h>
 
 #include <crm/crm.h>   /* indirectly: pcmk_err_generic */
 #include <crm/msg_xml.h>
@@ -38,18 +38,44 @@
 #include <crm/common/ipcs.h>
 
 #include <crm/common/ipc_internal.h>  /* PCMK__SPECIAL_PID* */
+#include <crm/common/xml_internal.h>
 
 #define PCMK_IPC_VERSION 1
 
-/* Evict clients whose event queue grows this large (by default) */
+/* Evict clients whose event queue grows this many messages long (by default),
+ * or this many bytes large (or four maximum-size messages, if that's more)
+ */
 #define PCMK_IPC_DEFAULT_QUEUE_MAX 500
+#define PCMK_IPC_QUEUE_BYTES_MAX (16 * 1024 * 1024)
+
+/* Send at most this many events to a client before letting other mainloop
+ * sources run
+ */
+#define PCMK_IPC_FLUSH_BATCH 100
+
+/* When a client's event buffer is full, retry after this long (in ms),
+ * doubling each time nothing could be sent up to the maximum
+ */
+#define PCMK_IPC_FLUSH_DELAY_MIN 5
+#define PCMK_IPC_FLUSH_DELAY_MAX 1000
+
+/* When a codec faster than bzip2 is available on both ends, compress messages
+ * at least this big even if they would fit in the IPC buffer uncompressed
+ */
+#define PCMK_IPC_COMPRESS_THRESHOLD (16 * 1024)
 
+/* The codec fields occupy what used to be trailing padding (and is zeroed by
+ * older senders, meaning bzip2 and no other codecs accepted), so the size of
+ * the header is unchanged
+ */
 struct crm_ipc_response_header {
     struct qb_ipc_response_header qb;
     uint32_t size_uncompressed;
     uint32_t size_compressed;
     uint32_t flags;
     uint8_t  version; /* Protect against version changes for anyone that might bother to statically link us */
+    uint8_t  codec;   /* enum pcmk__codec used, if compressed */
+    uint8_t  codecs;  /* Bitmask of codecs the sender can decompress */
 };
 
 static int hdr_offset = 0;
@@ -431,19 +457,133 @@ pcmk_free_ipc_event(struct iovec *event)
     }
 }
 
+/* A message prepared once to be sent as an event to any number of clients.
+ * Each client's queued event gets its own copy of the (small) header, since
+ * that holds client-specific fields, but they all share the payload.
+ */
+struct pcmk__ipc_shared_s {
+    unsigned int refs;
+    struct iovec *iov;  // as created by pcmk__ipc_prepare_iov()
+};
+
+// An event queued for a client
+typedef struct queued_event_s {
+    struct iovec iov[2];
+    pcmk__ipc_shared_t *shared; // owner of iov[1].iov_base if not NULL
+    long long queued;           // when the event was queued (monotonic ms)
+} queued_event_t;
+
+// Current time in milliseconds, for measuring intervals
+static long long
+ipc_now_ms(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000);
+    }
+#endif
+    return time(NULL) * 1000LL;
+}
+
+/*!
+ * \internal
+ * \brief Create a shareable IPC event from a prepared I/O vector
+ *
+ * \param[in] iov  I/O vector created by pcmk__ipc_prepare_iov() (the result
+ *                 takes ownership of it)
+ *
+ * \return Newly allocated shared event, with one reference held by the caller
+ * \note The caller is responsible for releasing its reference with
+ *       pcmk__ipc_shared_unref().
+ */
+pcmk__ipc_shared_t *
+pcmk__ipc_shared_new(struct iovec *iov)
+{
+    pcmk__ipc_shared_t *shared = NULL;
+
+    CRM_CHECK(iov != NULL, return NULL);
+    shared = calloc(1, sizeof(pcmk__ipc_shared_t));
+    CRM_ASSERT(shared != NULL);
+    shared->refs = 1;
+    shared->iov = iov;
+    return shared;
+}
+
+/*!
+ * \internal
+ * \brief Release a reference to a shared IPC event
+ *
+ * \param[in] shared  Shared event to release (freed with its last reference)
+ */
+void
+pcmk__ipc_shared_unref(pcmk__ipc_shared_t *shared)
+{
+    if ((shared != NULL) && (--(shared->refs) == 0)) {
+        pcmk_free_ipc_event(shared->iov);
+        free(shared);
+    }
+}
+
 static void
 free_event(gpointer data)
 {
-    pcmk_free_ipc_event((struct iovec *) data);
+    queued_event_t *event = data;
+
+    free(event->iov[0].iov_base);
+    if (event->shared == NULL) {
+        free(event->iov[1].iov_base);
+    } else {
+        pcmk__ipc_shared_unref(event->shared);
+    }
+    free(event);
 }
 
 static void
-add_event(crm_client_t *c, struct iovec *iov)
+queue_event(crm_client_t *c, queued_event_t *event)
 {
     if (c->event_queue == NULL) {
         c->event_queue = g_queue_new();
     }
-    g_queue_push_tail(c->event_queue, iov);
+    event->queued = ipc_now_ms();
+    c->queue_bytes += event->iov[0].iov_len + event->iov[1].iov_len;
+    c->queue_bytes_max = QB_MAX(c->queue_bytes, c->queue_bytes_max);
+    g_queue_push_tail(c->event_queue, event);
+}
+
+// Queue an I/O vector as an event, taking ownership of it
+static void
+add_event(crm_client_t *c, struct iovec *iov)
+{
+    queued_event_t *event = calloc(1, sizeof(queued_event_t));
+
+    CRM_ASSERT(event != NULL);
+    event->iov[0] = iov[0];
+    event->iov[1] = iov[1];
+    free(iov);
+    queue_event(c, event);
+}
+
+// Queue a shared event, returning the client's own copy of its header
+static struct crm_ipc_response_header *
+add_shared_event(crm_client_t *c, pcmk__ipc_shared_t *shared)
+{
+    queued_event_t *event = calloc(1, sizeof(queued_event_t));
+
+    CRM_ASSERT(event != NULL);
+    event->iov[0].iov_len = shared->iov[0].iov_len;
+    event->iov[0].iov_base = malloc(shared->iov[0].iov_len);
+    CRM_ASSERT(event->iov[0].iov_base != NULL);
+    memcpy(event->iov[0].iov_base, shared->iov[0].iov_base,
+           shared->iov[0].iov_len);
+
+    event->iov[1] = shared->iov[1];
+    event->shared = shared;
+    shared->refs++;
+
+    queue_event(c, event);
+    return event->iov[0].iov_base;
 }
 
 void
@@ -492,7 +632,8 @@ crm_client_destroy(crm_client_t * c)
  * \brief Raise IPC eviction threshold for a client, if allowed
  *
  * \param[in,out] client     Client to modify
- * \param[in]     queue_max  New threshold (as string)
+ * \param[in]     queue_max  New threshold (as string), in multiples of the
+ *                           maximum IPC message size
  *
  * \return TRUE if change was allowed, FALSE otherwise
  */
@@ -510,6 +651,49 @@ crm_set_client_queue_max(crm_client_t *client, const char *qmax)
     return FALSE;
 }
 
+static void
+add_ull(xmlNode *xml, const char *name, unsigned long long value)
+{
+    char *s = crm_strdup_printf("%llu", value);
+
+    crm_xml_add(xml, name, s);
+    free(s);
+}
+
+/*!
+ * \internal
+ * \brief Add event queue statistics for each connected client to XML
+ *
+ * \param[in,out] parent  XML to add an ipc_client_stats child to per client
+ */
+void
+pcmk__add_ipc_client_stats(xmlNode *parent)
+{
+    GHashTableIter iter;
+    crm_client_t *c = NULL;
+
+    if (client_connections == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, client_connections);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &c)) {
+        xmlNode *xml = create_xml_node(parent, "ipc_client_stats");
+
+        crm_xml_add(xml, XML_ATTR_ID, c->id);
+        crm_xml_add(xml, XML_NVPAIR_ATTR_NAME, crm_client_name(c));
+        crm_xml_add_int(xml, "pid", c->pid);
+        crm_xml_add_int(xml, "queued",
+                        (c->event_queue == NULL)? 0
+                        : g_queue_get_length(c->event_queue));
+        add_ull(xml, "queued-bytes", (unsigned long long) c->queue_bytes);
+        add_ull(xml, "queued-bytes-max",
+                (unsigned long long) c->queue_bytes_max);
+        add_ull(xml, "events-sent", c->events_sent);
+        add_ull(xml, "queue-total-ms", c->latency_total);
+        crm_xml_add_int(xml, "queue-max-ms", c->latency_max);
+    }
+}
+
 int
 crm_ipcs_client_pid(qb_ipcs_connection_t * c)
 {
@@ -520,6 +704,18 @@ crm_ipcs_client_pid(qb_ipcs_connection_t * c)
     return stats.client_pid;
 }
 
+ssize_t crm_ipcs_flush_events(crm_client_t * c);
+
+static gboolean
+crm_ipcs_flush_events_cb(gpointer data)
+{
+    crm_client_t *c = data;
+
+    c->event_timer = 0;
+    crm_ipcs_flush_events(c);
+    return FALSE;
+}
+
 xmlNode *
 crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t * flags)
 {
@@ -543,26 +739,47 @@ crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t
         c->flags |= crm_client_flag_ipc_proxied;
     }
 
+    if (is_set(header->flags, pcmk__ipc_accept_binary)
+        && is_not_set(c->flags, crm_client_flag_ipc_binary)) {
+        /* Client can decode binary XML, so send it that from now on */
+        crm_trace("Client %s accepts binary XML", crm_client_name(c));
+        c->flags |= crm_client_flag_ipc_binary;
+    }
+
+    if ((c->event_timer != 0) && (c->flush_delay > 0)) {
+        /* Events are waiting for room in the client's buffer, and the client
+         * is evidently processing its main loop, so retry without waiting out
+         * the back-off. Do that from the main loop rather than here, because
+         * a flush may evict the client while the caller is still using it.
+         */
+        g_source_remove(c->event_timer);
+        c->flush_delay = 0;
+        c->event_timer = g_idle_add(crm_ipcs_flush_events_cb, c);
+    }
+
     if(header->version > PCMK_IPC_VERSION) {
         crm_err("Filtering incompatible v%d IPC message, we only support versions <= %d",
                 header->version, PCMK_IPC_VERSION);
         return NULL;
     }
 
+    // Remember what we can compress replies and events to this client with
+    c->codecs = header->codecs;
+
     if (header->size_compressed) {
         int rc = 0;
         unsigned int size_u = 1 + header->size_uncompressed;
         uncompressed = calloc(1, size_u);
 
-        crm_trace("Decompressing message data %u bytes into %u bytes",
-                  header->size_compressed, size_u);
+        crm_trace("Decompressing message data %u bytes into %u bytes with %s",
+                  header->size_compressed, size_u,
+                  pcmk__codec_text(header->codec));
 
-        rc = BZ2_bzBuffToBuffDecompress(uncompressed, &size_u, text, header->size_compressed, 1, 0);
+        rc = pcmk__decompress(header->codec, text, header->size_compressed,
+                              uncompressed, &size_u);
         text = uncompressed;
 
-        if (rc != BZ_OK) {
-            crm_err("Decompression failed: %s " CRM_XS " bzerror=%d",
-                    bz2_strerror(rc), rc);
+        if (rc != pcmk_ok) {
             free(uncompressed);
             return NULL;
         }
@@ -570,39 +787,61 @@ crm_ipcs_recv(crm_client_t * c, void *data, size_t size, uint32_t * id, uint32_t
 
     CRM_ASSERT(text[header->size_uncompressed - 1] == 0);
 
-    crm_trace("Received %.200s", text);
-    xml = string2xml(text);
+    if (is_set(header->flags, pcmk__ipc_binary)) {
+        crm_trace("Received %u bytes of binary XML", header->size_uncompressed);
+        xml = pcmk__xml_binary_parse(text, header->size_uncompressed - 1);
+    } else {
+        crm_trace("Received %.200s", text);
+        xml = string2xml(text);
+    }
 
     free(uncompressed);
     return xml;
 }
 
-ssize_t crm_ipcs_flush_events(crm_client_t * c);
-
-static gboolean
-crm_ipcs_flush_events_cb(gpointer data)
+/*!
+ * \internal
+ * \brief Schedule the next event queue flush for a client
+ *
+ * \param[in,out] c        Client connection with queued events
+ * \param[in]     blocked  Whether the last flush stopped because the client's
+ *                         event buffer was full (rather than to yield)
+ */
+static void
+schedule_next_flush(crm_client_t *c, bool blocked)
 {
-    crm_client_t *c = data;
+    if (!blocked) {
+        // The client is keeping up, so continue as soon as others have run
+        c->flush_delay = 0;
 
-    c->event_timer = 0;
-    crm_ipcs_flush_events(c);
-    return FALSE;
+    } else if (c->flush_delay == 0) {
+        c->flush_delay = PCMK_IPC_FLUSH_DELAY_MIN;
+
+    } else {
+        /* Back off while the client isn't reading, so a momentarily busy client
+         * is retried quickly, but a stuck one doesn't cost us much
+         */
+        c->flush_delay = QB_MIN(2 * c->flush_delay, PCMK_IPC_FLUSH_DELAY_MAX);
+    }
+    c->event_timer = g_timeout_add(c->flush_delay, crm_ipcs_flush_events_cb, c);
 }
 
 /*!
  * \internal
- * \brief Add progressive delay before next event queue flush
+ * \brief Check whether a client's event queue is over its limits
+ *
+ * \param[in] c          Client to check
+ * \param[in] queue_len  Number of events queued for client
  *
- * \param[in,out] c          Client connection to add delay to
- * \param[in]     queue_len  Current event queue length
+ * \return true if the queue has too many events or bytes, otherwise false
  */
-static inline void
-delay_next_flush(crm_client_t *c, unsigned int queue_len)
+static bool
+client_queue_full(crm_client_t *c, unsigned int queue_len)
 {
-    /* Delay a maximum of 1.5 seconds */
-    guint delay = (queue_len < 5)? (1000 + 100 * queue_len) : 1500;
-
-    c->event_timer = g_timeout_add(delay, crm_ipcs_flush_events_cb, c);
+    crm_ipc_init();
+    return (queue_len > QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX))
+           || (c->queue_bytes > QB_MAX(PCMK_IPC_QUEUE_BYTES_MAX,
+                                       4 * (size_t) ipc_buffer_max));
 }
 
 ssize_t
@@ -611,6 +850,7 @@ crm_ipcs_flush_events(crm_client_t * c)
     ssize_t rc = 0;
     unsigned int sent = 0;
     unsigned int queue_len = 0;
+    long long now = 0;
 
     if (c == NULL) {
         return pcmk_ok;
@@ -624,9 +864,10 @@ crm_ipcs_flush_events(crm_client_t * c)
     if (c->event_queue) {
         queue_len = g_queue_get_length(c->event_queue);
     }
-    while (sent < 100) {
+    while (sent < PCMK_IPC_FLUSH_BATCH) {
         struct crm_ipc_response_header *header = NULL;
-        struct iovec *event = NULL;
+        queued_event_t *event = NULL;
+        unsigned int latency = 0;
 
         if (c->event_queue) {
             // We don't pop unless send is successful
@@ -636,30 +877,43 @@ crm_ipcs_flush_events(crm_client_t * c)
             break;
         }
 
-        rc = qb_ipcs_event_sendv(c->ipcs, event, 2);
+        rc = qb_ipcs_event_sendv(c->ipcs, event->iov, 2);
         if (rc < 0) {
             break;
         }
         event = g_queue_pop_head(c->event_queue);
 
         sent++;
-        header = event[0].iov_base;
-        if (header->size_compressed) {
-            crm_trace("Event %d to %p[%d] (%lld compressed bytes) sent",
-                      header->qb.id, c->ipcs, c->pid, (long long) rc);
-        } else {
-            crm_trace("Event %d to %p[%d] (%lld bytes) sent: %.120s",
+        if (now == 0) {
+            now = ipc_now_ms();
+        }
+        latency = (unsigned int) QB_MAX(now - event->queued, 0);
+        c->latency_total += latency;
+        c->latency_max = QB_MAX(latency, c->latency_max);
+        c->events_sent++;
+        c->queue_bytes -= event->iov[0].iov_len + event->iov[1].iov_len;
+
+        header = event->iov[0].iov_base;
+        if (header->size_compressed
+            || is_set(header->flags, pcmk__ipc_binary)) {
+            crm_trace("Event %d to %p[%d] (%lld %s bytes) sent after %ums",
                       header->qb.id, c->ipcs, c->pid, (long long) rc,
-                      (char *) (event[1].iov_base));
+                      (header->size_compressed? "compressed" : "binary"),
+                      latency);
+        } else {
+            crm_trace("Event %d to %p[%d] (%lld bytes) sent after %ums: %.120s",
+                      header->qb.id, c->ipcs, c->pid, (long long) rc, latency,
+                      (char *) (event->iov[1].iov_base));
         }
-        pcmk_free_ipc_event(event);
+        free_event(event);
     }
 
     queue_len -= sent;
     if (sent > 0 || queue_len) {
-        crm_trace("Sent %d events (%d remaining) for %p[%d]: %s (%lld)",
-                  sent, queue_len, c->ipcs, c->pid,
-                  pcmk_strerror(rc < 0 ? rc : 0), (long long) rc);
+        crm_trace("Sent %d events (%d remaining, %llu bytes) for %p[%d]: %s (%lld)",
+                  sent, queue_len, (unsigned long long) c->queue_bytes,
+                  c->ipcs, c->pid, pcmk_strerror(rc < 0 ? rc : 0),
+                  (long long) rc);
     }
 
     if (queue_len) {
@@ -668,14 +922,16 @@ crm_ipcs_flush_events(crm_client_t * c)
          * but drop completely unresponsive clients so the connection doesn't
          * consume resources indefinitely.
          */
-        if (queue_len > QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX)) {
+        if (client_queue_full(c, queue_len)) {
             if ((c->queue_backlog <= 1) || (queue_len < c->queue_backlog)) {
                 /* Don't evict for a new or shrinking backlog */
                 crm_warn("Client with process ID %u has a backlog of %u messages "
-                         CRM_XS " %p", c->pid, queue_len, c->ipcs);
+                         "(%llu bytes) " CRM_XS " %p", c->pid, queue_len,
+                         (unsigned long long) c->queue_bytes, c->ipcs);
             } else {
                 crm_err("Evicting client with process ID %u due to backlog of %u messages "
-                         CRM_XS " %p", c->pid, queue_len, c->ipcs);
+                        "(%llu bytes) " CRM_XS " %p", c->pid, queue_len,
+                        (unsigned long long) c->queue_bytes, c->ipcs);
                 c->queue_backlog = 0;
                 qb_ipcs_disconnect(c->ipcs);
                 return rc;
@@ -683,11 +939,19 @@ crm_ipcs_flush_events(crm_client_t * c)
         }
 
         c->queue_backlog = queue_len;
-        delay_next_flush(c, queue_len);
+        if (sent > 0) {
+            c->flush_delay = 0; // The client is reading again
+        }
+        schedule_next_flush(c, (rc < 0));
 
     } else {
         /* Event queue is empty, there is no backlog */
+        if (c->queue_backlog > 0) {
+            crm_trace("Client %s caught up with its events",
+                      crm_client_name(c));
+        }
         c->queue_backlog = 0;
+        c->flush_delay = 0;
     }
 
     return rc;
@@ -695,17 +959,35 @@ crm_ipcs_flush_events(crm_client_t * c)
 
 ssize_t
 crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uint32_t max_send_size)
+{
+    return pcmk__ipc_prepare_iov(request, message, max_send_size, FALSE,
+                                 pcmk__codec_bzip2, result);
+}
+
+/*!
+ * \internal
+ * \brief Create an I/O vector around an already serialized IPC message
+ *
+ * \param[in]  request        Identifier for libqb response header
+ * \param[in]  buffer         Serialized message (this takes ownership)
+ * \param[in]  header         Response header with flags and uncompressed
+ *                            size already set (this takes ownership)
+ * \param[in]  max_send_size  If 0, default IPC buffer size is used
+ * \param[in]  codec          Codec to use if compressing
+ * \param[out] result         Where to store prepared I/O vector
+ *
+ * \return Size of message on success, -errno otherwise
+ */
+static ssize_t
+prepare_iov_buffer(uint32_t request, char *buffer,
+                   struct crm_ipc_response_header *header,
+                   uint32_t max_send_size, enum pcmk__codec codec,
+                   struct iovec **result)
 {
     static unsigned int biggest = 0;
     struct iovec *iov;
     unsigned int total = 0;
     char *compressed = NULL;
-    char *buffer = dump_xml_unformatted(message);
-    struct crm_ipc_response_header *header = calloc(1, sizeof(struct crm_ipc_response_header));
-
-    CRM_ASSERT(result != NULL);
-
-    crm_ipc_init();
 
     if (max_send_size == 0) {
         max_send_size = ipc_buffer_max;
@@ -719,20 +1001,27 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
     iov[0].iov_base = header;
 
     header->version = PCMK_IPC_VERSION;
-    header->size_uncompressed = 1 + strlen(buffer);
+    header->codecs = pcmk__supported_codecs();
     total = iov[0].iov_len + header->size_uncompressed;
 
-    if (total < max_send_size) {
+    /* bzip2 is slow enough that it's only worth using when the message
+     * wouldn't fit otherwise, but faster codecs are worth using on anything
+     * that isn't small
+     */
+    if ((total < max_send_size)
+        && ((codec == pcmk__codec_bzip2)
+            || (header->size_uncompressed < PCMK_IPC_COMPRESS_THRESHOLD))) {
         iov[1].iov_base = buffer;
         iov[1].iov_len = header->size_uncompressed;
 
     } else {
         unsigned int new_size = 0;
 
-        if (crm_compress_string
-            (buffer, header->size_uncompressed, max_send_size, &compressed, &new_size)) {
+        if (pcmk__compress(codec, buffer, header->size_uncompressed,
+                           max_send_size, &compressed, &new_size)) {
 
             header->flags |= crm_ipc_compressed;
+            header->codec = codec;
             header->size_compressed = new_size;
 
             iov[1].iov_len = header->size_compressed;
@@ -742,10 +1031,14 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
 
             biggest = QB_MAX(header->size_compressed, biggest);
 
+        } else if (total < max_send_size) {
+            // Not worth compressing after all, but it fits anyway
+            iov[1].iov_base = buffer;
+            iov[1].iov_len = header->size_uncompressed;
+
         } else {
             ssize_t rc = -EMSGSIZE;
 
-            crm_log_xml_trace(message, "EMSGSIZE");
             biggest = QB_MAX(header->size_uncompressed, biggest);
 
             crm_err
@@ -754,6 +1047,7 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
                  header->size_uncompressed, max_send_size, 4 * biggest);
 
             free(compressed);
+            free(buffer);
             pcmk_free_ipc_event(iov);
             return rc;
         }
@@ -767,11 +1061,106 @@ crm_ipc_prepare(uint32_t request, xmlNode * message, struct iovec ** result, uin
     return header->qb.size;
 }
 
+/*!
+ * \internal
+ * \brief Create an I/O vector for sending an IPC XML message
+ *
+ * \param[in]  request        Identifier for libqb response header
+ * \param[in]  message        XML message to send
+ * \param[in]  max_send_size  If 0, default IPC buffer size is used
+ * \param[in]  binary         Whether to use binary XML encoding (which the
+ *                            recipient must have said it accepts)
+ * \param[in]  codec          Codec to use if compressing (which the recipient
+ *                            must have said it accepts)
+ * \param[out] result         Where to store prepared I/O vector
+ *
+ * \return Size of message on success, -errno otherwise
+ * \note The caller is responsible for freeing the result with
+ *       pcmk_free_ipc_event().
+ */
+ssize_t
+pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
+                      uint32_t max_send_size, bool binary,
+                      enum pcmk__codec codec, struct iovec **result)
+{
+    ssize_t rc = 0;
+    unsigned int total = 0;
+    char *buffer = NULL;
+    struct crm_ipc_response_header *header = calloc(1, sizeof(struct crm_ipc_response_header));
+
+    CRM_ASSERT(result != NULL);
+
+    crm_ipc_init();
+
+    if (binary) {
+        buffer = pcmk__xml_binary_dump(message, &total);
+        if (buffer == NULL) {
+            free(header);
+            *result = NULL;
+            return -EINVAL;
+        }
+        /* The encoding is nul-terminated (for the benefit of the checks done
+         * on text messages), but the terminator is not counted in its length
+         */
+        header->flags |= pcmk__ipc_binary;
+        header->size_uncompressed = 1 + total;
+    } else {
+        buffer = dump_xml_unformatted(message);
+        header->size_uncompressed = 1 + strlen(buffer);
+    }
+
+    rc = prepare_iov_buffer(request, buffer, header, max_send_size, codec,
+                            result);
+    if (rc == -EMSGSIZE) {
+        crm_log_xml_trace(message, "EMSGSIZE");
+    }
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Create an I/O vector for sending an already serialized XML message
+ *
+ * This allows a caller to build a large message from pieces it has cached,
+ * rather than serializing the same content for every recipient.
+ *
+ * \param[in]  request        Identifier for libqb response header
+ * \param[in]  text           XML message text (this takes ownership)
+ * \param[in]  max_send_size  If 0, default IPC buffer size is used
+ * \param[in]  codec          Codec to use if compressing (which the recipient
+ *                            must have said it accepts)
+ * \param[out] result         Where to store prepared I/O vector
+ *
+ * \return Size of message on success, -errno otherwise
+ * \note The caller is responsible for freeing the result with
+ *       pcmk_free_ipc_event().
+ */
+ssize_t
+pcmk__ipc_prepare_text_iov(uint32_t request, char *text,
+                           uint32_t max_send_size, enum pcmk__codec codec,
+                           struct iovec **result)
+{
+    struct crm_ipc_response_header *header = NULL;
+
+    CRM_ASSERT(result != NULL);
+    *result = NULL;
+    CRM_CHECK(text != NULL, return -EINVAL);
+
+    crm_ipc_init();
+
+    header = calloc(1, sizeof(struct crm_ipc_response_header));
+    header->size_uncompressed = 1 + strlen(text);
+    return prepare_iov_buffer(request, text, header, max_send_size, codec,
+                              result);
+}
+
+// We don't really use event IDs, but it doesn't hurt to set one
+static uint32_t next_event_id = 1;
+
 ssize_t
 crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
 {
     ssize_t rc;
-    static uint32_t id = 1;
     struct crm_ipc_response_header *header = iov[0].iov_base;
 
     if (c->flags & crm_client_flag_ipc_proxied) {
@@ -784,9 +1173,9 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
         }
     }
 
-    header->flags |= flags;
+    header->flags |= (flags & ~pcmk__ipc_binary);
     if (flags & crm_ipc_server_event) {
-        header->qb.id = id++;   /* We don't really use it, but doesn't hurt to set one */
+        header->qb.id = next_event_id++;
 
         if (flags & crm_ipc_server_free) {
             crm_trace("Sending the original to %p[%d]", c->ipcs, c->pid);
@@ -840,6 +1229,41 @@ crm_ipcs_sendv(crm_client_t * c, struct iovec * iov, enum crm_ipc_flags flags)
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Queue a shared event for a client, without copying its payload
+ *
+ * \param[in] c       Client to send event to
+ * \param[in] shared  Shared event to send (the client's queue takes its own
+ *                    reference, so the caller keeps its reference)
+ * \param[in] flags   Group of enum crm_ipc_flags (crm_ipc_server_event is
+ *                    implied, and crm_ipc_server_free is ignored)
+ *
+ * \return As for crm_ipcs_flush_events()
+ */
+ssize_t
+pcmk__ipcs_send_shared(crm_client_t *c, pcmk__ipc_shared_t *shared,
+                       enum crm_ipc_flags flags)
+{
+    ssize_t rc = pcmk_ok;
+    struct crm_ipc_response_header *header = NULL;
+
+    CRM_CHECK((c != NULL) && (shared != NULL), return -EINVAL);
+
+    flags &= ~(pcmk__ipc_binary|crm_ipc_server_free);
+    header = add_shared_event(c, shared);
+    header->flags |= flags|crm_ipc_server_event;
+    header->qb.id = next_event_id++;
+    crm_trace("Sending shared event %d to %p[%d]",
+              header->qb.id, c->ipcs, c->pid);
+
+    rc = crm_ipcs_flush_events(c);
+    if (rc == -EPIPE || rc == -ENOTCONN) {
+        crm_trace("Client %p disconnected", c->ipcs);
+    }
+    return rc;
+}
+
 ssize_t
 crm_ipcs_send(crm_client_t * c, uint32_t request, xmlNode * message,
               enum crm_ipc_flags flags)
@@ -852,7 +1276,9 @@ crm_ipcs_send(crm_client_t * c, uint32_t request, xmlNode * message,
     }
     crm_ipc_init();
 
-    rc = crm_ipc_prepare(request, message, &iov, ipc_buffer_max);
+    rc = pcmk__ipc_prepare_iov(request, message, ipc_buffer_max,
+                               is_set(c->flags, crm_client_flag_ipc_binary),
+                               pcmk__best_codec(c->codecs), &iov);
     if (rc > 0) {
         rc = crm_ipcs_sendv(c, iov, flags | crm_ipc_server_free);
     } else {
@@ -898,6 +1324,9 @@ struct crm_ipc_s {
 
     qb_ipcc_connection_t *ipc;
 
+    bool accept_binary; /* We can decode binary XML from the server */
+    bool peer_binary;   /* Server has shown it can decode binary XML */
+    uint8_t peer_codecs; /* Compression codecs the server can decompress */
 };
 
 static unsigned int
@@ -1124,6 +1553,8 @@ crm_ipc_decompress(crm_ipc_t * client)
 {
     struct crm_ipc_response_header *header = (struct crm_ipc_response_header *)(void*)client->buffer;
 
+    client->peer_codecs = header->codecs;
+
     if (header->size_compressed) {
         int rc = 0;
         unsigned int size_u = 1 + header->size_uncompressed;
@@ -1131,17 +1562,17 @@ crm_ipc_decompress(crm_ipc_t * client)
         unsigned int new_buf_size = QB_MAX((hdr_offset + size_u), client->max_buf_size);
         char *uncompressed = calloc(1, new_buf_size);
 
-        crm_trace("Decompressing message data %u bytes into %u bytes",
-                 header->size_compressed, size_u);
+        crm_trace("Decompressing message data %u bytes into %u bytes with %s",
+                 header->size_compressed, size_u,
+                 pcmk__codec_text(header->codec));
 
-        rc = BZ2_bzBuffToBuffDecompress(uncompressed + hdr_offset, &size_u,
-                                        client->buffer + hdr_offset, header->size_compressed, 1, 0);
+        rc = pcmk__decompress(header->codec, client->buffer + hdr_offset,
+                              header->size_compressed,
+                              uncompressed + hdr_offset, &size_u);
 
-        if (rc != BZ_OK) {
-            crm_err("Decompression failed: %s " CRM_XS " bzerror=%d",
-                    bz2_strerror(rc), rc);
+        if (rc != pcmk_ok) {
             free(uncompressed);
-            return -EILSEQ;
+            return rc;
         }
 
         /*
@@ -1193,6 +1624,9 @@ crm_ipc_read(crm_ipc_t * client)
                     header->version, PCMK_IPC_VERSION);
             return -EBADMSG;
         }
+        if (is_set(header->flags, pcmk__ipc_binary)) {
+            client->peer_binary = TRUE;
+        }
 
         crm_trace("Received %s event %d, size=%u, rc=%d, text: %.100s",
                   client->name, header->qb.id, header->qb.size, client->msg_size,
@@ -1241,6 +1675,62 @@ crm_ipc_name(crm_ipc_t * client)
     return client->name;
 }
 
+/*!
+ * \internal
+ * \brief Set whether an IPC client can handle binary XML from the server
+ *
+ * Servers will send binary-encoded XML only to clients that advertise (via a
+ * flag on each request, starting with their registration or hello) that they
+ * accept it, and clients will send binary requests only once the server has
+ * sent them a binary message, so a connection uses XML text unless both sides
+ * support the binary encoding.
+ *
+ * \param[in,out] client  Connection to modify
+ * \param[in]     accept  Whether to accept binary XML
+ *
+ * \note Only set this if every reader of the connection's messages parses
+ *       them with pcmk__ipc_buffer_xml() rather than crm_ipc_buffer().
+ */
+void
+pcmk__ipc_set_binary(crm_ipc_t *client, bool accept)
+{
+    CRM_ASSERT(client != NULL);
+    client->accept_binary = accept;
+    if (!accept) {
+        client->peer_binary = FALSE;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Parse the most recently received IPC message as XML
+ *
+ * \param[in] client  Connection to parse message from
+ *
+ * \return Newly allocated XML, or NULL on error
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+pcmk__ipc_buffer_xml(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = NULL;
+
+    CRM_ASSERT(client != NULL);
+    if (client->buffer == NULL) {
+        return NULL;
+    }
+
+    header = (struct crm_ipc_response_header *)(void*)client->buffer;
+    if (is_set(header->flags, pcmk__ipc_binary)) {
+        if (header->size_uncompressed < 1) {
+            return NULL;
+        }
+        return pcmk__xml_binary_parse(crm_ipc_buffer(client),
+                                      header->size_uncompressed - 1);
+    }
+    return string2xml(crm_ipc_buffer(client));
+}
+
 static int
 internal_ipc_send_recv(crm_ipc_t * client, const void *iov)
 {
@@ -1293,13 +1783,13 @@ internal_ipc_get_reply(crm_ipc_t * client, int request_id, int ms_timeout)
                 /* Got it */
                 break;
             } else if (hdr->qb.id < request_id) {
-                xmlNode *bad = string2xml(crm_ipc_buffer(client));
+                xmlNode *bad = pcmk__ipc_buffer_xml(client);
 
                 crm_err("Discarding old reply %d (need %d)", hdr->qb.id, request_id);
                 crm_log_xml_notice(bad, "OldIpcReply");
 
             } else {
-                xmlNode *bad = string2xml(crm_ipc_buffer(client));
+                xmlNode *bad = pcmk__ipc_buffer_xml(client);
 
                 crm_err("Discarding newer reply %d (need %d)", hdr->qb.id, request_id);
                 crm_log_xml_notice(bad, "ImpossibleReply");
@@ -1359,13 +1849,19 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
 
     id++;
     CRM_LOG_ASSERT(id != 0); /* Crude wrap-around detection */
-    rc = crm_ipc_prepare(id, message, &iov, client->max_buf_size);
+    rc = pcmk__ipc_prepare_iov(id, message, client->max_buf_size,
+                               client->peer_binary,
+                               pcmk__best_codec(client->peer_codecs), &iov);
     if(rc < 0) {
         return rc;
     }
 
     header = iov[0].iov_base;
-    header->flags |= flags;
+    /* The encoding was chosen above, whatever the (possibly relayed) flags say */
+    header->flags |= (flags & ~pcmk__ipc_binary);
+    if (client->accept_binary) {
+        header->flags |= pcmk__ipc_accept_binary;
+    }
 
     if(is_set(flags, crm_ipc_proxied)) {
         /* Don't look for a synchronous response */
@@ -1414,16 +1910,29 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
 
     } else {
         rc = internal_ipc_send_recv(client, iov);
+        if (rc > 0) {
+            int decompress_rc = crm_ipc_decompress(client);
+
+            if (decompress_rc != pcmk_ok) {
+                rc = decompress_rc;
+            }
+        }
     }
 
     if (rc > 0) {
         struct crm_ipc_response_header *hdr = (struct crm_ipc_response_header *)(void*)client->buffer;
 
-        crm_trace("Received response %d, size=%u, rc=%ld, text: %.200s", hdr->qb.id, hdr->qb.size,
-                  rc, crm_ipc_buffer(client));
+        if (is_set(hdr->flags, pcmk__ipc_binary)) {
+            client->peer_binary = TRUE;
+            crm_trace("Received binary response %d, size=%u, rc=%ld",
+                      hdr->qb.id, hdr->qb.size, rc);
+        } else {
+            crm_trace("Received response %d, size=%u, rc=%ld, text: %.200s",
+                      hdr->qb.id, hdr->qb.size, rc, crm_ipc_buffer(client));
+        }
 
         if (reply) {
-            *reply = string2xml(crm_ipc_buffer(client));
+            *reply = pcmk__ipc_buffer_xml(client);
         }
 
     } else {
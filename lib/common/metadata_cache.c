@@ -0,0 +1,619 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <crm/crm.h>
+#include <crm/services.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+/*
+ * Agent meta-data cache
+ *
+ * Getting an agent's meta-data means forking the agent, and the daemons that
+ * need it (the controller to build digests, the fencer to learn device
+ * capabilities, and the executor when asked to run meta-data actions) would
+ * otherwise do so again for every agent after every restart.
+ *
+ * Instead, meta-data for agents that are files on disk (OCF, LSB, and Red Hat
+ * fence agents) is kept in CRM_METADATA_DIR, one file per agent, along with the
+ * agent's path, modification time, size, and an MD5 digest of its contents. An
+ * entry is used only while the agent file still has the recorded time and
+ * size, or (if only the time changed, as after a package reinstall) the
+ * recorded digest. Entries also record the Pacemaker version that made them
+ * and the time and size of the library the agent's meta-data largely comes
+ * from (ocf-shellfuncs for OCF agents, and the fencing library for fence
+ * agents), and are not used if either differs. Entries for agents that have
+ * changed are "stale" until replaced.
+ *
+ * All daemons share the directory, but only root may write to it, since root
+ * daemons act on what they read there. Entries written by any other user are
+ * ignored. The executor fills the cache for the agents it runs, and the fencer
+ * for fence agents, while the controller (which does not run as root) only
+ * reads it. Entries are replaced atomically, so readers never see a partial
+ * one. Removing the files in the directory clears the cache.
+ */
+
+#define MD_CACHE_SUFFIX     ".xml"
+#define XML_TAG_MD_CACHE    "agent-metadata"
+#define XML_MD_ATTR_PATH    "path"
+#define XML_MD_ATTR_MTIME   "mtime"
+#define XML_MD_ATTR_SIZE    "size"
+#define XML_MD_ATTR_VERSION "pacemaker-version"
+#define XML_MD_ATTR_LIBRARY "library"
+
+#define MD_CACHE_VERSION    PACEMAKER_VERSION "-" BUILD_VERSION
+#define OCF_SHELLFUNCS      OCF_ROOT_DIR "/lib/heartbeat/ocf-shellfuncs"
+
+/* Red Hat fence agents add this directory to the Python path to find the
+ * fencing library they share
+ */
+#define RH_STONITH_LIBRARY  RH_STONITH_LIB_DIR "/fencing.py"
+
+typedef struct md_entry_s {
+    char *standard;
+    char *provider;
+    char *type;
+    char *path;         // agent executable
+    long long mtime;    // agent's modification time when entry was made
+    long long size;     // agent's size when entry was made
+    char *digest;       // digest of agent's contents when entry was made
+    char *version;      // Pacemaker version that made entry
+    char *library;      // time and size of agent's library when entry was made
+    char *metadata;     // agent's meta-data, or NULL if entry is stale
+} md_entry_t;
+
+// Key (as from crm_generate_ra_key()) -> md_entry_t
+static GHashTable *md_entries = NULL;
+
+static void
+md_entry_free(gpointer data)
+{
+    md_entry_t *entry = data;
+
+    if (entry != NULL) {
+        free(entry->standard);
+        free(entry->provider);
+        free(entry->type);
+        free(entry->path);
+        free(entry->digest);
+        free(entry->version);
+        free(entry->library);
+        free(entry->metadata);
+        free(entry);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get the path of the file implementing an agent
+ *
+ * \param[in] standard  Agent's standard
+ * \param[in] provider  Agent's provider (if standard uses one)
+ * \param[in] type      Agent's name
+ *
+ * \return Newly allocated path of agent, or NULL if the agent's meta-data is
+ *         not cacheable
+ */
+static char *
+agent_path(const char *standard, const char *provider, const char *type)
+{
+    if ((standard == NULL) || (type == NULL)) {
+        return NULL;
+
+    } else if (!strcasecmp(standard, PCMK_RESOURCE_CLASS_OCF)) {
+        if ((provider == NULL) || strchr(provider, '/') || strchr(type, '/')) {
+            return NULL;
+        }
+        return crm_strdup_printf(OCF_RA_DIR "/%s/%s", provider, type);
+
+    } else if (!strcasecmp(standard, PCMK_RESOURCE_CLASS_LSB)) {
+        if (type[0] == '/') {
+            return strdup(type);
+        } else if (strchr(type, '/')) {
+            return NULL;
+        }
+        return crm_strdup_printf(LSB_ROOT_DIR "/%s", type);
+
+    } else if (!strcasecmp(standard, PCMK_RESOURCE_CLASS_STONITH)) {
+        if (strchr(type, '/') || !crm_starts_with(type, RH_STONITH_PREFIX)) {
+            return NULL;
+        }
+        return crm_strdup_printf(RH_STONITH_DIR "/%s", type);
+    }
+
+    // Other standards generate meta-data without forking anything
+    return NULL;
+}
+
+/*!
+ * \internal
+ * \brief Describe the shared library an agent's meta-data may depend on
+ *
+ * \param[in] standard  Agent's standard
+ *
+ * \return Newly allocated string with library's modification time and size, or
+ *         NULL if agents of \p standard have no such library or it is missing
+ */
+static char *
+library_stamp(const char *standard)
+{
+    struct stat sb;
+    const char *library = NULL;
+
+    if (!strcasecmp(standard, PCMK_RESOURCE_CLASS_OCF)) {
+        library = OCF_SHELLFUNCS;
+    } else if (!strcasecmp(standard, PCMK_RESOURCE_CLASS_STONITH)) {
+        library = RH_STONITH_LIBRARY;
+    }
+    if ((library == NULL) || (stat(library, &sb) < 0)) {
+        return NULL;
+    }
+    return crm_strdup_printf("%lld:%lld", (long long) sb.st_mtime,
+                             (long long) sb.st_size);
+}
+
+static char *
+entry_filename(const char *key)
+{
+    char *filename = crm_strdup_printf(CRM_METADATA_DIR "/%s" MD_CACHE_SUFFIX,
+                                       key);
+
+    // LSB agents may be given as absolute paths
+    for (char *c = filename + strlen(CRM_METADATA_DIR) + 1; *c != '\0'; c++) {
+        if (*c == '/') {
+            *c = '_';
+        }
+    }
+    return filename;
+}
+
+static char *
+agent_digest(const char *path)
+{
+    char *contents = crm_read_contents(path);
+    char *digest = NULL;
+
+    if (contents != NULL) {
+        digest = crm_md5sum(contents);
+        free(contents);
+    }
+    return digest;
+}
+
+static void
+write_entry(const char *key, md_entry_t *entry)
+{
+    xmlNode *xml = NULL;
+    xmlNode *metadata = NULL;
+    char *filename = NULL;
+    char *tmp = NULL;
+    char *value = NULL;
+    int fd = -1;
+
+    // Root daemons trust the cache, so only they may write to it
+    if (geteuid() != 0) {
+        return;
+    }
+
+    metadata = string2xml(entry->metadata);
+    if (metadata == NULL) {
+        return;
+    }
+
+    xml = create_xml_node(NULL, XML_TAG_MD_CACHE);
+    crm_xml_add(xml, XML_AGENT_ATTR_CLASS, entry->standard);
+    crm_xml_add(xml, XML_AGENT_ATTR_PROVIDER, entry->provider);
+    crm_xml_add(xml, XML_ATTR_TYPE, entry->type);
+    crm_xml_add(xml, XML_MD_ATTR_PATH, entry->path);
+    value = crm_strdup_printf("%lld", entry->mtime);
+    crm_xml_add(xml, XML_MD_ATTR_MTIME, value);
+    free(value);
+    value = crm_strdup_printf("%lld", entry->size);
+    crm_xml_add(xml, XML_MD_ATTR_SIZE, value);
+    free(value);
+    crm_xml_add(xml, XML_ATTR_DIGEST, entry->digest);
+    crm_xml_add(xml, XML_MD_ATTR_VERSION, entry->version);
+    crm_xml_add(xml, XML_MD_ATTR_LIBRARY, entry->library);
+    add_node_nocopy(xml, NULL, metadata);
+
+    filename = entry_filename(key);
+    tmp = crm_strdup_printf("%s.XXXXXX", filename);
+
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        // Most likely, the cache directory doesn't exist or isn't ours
+        crm_debug("Not caching meta-data for %s: %s", key, pcmk_strerror(errno));
+        goto done;
+    }
+
+    /* Root daemons share the cache with the unprivileged controller, so
+     * entries must be readable (but not writable) by the cluster daemon group
+     */
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP) < 0) {
+        crm_perror(LOG_WARNING, "Could not set permissions on %s", tmp);
+    } else {
+        uid_t uid = 0;
+        gid_t gid = 0;
+
+        if ((crm_user_lookup(CRM_DAEMON_USER, &uid, &gid) < 0)
+            || (fchown(fd, 0, gid) < 0)) {
+            crm_perror(LOG_WARNING, "Could not set ownership of %s", tmp);
+        }
+    }
+
+    if (write_xml_fd(xml, tmp, fd, FALSE) <= 0) {
+        crm_warn("Could not write meta-data cache entry for %s", key);
+        unlink(tmp);
+
+    } else if (rename(tmp, filename) < 0) {
+        crm_perror(LOG_WARNING, "Could not rename %s to %s", tmp, filename);
+        unlink(tmp);
+
+    } else {
+        crm_trace("Cached meta-data for %s in %s", key, filename);
+    }
+
+done:
+    free(tmp);
+    free(filename);
+    free_xml(xml);
+}
+
+/*!
+ * \internal
+ * \brief Check whether an entry's agent is unchanged since the entry was made
+ *
+ * \param[in]     key    Entry's key
+ * \param[in,out] entry  Entry to check (its time will be updated if the agent
+ *                       has been touched without changing its contents)
+ *
+ * \return TRUE if the entry is usable, FALSE otherwise
+ */
+static gboolean
+entry_is_current(const char *key, md_entry_t *entry)
+{
+    struct stat sb;
+    char *digest = NULL;
+    char *library = NULL;
+
+    if (safe_str_neq(entry->version, MD_CACHE_VERSION)) {
+        return FALSE;
+    }
+
+    library = library_stamp(entry->standard);
+    if (safe_str_neq(library, entry->library)) {
+        free(library);
+        return FALSE;
+    }
+    free(library);
+
+    if (stat(entry->path, &sb) < 0) {
+        return FALSE;
+
+    } else if ((long long) sb.st_size != entry->size) {
+        return FALSE;
+
+    } else if ((long long) sb.st_mtime == entry->mtime) {
+        return TRUE;
+    }
+
+    digest = agent_digest(entry->path);
+    if (safe_str_neq(digest, entry->digest)) {
+        free(digest);
+        return FALSE;
+    }
+    free(digest);
+
+    crm_trace("%s was touched but is unchanged", entry->path);
+    entry->mtime = (long long) sb.st_mtime;
+    write_entry(key, entry);
+    return TRUE;
+}
+
+static md_entry_t *
+read_entry(const char *filename)
+{
+    xmlNode *xml = NULL;
+    xmlNode *metadata = NULL;
+    md_entry_t *entry = NULL;
+    struct stat sb;
+
+    if (lstat(filename, &sb) < 0) {
+        return NULL;
+    }
+
+    // Only entries written by root (see write_entry()) can be trusted
+    if (!S_ISREG(sb.st_mode) || (sb.st_uid != 0)
+        || (sb.st_mode & (S_IWGRP | S_IWOTH))) {
+        crm_info("Ignoring meta-data cache entry %s not written by root",
+                 filename);
+        return NULL;
+    }
+
+    xml = filename2xml(filename);
+    if (xml == NULL) {
+        return NULL;
+    }
+
+    metadata = __xml_first_child_element(xml);
+    if (safe_str_neq(crm_element_name(xml), XML_TAG_MD_CACHE)
+        || (metadata == NULL)
+        || (crm_element_value(xml, XML_AGENT_ATTR_CLASS) == NULL)
+        || (crm_element_value(xml, XML_ATTR_TYPE) == NULL)
+        || (crm_element_value(xml, XML_MD_ATTR_PATH) == NULL)
+        || (crm_element_value(xml, XML_ATTR_DIGEST) == NULL)) {
+        crm_warn("Ignoring invalid meta-data cache entry %s", filename);
+        free_xml(xml);
+        return NULL;
+    }
+
+    entry = calloc(1, sizeof(md_entry_t));
+    CRM_ASSERT(entry != NULL);
+    entry->standard = strdup(crm_element_value(xml, XML_AGENT_ATTR_CLASS));
+    entry->provider = crm_element_value_copy(xml, XML_AGENT_ATTR_PROVIDER);
+    entry->type = strdup(crm_element_value(xml, XML_ATTR_TYPE));
+    entry->path = strdup(crm_element_value(xml, XML_MD_ATTR_PATH));
+    entry->mtime = crm_parse_ll(crm_element_value(xml, XML_MD_ATTR_MTIME),
+                                "-1");
+    entry->size = crm_parse_ll(crm_element_value(xml, XML_MD_ATTR_SIZE), "-1");
+    entry->digest = strdup(crm_element_value(xml, XML_ATTR_DIGEST));
+    entry->version = crm_element_value_copy(xml, XML_MD_ATTR_VERSION);
+    entry->library = crm_element_value_copy(xml, XML_MD_ATTR_LIBRARY);
+    entry->metadata = dump_xml_formatted(metadata);
+
+    free_xml(xml);
+    return entry;
+}
+
+static void
+cache_entry(char *key, md_entry_t *entry)
+{
+    if (md_entries == NULL) {
+        md_entries = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                           md_entry_free);
+    }
+    g_hash_table_replace(md_entries, key, entry);
+}
+
+/*!
+ * \internal
+ * \brief Load all agent meta-data cache entries from disk
+ *
+ * Entries whose agents no longer exist are removed, and entries whose agents
+ * have changed are kept as stale (until replaced by pcmk__metadata_cache_put()).
+ */
+void
+pcmk__metadata_cache_load(void)
+{
+    struct dirent **namelist = NULL;
+    int n_files = scandir(CRM_METADATA_DIR, &namelist, NULL, alphasort);
+    int loaded = 0;
+    int stale = 0;
+
+    if (n_files < 0) {
+        crm_debug("Could not read agent meta-data cache %s: %s",
+                  CRM_METADATA_DIR, pcmk_strerror(errno));
+        return;
+    }
+
+    for (int lpc = 0; lpc < n_files; lpc++) {
+        const char *name = namelist[lpc]->d_name;
+        char *filename = NULL;
+        md_entry_t *entry = NULL;
+        char *key = NULL;
+        char *path = NULL;
+
+        if (!crm_ends_with_ext(name, MD_CACHE_SUFFIX)) {
+            free(namelist[lpc]);
+            continue;
+        }
+
+        filename = crm_strdup_printf(CRM_METADATA_DIR "/%s", name);
+        entry = read_entry(filename);
+        if (entry == NULL) {
+            goto next;
+        }
+
+        key = crm_generate_ra_key(entry->standard, entry->provider,
+                                  entry->type);
+        path = agent_path(entry->standard, entry->provider, entry->type);
+        if ((path == NULL) || (access(entry->path, F_OK) < 0)) {
+            crm_debug("Removing meta-data cache entry for %s: %s no longer "
+                      "exists or is not cacheable", key, entry->path);
+            if (geteuid() == 0) {
+                unlink(filename);
+            }
+            md_entry_free(entry);
+            free(path);
+            free(key);
+            goto next;
+        }
+        free(path);
+
+        if (!entry_is_current(key, entry)) {
+            free(entry->metadata);
+            entry->metadata = NULL;
+            stale++;
+        }
+        cache_entry(key, entry);
+        loaded++;
+
+next:
+        free(filename);
+        free(namelist[lpc]);
+    }
+    free(namelist);
+
+    crm_info("Loaded %d agent meta-data cache entries (%d stale)",
+             loaded, stale);
+}
+
+/*!
+ * \internal
+ * \brief Check whether an agent's meta-data can be cached
+ *
+ * \param[in] standard  Agent's standard
+ * \param[in] provider  Agent's provider (if standard uses one)
+ * \param[in] type      Agent's name
+ *
+ * \return TRUE if the agent is a file on disk whose meta-data can be cached,
+ *         FALSE otherwise
+ */
+gboolean
+pcmk__metadata_cacheable(const char *standard, const char *provider,
+                         const char *type)
+{
+    char *path = agent_path(standard, provider, type);
+    gboolean cacheable = (path != NULL);
+
+    free(path);
+    return cacheable;
+}
+
+/*!
+ * \internal
+ * \brief Get an agent's meta-data from the cache
+ *
+ * \param[in] standard  Agent's standard
+ * \param[in] provider  Agent's provider (if standard uses one)
+ * \param[in] type      Agent's name
+ *
+ * \return Newly allocated copy of agent's meta-data, or NULL if it is not
+ *         cached or the cached copy is stale
+ */
+char *
+pcmk__metadata_cache_get(const char *standard, const char *provider,
+                         const char *type)
+{
+    char *key = NULL;
+    char *path = agent_path(standard, provider, type);
+    md_entry_t *entry = NULL;
+    char *metadata = NULL;
+
+    if (path == NULL) {
+        return NULL;
+    }
+
+    key = crm_generate_ra_key(standard, provider, type);
+    if (md_entries != NULL) {
+        entry = g_hash_table_lookup(md_entries, key);
+    }
+
+    // Another daemon may have cached or refreshed it since we last looked
+    if ((entry == NULL) || (entry->metadata == NULL)) {
+        char *filename = entry_filename(key);
+
+        entry = read_entry(filename);
+        free(filename);
+        if (entry == NULL) {
+            goto done;
+        }
+        cache_entry(strdup(key), entry);
+    }
+
+    if (safe_str_neq(entry->path, path) || !entry_is_current(key, entry)) {
+        crm_debug("Cached meta-data for %s is stale", key);
+        free(entry->metadata);
+        entry->metadata = NULL;
+        goto done;
+    }
+
+    metadata = strdup(entry->metadata);
+    crm_trace("Using cached meta-data for %s", key);
+
+done:
+    free(key);
+    free(path);
+    return metadata;
+}
+
+/*!
+ * \internal
+ * \brief Add an agent's meta-data to the cache
+ *
+ * \param[in] standard  Agent's standard
+ * \param[in] provider  Agent's provider (if standard uses one)
+ * \param[in] type      Agent's name
+ * \param[in] metadata  Agent's meta-data, as just obtained from the agent
+ *
+ * \note Meta-data that is not valid XML, or for agents that are not files on
+ *       disk, is not cached. Unless called as root, meta-data is cached in
+ *       memory only (see write_entry()).
+ */
+void
+pcmk__metadata_cache_put(const char *standard, const char *provider,
+                         const char *type, const char *metadata)
+{
+    char *path = agent_path(standard, provider, type);
+    char *key = NULL;
+    md_entry_t *entry = NULL;
+    xmlNode *xml = NULL;
+    struct stat sb;
+
+    if ((path == NULL) || (metadata == NULL)) {
+        free(path);
+        return;
+    }
+
+    xml = string2xml(metadata);
+    if ((xml == NULL) || (stat(path, &sb) < 0)) {
+        free_xml(xml);
+        free(path);
+        return;
+    }
+    free_xml(xml);
+
+    entry = calloc(1, sizeof(md_entry_t));
+    CRM_ASSERT(entry != NULL);
+    entry->standard = strdup(standard);
+    entry->provider = (provider? strdup(provider) : NULL);
+    entry->type = strdup(type);
+    entry->path = path;
+    entry->mtime = (long long) sb.st_mtime;
+    entry->size = (long long) sb.st_size;
+    entry->digest = agent_digest(path);
+    entry->version = strdup(MD_CACHE_VERSION);
+    entry->library = library_stamp(standard);
+    entry->metadata = strdup(metadata);
+
+    if (entry->digest == NULL) {
+        md_entry_free(entry);
+        return;
+    }
+
+    key = crm_generate_ra_key(standard, provider, type);
+    write_entry(key, entry);
+    cache_entry(key, entry);
+}
+
+/*!
+ * \internal
+ * \brief Free the in-memory copy of the agent meta-data cache
+ */
+void
+pcmk__metadata_cache_cleanup(void)
+{
+    if (md_entries != NULL) {
+        g_hash_table_destroy(md_entries);
+        md_entries = NULL;
+    }
+}
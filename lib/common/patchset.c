@@ -0,0 +1,311 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+
+/*
+ * Patchset change iteration
+ *
+ * Each change in a v2 patchset identifies what it changed by an XPath of the
+ * form /cib/status/node_state[@id='1']/lrm[@id='1']/... (for creates, the path
+ * of the new element's parent). Rather than have every consumer search the
+ * path for the parts it needs, the path of each change is parsed once into a
+ * list of steps (element name and ID), and the IDs most often needed are
+ * picked out of the path (or out of the change's result, for elements created
+ * or modified as a whole).
+ */
+
+/*!
+ * \internal
+ * \brief Parse a patchset change's path into steps
+ *
+ * \param[in]  path     Path to parse (modified in place)
+ * \param[out] n_steps  Where to store number of steps
+ *
+ * \return Newly allocated array of steps, pointing into \p path
+ */
+static pcmk__path_step_t *
+parse_path(char *path, int *n_steps)
+{
+    int max = 1;
+    pcmk__path_step_t *steps = NULL;
+    char *p = NULL;
+
+    for (p = path; *p != '\0'; p++) {
+        if (*p == '/') {
+            max++;
+        }
+    }
+    steps = calloc(max, sizeof(pcmk__path_step_t));
+    CRM_ASSERT(steps != NULL);
+
+    *n_steps = 0;
+    p = path;
+    while (*p != '\0') {
+        pcmk__path_step_t *step = &steps[*n_steps];
+
+        if (*p == '/') {
+            p++;
+            continue;
+        }
+
+        step->name = p;
+        p += strcspn(p, "[/");
+
+        if (*p == '[') {
+            *p++ = '\0';
+            if (crm_starts_with(p, "@" XML_ATTR_ID "='")) {
+                p += strlen("@" XML_ATTR_ID "='");
+                step->id = p;
+                p = strchr(p, '\'');
+                if (p == NULL) {
+                    // Malformed, so keep what we have
+                    (*n_steps)++;
+                    break;
+                }
+                *p++ = '\0';
+            }
+            p = strchr(p, ']');
+            if (p == NULL) {
+                (*n_steps)++;
+                break;
+            }
+            p++;
+
+        } else if (*p == '/') {
+            *p++ = '\0';
+        }
+        (*n_steps)++;
+    }
+    return steps;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a patchset change's path includes an element
+ *
+ * \param[in] change  Parsed patchset change
+ * \param[in] name    Name of element to check for
+ *
+ * \return TRUE if an element named \p name is in \p change's path
+ */
+bool
+pcmk__patch_path_has(const pcmk__patch_change_t *change, const char *name)
+{
+    for (int lpc = 0; lpc < change->n_steps; lpc++) {
+        if (safe_str_eq(change->steps[lpc].name, name)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Get the ID of an element in a patchset change's path
+ *
+ * \param[in] change  Parsed patchset change
+ * \param[in] name    Name of element to get ID of
+ *
+ * \return ID of first element named \p name in \p change's path, or NULL if
+ *         there is no such element (or it has no ID)
+ */
+const char *
+pcmk__patch_path_id(const pcmk__patch_change_t *change, const char *name)
+{
+    for (int lpc = 0; lpc < change->n_steps; lpc++) {
+        if (safe_str_eq(change->steps[lpc].name, name)) {
+            return change->steps[lpc].id;
+        }
+    }
+    return NULL;
+}
+
+static enum pcmk__cib_section
+section_of(const char *name)
+{
+    if (safe_str_eq(name, XML_CIB_TAG_CONFIGURATION)) {
+        return pcmk__section_configuration;
+
+    } else if (safe_str_eq(name, XML_CIB_TAG_STATUS)) {
+        return pcmk__section_status;
+    }
+    return pcmk__section_none;
+}
+
+/*!
+ * \internal
+ * \brief Fill in the section and IDs that a patchset change applies to
+ *
+ * \param[in,out] change  Change with path and result already set
+ */
+static void
+locate_change(pcmk__patch_change_t *change)
+{
+    const char *result_name = crm_element_name(change->result);
+
+    if ((change->n_steps > 1)
+        && safe_str_eq(change->steps[0].name, XML_TAG_CIB)) {
+        change->section = section_of(change->steps[1].name);
+
+    } else if (change->n_steps == 1) {
+        // A change to the CIB root, or a creation of one of its sections
+        change->section = pcmk__section_cib;
+        if (result_name && safe_str_eq(change->op, "create")) {
+            change->section = section_of(result_name);
+        }
+    }
+
+    change->node_id = pcmk__patch_path_id(change, XML_CIB_TAG_STATE);
+    if (change->node_id == NULL) {
+        change->node_id = pcmk__patch_path_id(change, XML_CIB_TAG_LRM);
+    }
+    change->rsc_id = pcmk__patch_path_id(change, XML_LRM_TAG_RESOURCE);
+    change->op_id = pcmk__patch_path_id(change, XML_LRM_TAG_RSC_OP);
+
+    // For a create, the path is the new element's parent
+    if ((change->node_id == NULL)
+        && (safe_str_eq(result_name, XML_CIB_TAG_STATE)
+            || safe_str_eq(result_name, XML_CIB_TAG_LRM))) {
+        change->node_id = ID(change->result);
+
+    } else if ((change->rsc_id == NULL)
+               && safe_str_eq(result_name, XML_LRM_TAG_RESOURCE)) {
+        change->rsc_id = ID(change->result);
+
+    } else if ((change->op_id == NULL)
+               && safe_str_eq(result_name, XML_LRM_TAG_RSC_OP)) {
+        change->op_id = ID(change->result);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Call a function for each change in a v2 patchset
+ *
+ * Changes to the version fields, and changes whose result is a comment, are
+ * skipped. The change passed to \p fn is valid only until \p fn returns.
+ *
+ * \param[in] patchset   Patchset to iterate over
+ * \param[in] fn         Function to call for each change
+ * \param[in] user_data  Data to pass to \p fn
+ *
+ * \return 0 if all changes were iterated over, otherwise the first nonzero
+ *         value returned by \p fn (which stops the iteration)
+ */
+int
+pcmk__patchset_foreach(xmlNode *patchset, pcmk__patch_change_fn fn,
+                       void *user_data)
+{
+    int rc = 0;
+    xmlNode *xml = NULL;
+
+    for (xml = first_named_child(patchset, XML_DIFF_CHANGE);
+         (xml != NULL) && (rc == 0); xml = crm_next_same_xml(xml)) {
+
+        pcmk__patch_change_t change = { 0, };
+        char *path = NULL;
+
+        change.op = crm_element_value(xml, XML_DIFF_OP);
+        change.path = crm_element_value(xml, XML_DIFF_PATH);
+        change.change = xml;
+
+        if ((change.op == NULL) || (change.path == NULL)) {
+            continue;
+        }
+
+        if (strcmp(change.op, "create") == 0) {
+            change.result = xml->children;
+
+        } else if (strcmp(change.op, "modify") == 0) {
+            change.result = first_named_child(xml, XML_DIFF_RESULT);
+            if (change.result != NULL) {
+                change.result = change.result->children;
+            }
+        }
+
+        if ((change.result != NULL)
+            && (change.result->type == XML_COMMENT_NODE)) {
+            crm_trace("Ignoring %s of comment at %s", change.op, change.path);
+            continue;
+        }
+
+        path = strdup(change.path);
+        CRM_ASSERT(path != NULL);
+        change.steps = parse_path(path, &change.n_steps);
+        locate_change(&change);
+
+        rc = fn(&change, user_data);
+
+        free(change.steps);
+        free(path);
+    }
+    return rc;
+}
+
+static void
+walk_rsc_ops(xmlNode *xml, const char *node_id, const char *rsc_id,
+             pcmk__rsc_op_fn fn, void *user_data)
+{
+    const char *name = crm_element_name(xml);
+    xmlNode *child = NULL;
+
+    if (safe_str_eq(name, XML_LRM_TAG_RSC_OP)) {
+        fn(xml, node_id, rsc_id, user_data);
+        return;
+
+    } else if (safe_str_eq(name, XML_CIB_TAG_STATE)
+               || safe_str_eq(name, XML_CIB_TAG_LRM)) {
+        node_id = ID(xml);
+
+    } else if (safe_str_eq(name, XML_LRM_TAG_RESOURCE)) {
+        rsc_id = ID(xml);
+
+    } else if (safe_str_neq(name, XML_TAG_CIB)
+               && safe_str_neq(name, XML_CIB_TAG_STATUS)
+               && safe_str_neq(name, XML_LRM_TAG_RESOURCES)) {
+        // Nothing else can contain resource history
+        return;
+    }
+
+    for (child = __xml_first_child_element(xml); child != NULL;
+         child = __xml_next_element(child)) {
+        walk_rsc_ops(child, node_id, rsc_id, fn, user_data);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Call a function for each resource operation created or modified by a
+ *        patchset change
+ *
+ * \param[in] change     Parsed patchset change
+ * \param[in] fn         Function to call for each operation history entry
+ * \param[in] user_data  Data to pass to \p fn
+ */
+void
+pcmk__patch_change_rsc_ops(const pcmk__patch_change_t *change,
+                           pcmk__rsc_op_fn fn, void *user_data)
+{
+    if ((change->result == NULL)
+        || ((change->section != pcmk__section_status)
+            && (change->section != pcmk__section_cib))) {
+        return;
+    }
+    walk_rsc_ops(change->result, change->node_id, change->rsc_id, fn,
+                 user_data);
+}
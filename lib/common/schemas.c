@@ -67,6 +67,16 @@ static struct schema_s *known_schemas = NULL;
 static int xml_schema_max = 0;
 static bool silent_logging = FALSE;
 
+#if HAVE_LIBXSLT
+// Compiled stylesheets, by transform name
+static GHashTable *xslt_cache = NULL;
+#endif
+
+// Most recent result of upgrading a configuration (see upgrade_copy())
+static char *upgrade_cache_key = NULL;
+static xmlNode *upgrade_cache_xml = NULL;
+static int upgrade_cache_version = -1;
+
 static void
 xml_log(int priority, const char *fmt, ...)
 G_GNUC_PRINTF(2, 3);
@@ -579,6 +589,19 @@ crm_schema_cleanup(void)
     free(known_schemas);
     known_schemas = NULL;
 
+    free(upgrade_cache_key);
+    upgrade_cache_key = NULL;
+    free_xml(upgrade_cache_xml);
+    upgrade_cache_xml = NULL;
+    upgrade_cache_version = -1;
+
+#if HAVE_LIBXSLT
+    if (xslt_cache != NULL) {
+        g_hash_table_destroy(xslt_cache);
+        xslt_cache = NULL;
+    }
+#endif
+
     xsltCleanupGlobals();  /* XXX proper, explicit reshaking regarding
                                   init/fini routines is pending (pair
                                   of facade functions to express the
@@ -894,10 +917,41 @@ cib_upgrade_err(void *ctx, const char *fmt, ...)
 #define PCMK_SCHEMAS_EMERGENCY_XSLT 1
 #endif
 
+/*!
+ * \internal
+ * \brief Get a compiled stylesheet, parsing it only the first time
+ *
+ * \param[in] transform  Name of transform
+ *
+ * \return Compiled stylesheet (owned by the cache), or NULL on error
+ */
+static xsltStylesheet *
+get_stylesheet(const char *transform)
+{
+    char *xform = NULL;
+    xsltStylesheet *xslt = NULL;
+
+    if (xslt_cache == NULL) {
+        xslt_cache = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                           (GDestroyNotify) xsltFreeStylesheet);
+    }
+
+    xslt = g_hash_table_lookup(xslt_cache, transform);
+    if (xslt == NULL) {
+        xform = get_schema_path(NULL, transform);
+        xslt = xsltParseStylesheetFile((pcmkXmlStr) xform);
+        if (xslt != NULL) {
+            crm_trace("Compiled stylesheet %s", xform);
+            g_hash_table_insert(xslt_cache, strdup(transform), xslt);
+        }
+        free(xform);
+    }
+    return xslt;
+}
+
 static xmlNode *
 apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 {
-    char *xform = NULL;
     xmlNode *out = NULL;
     xmlDocPtr res = NULL;
     xmlDocPtr doc = NULL;
@@ -910,7 +964,6 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 
     CRM_CHECK(xml != NULL, return FALSE);
     doc = getDocPtr(xml);
-    xform = get_schema_path(NULL, transform);
 
     xmlLoadExtDtdDefaultValue = 1;
     xmlSubstituteEntitiesDefault(1);
@@ -922,7 +975,7 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
         xsltSetGenericErrorFunc(&crm_log_level, cib_upgrade_err);
     }
 
-    xslt = xsltParseStylesheetFile((pcmkXmlStr) xform);
+    xslt = get_stylesheet(transform);
     CRM_CHECK(xslt != NULL, goto cleanup);
 
     res = xsltApplyStylesheet(xslt, doc, NULL);
@@ -943,12 +996,6 @@ apply_transformation(xmlNode *xml, const char *transform, gboolean to_logs)
 #endif
 
   cleanup:
-    if (xslt) {
-        xsltFreeStylesheet(xslt);
-    }
-
-    free(xform);
-
     return out;
 }
 
@@ -1187,6 +1234,116 @@ update_validation(xmlNode **xml_blob, int *best, int max, gboolean transform,
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Get a key identifying the configuration of a CIB
+ *
+ * \param[in] xml  CIB XML
+ *
+ * \return Newly allocated string combining the CIB's validate-with value and a
+ *         digest of everything in it but the status section and root attributes
+ */
+static char *
+upgrade_key(xmlNode *xml)
+{
+    char *key = NULL;
+    xmlNode *child = NULL;
+    GString *digests = g_string_new(crm_element_value(xml, XML_ATTR_VALIDATION));
+
+    for (child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+
+        if ((child->type == XML_ELEMENT_NODE)
+            && safe_str_neq(crm_element_name(child), XML_CIB_TAG_STATUS)) {
+            char *digest = calculate_xml_versioned_digest(child, FALSE, FALSE,
+                                                          CRM_FEATURE_SET);
+
+            g_string_append_printf(digests, ":%s", digest);
+            free(digest);
+        }
+    }
+    key = strdup(digests->str);
+    g_string_free(digests, TRUE);
+    return key;
+}
+
+/*!
+ * \internal
+ * \brief Upgrade a copy of a CIB to the newest possible schema
+ *
+ * Every schema defines the status section as free-form, and the upgrade
+ * transformations copy it unchanged, so only the rest of the CIB is validated
+ * and transformed, and the original status section is added to the result.
+ * The most recent successful upgrade is cached, so that upgrading a CIB whose
+ * configuration hasn't changed since (for example, each scheduler input after a
+ * status update) just copies the result.
+ *
+ * \param[in]  xml      CIB XML to upgrade
+ * \param[out] version  Where to store index of schema that result validates
+ *                      against
+ * \param[in]  to_logs  If TRUE, log problems, otherwise print them to stderr
+ *
+ * \return Newly allocated upgraded copy of \p xml
+ */
+static xmlNode *
+upgrade_copy(xmlNode *xml, int *version, gboolean to_logs)
+{
+    char *key = upgrade_key(xml);
+    xmlNode *converted = NULL;
+    xmlNode *status = NULL;
+    xmlNode *child = NULL;
+
+    if ((upgrade_cache_xml == NULL) || safe_str_neq(key, upgrade_cache_key)) {
+        int min_version = xml_minimum_schema_index();
+
+        converted = create_xml_node(NULL, crm_element_name(xml));
+        copy_in_properties(converted, xml);
+        for (child = __xml_first_child(xml); child != NULL;
+             child = __xml_next(child)) {
+
+            if (safe_str_neq(crm_element_name(child), XML_CIB_TAG_STATUS)) {
+                add_node_copy(converted, child);
+            }
+        }
+
+        update_validation(&converted, version, 0, TRUE, to_logs);
+
+        free(upgrade_cache_key);
+        upgrade_cache_key = NULL;
+        free_xml(upgrade_cache_xml);
+        upgrade_cache_xml = NULL;
+
+        if (*version >= min_version) {
+            upgrade_cache_key = key;
+            key = NULL;
+            upgrade_cache_xml = copy_xml(converted);
+            upgrade_cache_version = *version;
+        }
+
+    } else {
+        crm_trace("Reusing cached upgrade of configuration to %s",
+                  get_schema_name(upgrade_cache_version));
+
+        // Only validate-with differs in the upgraded root element
+        converted = create_xml_node(NULL, crm_element_name(xml));
+        copy_in_properties(converted, xml);
+        crm_xml_add(converted, XML_ATTR_VALIDATION,
+                    crm_element_value(upgrade_cache_xml, XML_ATTR_VALIDATION));
+        for (child = __xml_first_child(upgrade_cache_xml); child != NULL;
+             child = __xml_next(child)) {
+            add_node_copy(converted, child);
+        }
+        *version = upgrade_cache_version;
+    }
+
+    status = first_named_child(xml, XML_CIB_TAG_STATUS);
+    if (status != NULL) {
+        add_node_copy(converted, status);
+    }
+    free(key);
+    return converted;
+}
+
 gboolean
 cli_config_update(xmlNode **xml, int *best_version, gboolean to_logs)
 {
@@ -1199,10 +1356,7 @@ cli_config_update(xmlNode **xml, int *best_version, gboolean to_logs)
     int min_version = xml_minimum_schema_index();
 
     if (version < min_version) {
-        xmlNode *converted = NULL;
-
-        converted = copy_xml(*xml);
-        update_validation(&converted, &version, 0, TRUE, to_logs);
+        xmlNode *converted = upgrade_copy(*xml, &version, to_logs);
 
         value = crm_element_value(converted, XML_ATTR_VALIDATION);
         if (version < min_version) {
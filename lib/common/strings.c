@@ -20,6 +20,16 @@
 #include <bzlib.h>
 #include <sys/types.h>
 
+#if defined(HAVE_LZ4_H) && defined(HAVE_LIBLZ4)
+#  include <lz4.h>
+#  define PCMK__HAVE_LZ4 1
+#endif
+#if defined(HAVE_ZSTD_H) && defined(HAVE_LIBZSTD)
+#  include <zstd.h>
+#  include <zstd_errors.h>
+#  define PCMK__HAVE_ZSTD 1
+#endif
+
 char *
 crm_itoa_stack(int an_int, char *buffer, size_t len)
 {
@@ -432,7 +442,7 @@ crm_compress_string(const char *data, int length, int max, char **result, unsign
 {
     int rc;
     char *compressed = NULL;
-    char *uncompressed = strdup(data);
+    char *uncompressed = NULL;
 #ifdef CLOCK_MONOTONIC
     struct timespec after_t;
     struct timespec before_t;
@@ -442,6 +452,13 @@ crm_compress_string(const char *data, int length, int max, char **result, unsign
         max = (length * 1.1) + 600; /* recommended size */
     }
 
+    /* Copy exactly length bytes, since data may be binary (and bzip2 wants a
+     * non-const input buffer)
+     */
+    uncompressed = malloc(length);
+    CRM_ASSERT(uncompressed != NULL);
+    memcpy(uncompressed, data, length);
+
 #ifdef CLOCK_MONOTONIC
     clock_gettime(CLOCK_MONOTONIC, &before_t);
 #endif
@@ -478,6 +495,271 @@ crm_compress_string(const char *data, int length, int max, char **result, unsign
     return TRUE;
 }
 
+/*!
+ * \internal
+ * \brief Get the compression codecs supported by this build
+ *
+ * \return Bitmask of supported codecs (1 << each enum pcmk__codec value)
+ */
+uint8_t
+pcmk__supported_codecs(void)
+{
+    uint8_t codecs = (1 << pcmk__codec_bzip2);
+
+#ifdef PCMK__HAVE_LZ4
+    codecs |= (1 << pcmk__codec_lz4);
+#endif
+#ifdef PCMK__HAVE_ZSTD
+    codecs |= (1 << pcmk__codec_zstd);
+#endif
+    return codecs;
+}
+
+/*!
+ * \internal
+ * \brief Choose the fastest codec supported both locally and by a peer
+ *
+ * \param[in] accepted  Bitmask of codecs the peer can decompress
+ *
+ * \return Best codec to compress with (bzip2 if nothing better is shared)
+ */
+enum pcmk__codec
+pcmk__best_codec(uint8_t accepted)
+{
+    accepted &= pcmk__supported_codecs();
+    if (accepted & (1 << pcmk__codec_lz4)) {
+        return pcmk__codec_lz4;
+    } else if (accepted & (1 << pcmk__codec_zstd)) {
+        return pcmk__codec_zstd;
+    }
+    return pcmk__codec_bzip2;
+}
+
+const char *
+pcmk__codec_text(enum pcmk__codec codec)
+{
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            return "bzip2";
+        case pcmk__codec_lz4:
+            return "lz4";
+        case pcmk__codec_zstd:
+            return "zstd";
+    }
+    return "unknown";
+}
+
+/*!
+ * \internal
+ * \brief Get the file name extension for a codec
+ *
+ * \param[in] codec  Codec to check
+ *
+ * \return Extension (without the dot) conventionally used for files
+ *         compressed with \p codec
+ */
+const char *
+pcmk__codec_ext(enum pcmk__codec codec)
+{
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            return "bz2";
+        case pcmk__codec_lz4:
+            return "lz4";
+        case pcmk__codec_zstd:
+            return "zst";
+    }
+    return "unknown";
+}
+
+/*!
+ * \internal
+ * \brief Get the codec to compress files (such as scheduler inputs) with
+ *
+ * \return zstd if this build supports it, otherwise bzip2
+ * \note LZ4 is not used for files, because pcmk__compress() produces raw LZ4
+ *       blocks, which the lz4 command-line tool can't read. zstd output is a
+ *       standard frame that the zstd tool can decompress.
+ */
+enum pcmk__codec
+pcmk__file_codec(void)
+{
+#ifdef PCMK__HAVE_ZSTD
+    return pcmk__codec_zstd;
+#else
+    return pcmk__codec_bzip2;
+#endif
+}
+
+/*!
+ * \internal
+ * \brief Get the uncompressed size recorded in compressed data, if any
+ *
+ * \param[in] codec   Codec that \p data was compressed with
+ * \param[in] data    Compressed data
+ * \param[in] length  Size of \p data
+ *
+ * \return Uncompressed size of \p data if the codec's format records it,
+ *         otherwise 0
+ */
+unsigned int
+pcmk__decompressed_size(enum pcmk__codec codec, const char *data,
+                        unsigned int length)
+{
+#ifdef PCMK__HAVE_ZSTD
+    if (codec == pcmk__codec_zstd) {
+        unsigned long long size = ZSTD_getFrameContentSize(data, length);
+
+        if ((size != ZSTD_CONTENTSIZE_UNKNOWN)
+            && (size != ZSTD_CONTENTSIZE_ERROR) && (size < UINT_MAX)) {
+            return (unsigned int) size;
+        }
+    }
+#endif
+    return 0;
+}
+
+/*!
+ * \internal
+ * \brief Compress data with a specified codec
+ *
+ * \param[in]  codec       Codec to use
+ * \param[in]  data        Data to compress
+ * \param[in]  length      Number of bytes of \p data to compress
+ * \param[in]  max         Fail if result would be larger than this (or 0 to
+ *                         use the worst-case size for the codec)
+ * \param[out] result      Where to store newly allocated compressed data
+ * \param[out] result_len  Where to store size of \p result
+ *
+ * \return TRUE on success, FALSE otherwise
+ * \note The caller is responsible for freeing \p result with free().
+ */
+bool
+pcmk__compress(enum pcmk__codec codec, const char *data, unsigned int length,
+               unsigned int max, char **result, unsigned int *result_len)
+{
+    char *compressed = NULL;
+    long long rc = 0;
+
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            return crm_compress_string(data, length, max, result, result_len);
+
+#ifdef PCMK__HAVE_LZ4
+        case pcmk__codec_lz4:
+            if (max == 0) {
+                max = LZ4_compressBound(length);
+            }
+            compressed = malloc(max);
+            CRM_ASSERT(compressed != NULL);
+            rc = LZ4_compress_default(data, compressed, length, max);
+            if (rc <= 0) {
+                // Only possible if result wouldn't fit in max
+                crm_trace("Compression of %u bytes with lz4 would exceed %u",
+                          length, max);
+                free(compressed);
+                return FALSE;
+            }
+            break;
+#endif
+
+#ifdef PCMK__HAVE_ZSTD
+        case pcmk__codec_zstd:
+            if (max == 0) {
+                max = ZSTD_compressBound(length);
+            }
+            compressed = malloc(max);
+            CRM_ASSERT(compressed != NULL);
+            rc = (long long) ZSTD_compress(compressed, max, data, length, 1);
+            if (ZSTD_isError((size_t) rc)) {
+                if (ZSTD_getErrorCode((size_t) rc)
+                    == ZSTD_error_dstSize_tooSmall) {
+                    crm_trace("Compression of %u bytes with zstd would exceed %u",
+                              length, max);
+                } else {
+                    crm_err("Compression of %u bytes with zstd failed: %s",
+                            length, ZSTD_getErrorName((size_t) rc));
+                }
+                free(compressed);
+                return FALSE;
+            }
+            break;
+#endif
+
+        default:
+            crm_err("Compression codec %s is not supported by this build",
+                    pcmk__codec_text(codec));
+            return FALSE;
+    }
+
+    crm_trace("Compressed %u bytes into %lld with %s",
+              length, rc, pcmk__codec_text(codec));
+    *result = compressed;
+    *result_len = (unsigned int) rc;
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Decompress data compressed with a specified codec
+ *
+ * \param[in]     codec       Codec that \p data was compressed with
+ * \param[in]     data        Compressed data
+ * \param[in]     length      Size of \p data
+ * \param[out]    result      Buffer to decompress into
+ * \param[in,out] result_len  Size of \p result on input, size of
+ *                            decompressed data on output
+ *
+ * \return pcmk_ok on success, -errno otherwise
+ */
+int
+pcmk__decompress(enum pcmk__codec codec, const char *data, unsigned int length,
+                 char *result, unsigned int *result_len)
+{
+    long long rc = 0;
+
+    switch (codec) {
+        case pcmk__codec_bzip2:
+            rc = BZ2_bzBuffToBuffDecompress(result, result_len, (char *) data,
+                                            length, 1, 0);
+            if (rc != BZ_OK) {
+                crm_err("Decompression failed: %s " CRM_XS " bzerror=%lld",
+                        bz2_strerror(rc), rc);
+                return -EILSEQ;
+            }
+            return pcmk_ok;
+
+#ifdef PCMK__HAVE_LZ4
+        case pcmk__codec_lz4:
+            rc = LZ4_decompress_safe(data, result, length, *result_len);
+            if (rc < 0) {
+                crm_err("Decompression with lz4 failed " CRM_XS " rc=%lld",
+                        rc);
+                return -EILSEQ;
+            }
+            *result_len = (unsigned int) rc;
+            return pcmk_ok;
+#endif
+
+#ifdef PCMK__HAVE_ZSTD
+        case pcmk__codec_zstd:
+            rc = (long long) ZSTD_decompress(result, *result_len, data, length);
+            if (ZSTD_isError((size_t) rc)) {
+                crm_err("Decompression with zstd failed: %s",
+                        ZSTD_getErrorName((size_t) rc));
+                return -EILSEQ;
+            }
+            *result_len = (unsigned int) rc;
+            return pcmk_ok;
+#endif
+
+        default:
+            crm_err("Cannot decompress message compressed with unsupported codec %d",
+                    codec);
+            return -EPROTONOSUPPORT;
+    }
+}
+
 /*!
  * \brief Compare two strings alphabetically (case-insensitive)
  *
@@ -1786,12 +1786,26 @@ find_xml_node(xmlNode * root, const char *search_path, gboolean must_find)
     return NULL;
 }
 
-/* As the name suggests, the perfect match is required for both node
-   name and fully specified attribute, otherwise, when attribute not
-   specified, the outcome is the first node matching on the name. */
-static xmlNode *
-find_entity_by_attr_or_just_name(xmlNode *parent, const char *node_name,
-                                 const char *attr_n, const char *attr_v)
+/*!
+ * \internal
+ * \brief Find first child element matching a name and optional attribute
+ *
+ * As the name suggests, the perfect match is required for both node name and
+ * fully specified attribute, otherwise, when attribute not specified, the
+ * outcome is the first node matching on the name. This is the cheap
+ * alternative to an XPath search for "child with this id under this parent".
+ *
+ * \param[in] parent     XML element to search
+ * \param[in] node_name  If not NULL, only match children of this type
+ * \param[in] attr_n     If not NULL, only match children with an attribute
+ *                       of this name and a value of \p attr_v
+ * \param[in] attr_v     If \p attr_n is not NULL, value to match
+ *
+ * \return Matching XML child element, or NULL if none found
+ */
+xmlNode *
+pcmk__xe_match(xmlNode *parent, const char *node_name,
+               const char *attr_n, const char *attr_v)
 {
     xmlNode *child;
 
@@ -1821,8 +1835,8 @@ find_entity_by_attr_or_just_name(xmlNode *parent, const char *node_name,
 xmlNode *
 find_entity(xmlNode *parent, const char *node_name, const char *id)
 {
-    return find_entity_by_attr_or_just_name(parent, node_name,
-                                            (id == NULL) ? id : XML_ATTR_ID, id);
+    return pcmk__xe_match(parent, node_name,
+                          (id == NULL) ? id : XML_ATTR_ID, id);
 }
 
 void
@@ -2259,11 +2273,61 @@ stdin2xml(void)
     return xml_obj;
 }
 
+/*!
+ * \internal
+ * \brief Read a file compressed with a codec that records the original size
+ *
+ * \param[in] filename  Name of file to read
+ * \param[in] codec     Codec that the file was compressed with
+ *
+ * \return Newly allocated nul-terminated decompressed contents, or NULL on error
+ */
+static char *
+decompress_file_codec(const char *filename, enum pcmk__codec codec)
+{
+    gchar *data = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+    char *buffer = NULL;
+    unsigned int size = 0;
+
+    if (!g_file_get_contents(filename, &data, &length, &error)) {
+        crm_err("Could not read %s: %s", filename, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    size = pcmk__decompressed_size(codec, data, (unsigned int) length);
+    if (size == 0) {
+        crm_err("Could not read compressed %s: not %s data or not supported "
+                "by this build", filename, pcmk__codec_text(codec));
+        g_free(data);
+        return NULL;
+    }
+
+    buffer = malloc(size + 1);
+    CRM_ASSERT(buffer != NULL);
+    if (pcmk__decompress(codec, data, (unsigned int) length, buffer,
+                         &size) != pcmk_ok) {
+        crm_err("Could not read compressed %s", filename);
+        free(buffer);
+        buffer = NULL;
+    } else {
+        buffer[size] = '\0';
+    }
+    g_free(data);
+    return buffer;
+}
+
 static char *
 decompress_file(const char *filename)
 {
     char *buffer = NULL;
 
+    if (crm_ends_with_ext(filename, ".zst")) {
+        return decompress_file_codec(filename, pcmk__codec_zstd);
+    }
+
 #if HAVE_BZLIB_H
     int rc = 0;
     size_t length = 0, read_len = 0;
@@ -2360,7 +2424,8 @@ filename2xml(const char *filename)
     xmlSetGenericErrorFunc(ctxt, crm_xml_err);
 
     if (filename) {
-        uncompressed = !crm_ends_with_ext(filename, ".bz2");
+        uncompressed = !crm_ends_with_ext(filename, ".bz2")
+                       && !crm_ends_with_ext(filename, ".zst");
     }
 
     if (filename == NULL) {
@@ -2492,7 +2557,29 @@ write_xml_stream(xmlNode * xml_node, const char *filename, FILE * stream, gboole
               res = -pcmk_err_generic;
               goto bail);
 
-    if (compress) {
+    if (compress && crm_ends_with_ext(filename, ".zst")) {
+        char *compressed = NULL;
+
+        if (!pcmk__compress(pcmk__codec_zstd, buffer, strlen(buffer), 0,
+                            &compressed, &out)) {
+            crm_warn("Not compressing %s: could not compress data with zstd",
+                     filename);
+            out = 0;
+
+        } else if (fwrite(compressed, 1, out, stream) != out) {
+            res = -errno;
+            crm_perror(LOG_ERR, "writing %s", filename);
+            free(compressed);
+            goto bail;
+
+        } else {
+            res = (int) out;
+            crm_trace("Compressed XML for %s from %lu bytes to %u with zstd",
+                      filename, (unsigned long) strlen(buffer), out);
+        }
+        free(compressed);
+
+    } else if (compress) {
 #if HAVE_BZLIB_H
         int rc = BZ_OK;
         unsigned int in = 0;
@@ -4130,8 +4217,8 @@ add_xml_object(xmlNode * parent, xmlNode * target, xmlNode * update, gboolean as
     CRM_CHECK(target != NULL || parent != NULL, return 0);
 
     if (target == NULL) {
-        target = find_entity_by_attr_or_just_name(parent, object_name,
-                                                  object_href, object_href_val);
+        target = pcmk__xe_match(parent, object_name, object_href,
+                                object_href_val);
     }
 
     if (target == NULL) {
@@ -4443,6 +4530,7 @@ crm_xml_cleanup(void)
 {
     crm_info("Cleaning up memory from libxml2");
     crm_schema_cleanup();
+    pcmk__xpath_cleanup();
     xmlCleanupParser();
 }
 
@@ -0,0 +1,415 @@
+/*
+ * Copyright 2019 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+
+#include <crm/crm.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+#include "crmcommon_private.h"
+
+/*
+ * Binary XML encoding
+ *
+ * This is a compact alternative to XML text for messages passed between
+ * daemons, which avoids both escaping on the sending side and a full XML parse
+ * on the receiving side.
+ *
+ * An encoded message is the magic bytes "PXB", a format version byte, and a
+ * single encoded root element. All integers are unsigned LEB128 varints.
+ * Strings are prefixed with their length and include their terminating nul
+ * byte, so that a decoder can use them in place. Element and attribute names
+ * are interned per message: the first occurrence of a name is encoded as 0
+ * followed by the string, and later occurrences as 1 + its index in the order
+ * names were first seen.
+ *
+ *    node    := 'E' name nattrs (name string)* nchildren node*
+ *             | 'T' string | 'C' string | 'D' string
+ *
+ * for element, text, comment and CDATA nodes respectively.
+ */
+
+#define PXB_MAGIC       "PXB"
+#define PXB_MAGIC_LEN   3
+#define PXB_VERSION     1
+
+// Guard against stack exhaustion from malicious or corrupted input
+#define PXB_MAX_DEPTH   512
+
+typedef struct pxb_writer_s {
+    char *buffer;
+    size_t len;
+    size_t max;
+    GHashTable *names;  // name -> 1 + index in name table
+} pxb_writer_t;
+
+typedef struct pxb_reader_s {
+    const unsigned char *buffer;
+    size_t len;
+    size_t offset;
+    GPtrArray *names;   // index -> name (pointing into buffer)
+} pxb_reader_t;
+
+/* Encoding */
+
+static void
+pxb_reserve(pxb_writer_t *w, size_t needed)
+{
+    if ((w->len + needed) > w->max) {
+        w->max = QB_MAX(2 * w->max, w->len + needed + 256);
+        w->buffer = realloc_safe(w->buffer, w->max);
+    }
+}
+
+static inline void
+pxb_write_byte(pxb_writer_t *w, unsigned char c)
+{
+    pxb_reserve(w, 1);
+    w->buffer[w->len++] = (char) c;
+}
+
+static void
+pxb_write_varint(pxb_writer_t *w, size_t value)
+{
+    pxb_reserve(w, 10);
+    while (value >= 0x80) {
+        w->buffer[w->len++] = (char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    w->buffer[w->len++] = (char) value;
+}
+
+static void
+pxb_write_string(pxb_writer_t *w, const char *s)
+{
+    size_t len = 1 + ((s == NULL)? 0 : strlen(s));
+
+    pxb_write_varint(w, len);
+    pxb_reserve(w, len);
+    if (len > 1) {
+        memcpy(w->buffer + w->len, s, len);
+    } else {
+        w->buffer[w->len] = '\0';
+    }
+    w->len += len;
+}
+
+static void
+pxb_write_name(pxb_writer_t *w, const char *name)
+{
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup(w->names, name));
+
+    if (index > 0) {
+        pxb_write_varint(w, index);
+    } else {
+        pxb_write_varint(w, 0);
+        pxb_write_string(w, name);
+        g_hash_table_insert(w->names, (gpointer) name,
+                            GUINT_TO_POINTER(g_hash_table_size(w->names) + 1));
+    }
+}
+
+static bool
+pxb_node_supported(const xmlNode *xml)
+{
+    switch (xml->type) {
+        case XML_ELEMENT_NODE:
+        case XML_TEXT_NODE:
+        case XML_COMMENT_NODE:
+        case XML_CDATA_SECTION_NODE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static void
+pxb_write_node(pxb_writer_t *w, xmlNode *xml)
+{
+    size_t count = 0;
+    xmlAttr *attr = NULL;
+    xmlNode *child = NULL;
+
+    switch (xml->type) {
+        case XML_TEXT_NODE:
+            pxb_write_byte(w, 'T');
+            pxb_write_string(w, (const char *) xml->content);
+            return;
+        case XML_COMMENT_NODE:
+            pxb_write_byte(w, 'C');
+            pxb_write_string(w, (const char *) xml->content);
+            return;
+        case XML_CDATA_SECTION_NODE:
+            pxb_write_byte(w, 'D');
+            pxb_write_string(w, (const char *) xml->content);
+            return;
+        default:
+            break;
+    }
+
+    pxb_write_byte(w, 'E');
+    pxb_write_name(w, (const char *) xml->name);
+
+    for (attr = pcmk__first_xml_attr(xml); attr != NULL; attr = attr->next) {
+        count++;
+    }
+    pxb_write_varint(w, count);
+    for (attr = pcmk__first_xml_attr(xml); attr != NULL; attr = attr->next) {
+        pxb_write_name(w, (const char *) attr->name);
+        pxb_write_string(w, pcmk__xml_attr_value(attr));
+    }
+
+    count = 0;
+    for (child = xml->children; child != NULL; child = child->next) {
+        if (pxb_node_supported(child)) {
+            count++;
+        }
+    }
+    pxb_write_varint(w, count);
+    for (child = xml->children; child != NULL; child = child->next) {
+        if (pxb_node_supported(child)) {
+            pxb_write_node(w, child);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Encode an XML element in binary XML encoding
+ *
+ * \param[in]  xml  XML element to encode
+ * \param[out] len  Where to store the length of the result
+ *
+ * \return Newly allocated buffer with the encoded XML (or NULL if \p xml is
+ *         not an element)
+ * \note The result is followed by a nul byte that is not counted in \p len.
+ *       The caller is responsible for freeing the result with free().
+ */
+char *
+pcmk__xml_binary_dump(xmlNode *xml, unsigned int *len)
+{
+    pxb_writer_t w = { NULL, 0, 0, NULL };
+
+    CRM_CHECK(len != NULL, return NULL);
+    *len = 0;
+    CRM_CHECK((xml != NULL) && (xml->type == XML_ELEMENT_NODE), return NULL);
+
+    w.names = g_hash_table_new(g_str_hash, g_str_equal);
+
+    pxb_reserve(&w, 1024);
+    memcpy(w.buffer, PXB_MAGIC, PXB_MAGIC_LEN);
+    w.len = PXB_MAGIC_LEN;
+    pxb_write_byte(&w, PXB_VERSION);
+    pxb_write_node(&w, xml);
+
+    // Terminate (without counting it) for callers that expect a string
+    pxb_reserve(&w, 1);
+    w.buffer[w.len] = '\0';
+
+    g_hash_table_destroy(w.names);
+    *len = (unsigned int) w.len;
+    return w.buffer;
+}
+
+/* Decoding */
+
+static bool
+pxb_read_varint(pxb_reader_t *r, size_t *value)
+{
+    unsigned int shift = 0;
+
+    *value = 0;
+    while (r->offset < r->len) {
+        unsigned char c = r->buffer[r->offset++];
+
+        if (shift > 28) {
+            return FALSE;
+        }
+        *value |= ((size_t) (c & 0x7f)) << shift;
+        if ((c & 0x80) == 0) {
+            return TRUE;
+        }
+        shift += 7;
+    }
+    return FALSE;
+}
+
+static bool
+pxb_read_string(pxb_reader_t *r, const char **s, size_t *s_len)
+{
+    size_t len = 0;
+
+    if (!pxb_read_varint(r, &len) || (len == 0)
+        || (len > (r->len - r->offset))
+        || (r->buffer[r->offset + len - 1] != '\0')) {
+        return FALSE;
+    }
+    *s = (const char *) (r->buffer + r->offset);
+    if (s_len != NULL) {
+        *s_len = len - 1;
+    }
+    r->offset += len;
+    return TRUE;
+}
+
+static bool
+pxb_read_name(pxb_reader_t *r, const char **name)
+{
+    size_t index = 0;
+
+    if (!pxb_read_varint(r, &index)) {
+        return FALSE;
+
+    } else if (index == 0) {
+        if (!pxb_read_string(r, name, NULL) || ((*name)[0] == '\0')) {
+            return FALSE;
+        }
+        g_ptr_array_add(r->names, (gpointer) *name);
+        return TRUE;
+
+    } else if (index <= r->names->len) {
+        *name = g_ptr_array_index(r->names, index - 1);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static bool
+pxb_read_node(pxb_reader_t *r, xmlDoc *doc, xmlNode *parent, int depth)
+{
+    unsigned char type = 0;
+    const char *name = NULL;
+    const char *value = NULL;
+    size_t value_len = 0;
+    size_t count = 0;
+    xmlNode *xml = NULL;
+
+    if ((depth > PXB_MAX_DEPTH) || (r->offset >= r->len)) {
+        return FALSE;
+    }
+
+    type = r->buffer[r->offset++];
+    if (type != 'E') {
+        if ((parent == NULL) || !pxb_read_string(r, &value, &value_len)) {
+            return FALSE;
+        }
+        switch (type) {
+            case 'T':
+                xml = xmlNewDocText(doc, (pcmkXmlStr) value);
+                break;
+            case 'C':
+                xml = xmlNewDocComment(doc, (pcmkXmlStr) value);
+                break;
+            case 'D':
+                xml = xmlNewCDataBlock(doc, (pcmkXmlStr) value, value_len);
+                break;
+            default:
+                return FALSE;
+        }
+        CRM_ASSERT(xml != NULL);
+        xmlAddChild(parent, xml);
+        return TRUE;
+    }
+
+    if (!pxb_read_name(r, &name)) {
+        return FALSE;
+    }
+    xml = xmlNewDocRawNode(doc, NULL, (pcmkXmlStr) name, NULL);
+    CRM_ASSERT(xml != NULL);
+    if (parent == NULL) {
+        xmlDocSetRootElement(doc, xml);
+    } else {
+        xmlAddChild(parent, xml);
+    }
+
+    if (!pxb_read_varint(r, &count)) {
+        return FALSE;
+    }
+    for (; count > 0; count--) {
+        if (!pxb_read_name(r, &name) || !pxb_read_string(r, &value, NULL)) {
+            return FALSE;
+        }
+        xmlNewProp(xml, (pcmkXmlStr) name, (pcmkXmlStr) value);
+    }
+
+    if (!pxb_read_varint(r, &count)) {
+        return FALSE;
+    }
+    for (; count > 0; count--) {
+        if (!pxb_read_node(r, doc, xml, depth + 1)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a buffer looks like binary-encoded XML
+ *
+ * \param[in] data  Buffer to check
+ * \param[in] len   Length of \p data
+ *
+ * \return TRUE if \p data starts with the binary XML magic, FALSE otherwise
+ */
+bool
+pcmk__xml_is_binary(const char *data, size_t len)
+{
+    return (data != NULL) && (len > PXB_MAGIC_LEN)
+           && (memcmp(data, PXB_MAGIC, PXB_MAGIC_LEN) == 0);
+}
+
+/*!
+ * \internal
+ * \brief Create an XML document from binary XML encoding
+ *
+ * \param[in] data  Encoded XML, as created by pcmk__xml_binary_dump()
+ * \param[in] len   Length of \p data
+ *
+ * \return Root element of newly created XML document, or NULL on error
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+pcmk__xml_binary_parse(const char *data, size_t len)
+{
+    pxb_reader_t r = { (const unsigned char *) data, len, 0, NULL };
+    xmlDoc *doc = NULL;
+    bool ok = FALSE;
+
+    if (!pcmk__xml_is_binary(data, len)) {
+        crm_err("Cannot parse binary XML: bad magic");
+        return NULL;
+
+    } else if (r.buffer[PXB_MAGIC_LEN] != PXB_VERSION) {
+        crm_err("Cannot parse binary XML: unsupported format version %d",
+                r.buffer[PXB_MAGIC_LEN]);
+        return NULL;
+    }
+
+    r.offset = PXB_MAGIC_LEN + 1;
+    r.names = g_ptr_array_new();
+    doc = xmlNewDoc((pcmkXmlStr) "1.0");
+    CRM_ASSERT(doc != NULL);
+
+    ok = pxb_read_node(&r, doc, NULL, 0);
+    g_ptr_array_free(r.names, TRUE);
+
+    if (!ok || (r.offset != r.len)) {
+        crm_err("Cannot parse binary XML: malformed at offset %llu of %llu",
+                (unsigned long long) r.offset, (unsigned long long) r.len);
+        xmlFreeDoc(doc);
+        return NULL;
+    }
+    return xmlDocGetRootElement(doc);
+}
@@ -20,6 +20,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <crm/common/xml_internal.h>
+
 /*
  * From xpath2.c
  *
@@ -140,6 +142,113 @@ dedupXpathResults(xmlXPathObjectPtr xpathObj)
     }
 }
 
+// Locations of expressions compiled by pcmk__xpath_search_const()
+static GSList *const_exprs = NULL;
+
+/*!
+ * \internal
+ * \brief Compile an XPath expression for repeated use
+ *
+ * \param[in] path  XPath expression text
+ *
+ * \return Newly allocated compiled expression, or NULL if invalid
+ * \note The caller is responsible for freeing the result with
+ *       xmlXPathFreeCompExpr().
+ */
+xmlXPathCompExprPtr
+pcmk__xpath_compile(const char *path)
+{
+    xmlXPathCompExprPtr expr = NULL;
+
+    CRM_CHECK((path != NULL) && (path[0] != '\0'), return NULL);
+
+    expr = xmlXPathCompile((pcmkXmlStr) path);
+    if (expr == NULL) {
+        crm_err("Could not compile XPath expression %s", path);
+    }
+    return expr;
+}
+
+/*!
+ * \internal
+ * \brief Evaluate a compiled XPath expression against an XML document
+ *
+ * \param[in] xml_top  Any node in the document to search
+ * \param[in] expr     Compiled expression (as from pcmk__xpath_compile())
+ *
+ * \return Search result (free with freeXpathObject()), or NULL on error
+ * \note The caller needs to check if the result contains a xmlDocPtr or
+ *       xmlNodePtr.
+ */
+xmlXPathObjectPtr
+pcmk__xpath_search_compiled(xmlNode *xml_top, xmlXPathCompExprPtr expr)
+{
+    xmlXPathObjectPtr xpathObj = NULL;
+    xmlXPathContextPtr xpathCtx = NULL;
+
+    CRM_CHECK(expr != NULL, return NULL);
+    CRM_CHECK(xml_top != NULL, return NULL);
+
+    xpathCtx = xmlXPathNewContext(getDocPtr(xml_top));
+    CRM_ASSERT(xpathCtx != NULL);
+
+    xpathObj = xmlXPathCompiledEval(expr, xpathCtx);
+    xmlXPathFreeContext(xpathCtx);
+    return xpathObj;
+}
+
+/*!
+ * \internal
+ * \brief Search XML with a constant XPath expression, compiling it only once
+ *
+ * This is for callers that search often with an expression that never changes
+ * (not one that embeds an ID or other variable). The expression is compiled on
+ * the first call and kept until crm_xml_cleanup().
+ *
+ * \param[in]     xml_top  Any node in the document to search
+ * \param[in]     path     XPath expression text (the same for every call)
+ * \param[in,out] expr     Where to keep the compiled expression (should be a
+ *                         static variable initialized to NULL)
+ *
+ * \return Search result (free with freeXpathObject()), or NULL on error
+ * \note The caller needs to check if the result contains a xmlDocPtr or
+ *       xmlNodePtr.
+ */
+xmlXPathObjectPtr
+pcmk__xpath_search_const(xmlNode *xml_top, const char *path,
+                         xmlXPathCompExprPtr *expr)
+{
+    CRM_CHECK(expr != NULL, return NULL);
+
+    if (*expr == NULL) {
+        *expr = pcmk__xpath_compile(path);
+        if (*expr == NULL) {
+            return NULL;
+        }
+        const_exprs = g_slist_prepend(const_exprs, expr);
+    }
+    return pcmk__xpath_search_compiled(xml_top, *expr);
+}
+
+/*!
+ * \internal
+ * \brief Free all expressions compiled by pcmk__xpath_search_const()
+ */
+void
+pcmk__xpath_cleanup(void)
+{
+    GSList *iter = NULL;
+
+    for (iter = const_exprs; iter != NULL; iter = iter->next) {
+        xmlXPathCompExprPtr *expr = iter->data;
+
+        xmlXPathFreeCompExpr(*expr);
+        *expr = NULL;
+    }
+    g_slist_free(const_exprs);
+    const_exprs = NULL;
+}
+
 /* the caller needs to check if the result contains a xmlDocPtr or xmlNodePtr */
 xmlXPathObjectPtr
 xpath_search(xmlNode * xml_top, const char *path)
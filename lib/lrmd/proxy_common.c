@@ -14,6 +14,7 @@
 #include <crm/msg_xml.h>
 #include <crm/services.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
 
 #include <crm/pengine/status.h>
 #include <crm/cib.h>
@@ -120,7 +121,7 @@ remote_proxy_dispatch(const char *buffer, ssize_t length, gpointer userdata)
     uint32_t flags = 0;
     remote_proxy_t *proxy = userdata;
 
-    xml = string2xml(buffer);
+    xml = pcmk__ipc_buffer_xml(proxy->ipc);
     if (xml == NULL) {
         crm_warn("Received a NULL msg from IPC service.");
         return 1;
@@ -16,8 +16,61 @@
 
 crm_graph_functions_t *graph_fns = NULL;
 
+/* Synapse states, as counted in graph statistics */
+#define SYNAPSE_COUNTED_CONFIRMED   0x01
+#define SYNAPSE_COUNTED_FAILED      0x02
+#define SYNAPSE_COUNTED_EXECUTED    0x04
+
+static void
+count_synapse_state(crm_graph_t * graph, int state, int delta)
+{
+    if (state & SYNAPSE_COUNTED_CONFIRMED) {
+        graph->completed += delta;
+    }
+    if (state & SYNAPSE_COUNTED_FAILED) {
+        graph->num_failed += delta;
+
+    } else if ((state & SYNAPSE_COUNTED_EXECUTED)
+               && !(state & SYNAPSE_COUNTED_CONFIRMED)) {
+        graph->pending += delta;
+    }
+    if (state == 0) {
+        graph->num_waiting += delta;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Update graph statistics after a synapse's state may have changed
+ *
+ * \param[in,out] graph    Graph containing \p synapse
+ * \param[in,out] synapse  Synapse to check
+ */
+static void
+update_synapse_stats(crm_graph_t * graph, synapse_t * synapse)
+{
+    int state = (synapse->confirmed? SYNAPSE_COUNTED_CONFIRMED : 0)
+                | (synapse->failed? SYNAPSE_COUNTED_FAILED : 0)
+                | (synapse->executed? SYNAPSE_COUNTED_EXECUTED : 0);
+
+    if (state != synapse->counted) {
+        count_synapse_state(graph, synapse->counted, -1);
+        count_synapse_state(graph, state, 1);
+        synapse->counted = state;
+    }
+}
+
+static gint
+sort_synapse_position(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const synapse_t *synapse_a = a;
+    const synapse_t *synapse_b = b;
+
+    return synapse_a->position - synapse_b->position;
+}
+
 static gboolean
-update_synapse_ready(synapse_t * synapse, int action_id)
+update_synapse_ready(crm_graph_t * graph, synapse_t * synapse, int action_id)
 {
     GListPtr lpc = NULL;
     gboolean updates = FALSE;
@@ -25,21 +78,24 @@ update_synapse_ready(synapse_t * synapse, int action_id)
     CRM_CHECK(synapse->executed == FALSE, return FALSE);
     CRM_CHECK(synapse->confirmed == FALSE, return FALSE);
 
-    synapse->ready = TRUE;
     for (lpc = synapse->inputs; lpc != NULL; lpc = lpc->next) {
         crm_action_t *prereq = (crm_action_t *) lpc->data;
 
-        crm_trace("Processing input %d", prereq->id);
-
         if (prereq->id == action_id) {
             crm_trace("Marking input %d of synapse %d confirmed", action_id, synapse->id);
-            prereq->confirmed = TRUE;
+            if (prereq->confirmed == FALSE) {
+                prereq->confirmed = TRUE;
+                synapse->pending_inputs--;
+            }
             updates = TRUE;
-
-        } else if (prereq->confirmed == FALSE) {
-            synapse->ready = FALSE;
         }
+    }
 
+    if (updates && (synapse->pending_inputs == 0) && (synapse->ready == FALSE)) {
+        crm_trace("Synapse %d is ready", synapse->id);
+        synapse->ready = TRUE;
+        g_sequence_insert_sorted(graph->ready, synapse, sort_synapse_position,
+                                 NULL);
     }
 
     if (updates) {
@@ -93,21 +149,33 @@ update_graph(crm_graph_t * graph, crm_action_t * action)
     gboolean rc = FALSE;
     gboolean updates = FALSE;
     GListPtr lpc = NULL;
+    synapse_t *parent = action->synapse;
 
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
-        synapse_t *synapse = (synapse_t *) lpc->data;
-
-        if (synapse->confirmed || synapse->failed) {
+    /* The action's own synapse may now be confirmed (or may have been marked
+     * failed by the caller)
+     */
+    if (parent != NULL) {
+        if (parent->confirmed || parent->failed) {
             crm_trace("Synapse complete");
 
-        } else if (synapse->executed) {
-            crm_trace("Synapse executed");
-            rc = update_synapse_confirmed(synapse, action->id);
+        } else if (parent->executed) {
+            updates = update_synapse_confirmed(parent, action->id);
+        }
+        update_synapse_stats(graph, parent);
+    }
+
+    // Synapses that have the action as an input may now be ready
+    lpc = g_hash_table_lookup(graph->dependents, GINT_TO_POINTER(action->id));
+    for (; lpc != NULL; lpc = lpc->next) {
+        synapse_t *synapse = (synapse_t *) lpc->data;
+
+        if (synapse->confirmed || synapse->failed || synapse->executed) {
+            crm_trace("Synapse %d already handled", synapse->id);
 
         } else if (action->failed == FALSE || synapse->priority == INFINITY) {
-            rc = update_synapse_ready(synapse, action->id);
+            rc = update_synapse_ready(graph, synapse, action->id);
+            updates = updates || rc;
         }
-        updates = updates || rc;
     }
 
     if (updates) {
@@ -124,23 +192,10 @@ should_fire_synapse(crm_graph_t * graph, synapse_t * synapse)
     CRM_CHECK(synapse->executed == FALSE, return FALSE);
     CRM_CHECK(synapse->confirmed == FALSE, return FALSE);
 
-    crm_trace("Checking pre-reqs for synapse %d", synapse->id);
-    /* lookup prereqs */
-    synapse->ready = TRUE;
-    for (lpc = synapse->inputs; lpc != NULL; lpc = lpc->next) {
-        crm_action_t *prereq = (crm_action_t *) lpc->data;
-
-        crm_trace("Processing input %d", prereq->id);
-        if (prereq->confirmed == FALSE) {
-            crm_trace("Input %d for synapse %d not satisfied: not confirmed", prereq->id, synapse->id);
-            synapse->ready = FALSE;
-            break;
-        } else if(prereq->failed && prereq->can_fail == FALSE) {
-            crm_trace("Input %d for synapse %d not satisfied: failed", prereq->id, synapse->id);
-            synapse->ready = FALSE;
-            break;
-        }
-    }
+    /* Inputs are tracked by update_graph(), so only synapses with all inputs
+     * confirmed get here
+     */
+    CRM_CHECK(synapse->pending_inputs == 0, return FALSE);
 
     for (lpc = synapse->actions; synapse->ready && lpc != NULL; lpc = lpc->next) {
         crm_action_t *a = (crm_action_t *) lpc->data;
@@ -235,9 +290,10 @@ fire_synapse(crm_graph_t * graph, synapse_t * synapse)
 int
 run_graph(crm_graph_t * graph)
 {
-    GListPtr lpc = NULL;
+    GSequenceIter *iter = NULL;
     int stat_log_level = LOG_DEBUG;
     int pass_result = transition_active;
+    int failed_to_fire = 0;
 
     const char *status = "In-progress";
 
@@ -248,40 +304,27 @@ run_graph(crm_graph_t * graph)
         return transition_complete;
     }
 
+    /* The number of completed and in-flight synapses is kept up to date by
+     * update_graph(), so only the synapses that are ready need to be checked
+     */
     graph->fired = 0;
-    graph->pending = 0;
-    graph->skipped = 0;
-    graph->completed = 0;
-    graph->incomplete = 0;
+    graph->skipped = graph->num_failed;
     crm_trace("Entering graph %d callback", graph->id);
 
-    /* Pre-calculate the number of completed and in-flight operations */
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
-        synapse_t *synapse = (synapse_t *) lpc->data;
-
-        if (synapse->confirmed) {
-            crm_trace("Synapse %d complete", synapse->id);
-            graph->completed++;
-
-        } else if (synapse->failed == FALSE && synapse->executed) {
-            crm_trace("Synapse %d: confirmation pending", synapse->id);
-            graph->pending++;
-        }
-    }
-
-    /* Now check if there is work to do */
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
-        synapse_t *synapse = (synapse_t *) lpc->data;
+    iter = g_sequence_get_begin_iter(graph->ready);
+    while (!g_sequence_iter_is_end(iter)) {
+        synapse_t *synapse = g_sequence_get(iter);
+        GSequenceIter *next = NULL;
 
         if (graph->batch_limit > 0 && graph->pending >= graph->batch_limit) {
             crm_debug("Throttling output: batch limit (%d) reached", graph->batch_limit);
             break;
-        } else if (synapse->failed) {
-            graph->skipped++;
-            continue;
 
-        } else if (synapse->confirmed || synapse->executed) {
-            /* Already handled */
+        } else if (synapse->failed || synapse->confirmed || synapse->executed) {
+            // Already handled
+            next = g_sequence_iter_next(iter);
+            g_sequence_remove(iter);
+            iter = next;
             continue;
         }
 
@@ -292,20 +335,27 @@ run_graph(crm_graph_t * graph)
                 crm_err("Synapse %d failed to fire", synapse->id);
                 stat_log_level = LOG_ERR;
                 graph->abort_priority = INFINITY;
-                graph->incomplete++;
+                failed_to_fire++;
                 graph->fired--;
             }
+            update_synapse_stats(graph, synapse);
 
-            if (synapse->confirmed == FALSE) {
-                graph->pending++;
-            }
+            /* Firing may have made later synapses ready (for example, via
+             * pseudo-actions), so find the next one only now
+             */
+            next = g_sequence_iter_next(iter);
+            g_sequence_remove(iter);
+            iter = next;
 
         } else {
             crm_trace("Synapse %d cannot fire", synapse->id);
-            graph->incomplete++;
+            iter = g_sequence_iter_next(iter);
         }
     }
 
+    // Every synapse not yet executed, confirmed or failed could not fire
+    graph->incomplete = graph->num_waiting + failed_to_fire;
+
     if (graph->pending == 0 && graph->fired == 0) {
         graph->complete = TRUE;
         stat_log_level = LOG_NOTICE;
@@ -159,6 +159,88 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
 
 static void destroy_action(crm_action_t * action);
 
+static void
+index_action(crm_graph_t *graph, crm_action_t *action)
+{
+    const char *key = crm_element_value(action->xml, XML_LRM_ATTR_TASK_KEY);
+
+    // Like a search of the graph, the first action with an ID wins
+    if (g_hash_table_lookup(graph->actions, GINT_TO_POINTER(action->id)) == NULL) {
+        g_hash_table_insert(graph->actions, GINT_TO_POINTER(action->id),
+                            action);
+    }
+
+    if (key != NULL) {
+        GListPtr actions = g_hash_table_lookup(graph->actions_by_key, key);
+
+        if (actions == NULL) {
+            g_hash_table_insert(graph->actions_by_key, strdup(key),
+                                g_list_prepend(NULL, action));
+        } else {
+            // The list head is unchanged, so the table entry remains valid
+            actions = g_list_append(actions, action);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Index a newly unpacked graph's actions and synapses
+ *
+ * Index actions by ID and by operation key, so that results can be matched
+ * to actions without searching the graph. Also record, for each action, which
+ * synapses have it as an input, and count each synapse's inputs, so that
+ * update_graph() can find the synapses made ready by a confirmed action.
+ * Synapses without inputs are ready from the start.
+ *
+ * \param[in,out] graph  Graph to index
+ */
+static void
+index_graph(crm_graph_t *graph)
+{
+    int position = 0;
+    GListPtr sIter = NULL;
+    GListPtr iIter = NULL;
+
+    graph->actions = g_hash_table_new(g_direct_hash, g_direct_equal);
+    graph->actions_by_key = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                  free,
+                                                  (GDestroyNotify) g_list_free);
+    graph->dependents = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify) g_list_free);
+    graph->ready = g_sequence_new(NULL);
+
+    for (sIter = graph->synapses; sIter != NULL; sIter = sIter->next) {
+        synapse_t *synapse = (synapse_t *) sIter->data;
+
+        synapse->position = position++;
+        for (iIter = synapse->actions; iIter != NULL; iIter = iIter->next) {
+            index_action(graph, (crm_action_t *) iIter->data);
+        }
+        for (iIter = synapse->inputs; iIter != NULL; iIter = iIter->next) {
+            crm_action_t *input = (crm_action_t *) iIter->data;
+            gpointer key = GINT_TO_POINTER(input->id);
+            GListPtr dependents = g_hash_table_lookup(graph->dependents, key);
+
+            synapse->pending_inputs++;
+
+            // A synapse may list the same input more than once
+            if ((dependents == NULL) || (dependents->data != synapse)) {
+                g_hash_table_steal(graph->dependents, key);
+                g_hash_table_insert(graph->dependents, key,
+                                    g_list_prepend(dependents, synapse));
+            }
+        }
+
+        if (synapse->pending_inputs == 0) {
+            synapse->ready = TRUE;
+            g_sequence_append(graph->ready, synapse);
+        }
+        graph->num_waiting++;
+    }
+}
+
 crm_graph_t *
 unpack_graph(xmlNode * xml_graph, const char *reference)
 {
@@ -222,10 +304,12 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
             synapse_t *new_synapse = unpack_synapse(new_graph, synapse);
 
             if (new_synapse != NULL) {
-                new_graph->synapses = g_list_append(new_graph->synapses, new_synapse);
+                new_graph->synapses = g_list_prepend(new_graph->synapses, new_synapse);
             }
         }
     }
+    new_graph->synapses = g_list_reverse(new_graph->synapses);
+    index_graph(new_graph);
 
     crm_debug("Unpacked transition %d: %d actions in %d synapses",
               new_graph->id, new_graph->num_actions, new_graph->num_synapses);
@@ -251,14 +335,14 @@ destroy_action(crm_action_t * action)
 static void
 destroy_synapse(synapse_t * synapse)
 {
-    while (g_list_length(synapse->actions) > 0) {
+    while (synapse->actions != NULL) {
         crm_action_t *action = g_list_nth_data(synapse->actions, 0);
 
         synapse->actions = g_list_remove(synapse->actions, action);
         destroy_action(action);
     }
 
-    while (g_list_length(synapse->inputs) > 0) {
+    while (synapse->inputs != NULL) {
         crm_action_t *action = g_list_nth_data(synapse->inputs, 0);
 
         synapse->inputs = g_list_remove(synapse->inputs, action);
@@ -273,13 +357,25 @@ destroy_graph(crm_graph_t * graph)
     if (graph == NULL) {
         return;
     }
-    while (g_list_length(graph->synapses) > 0) {
+    while (graph->synapses != NULL) {
         synapse_t *synapse = g_list_nth_data(graph->synapses, 0);
 
         graph->synapses = g_list_remove(graph->synapses, synapse);
         destroy_synapse(synapse);
     }
 
+    if (graph->actions != NULL) {
+        g_hash_table_destroy(graph->actions);
+    }
+    if (graph->actions_by_key != NULL) {
+        g_hash_table_destroy(graph->actions_by_key);
+    }
+    if (graph->dependents != NULL) {
+        g_hash_table_destroy(graph->dependents);
+    }
+    if (graph->ready != NULL) {
+        g_sequence_free(graph->ready);
+    }
     free(graph->source);
     free(graph);
 }
@@ -105,28 +105,40 @@ actiontype2text(action_type_e type)
     return "<unknown>";
 }
 
-static crm_action_t *
-find_action(crm_graph_t * graph, int id)
+/*!
+ * \internal
+ * \brief Find an action in a transition graph by ID
+ *
+ * \param[in] graph  Graph to search
+ * \param[in] id     ID of action to find
+ *
+ * \return Action with \p id if found, otherwise NULL
+ */
+crm_action_t *
+pcmk__graph_action(crm_graph_t *graph, int id)
 {
-    GListPtr sIter = NULL;
-
-    if (graph == NULL) {
+    if ((graph == NULL) || (graph->actions == NULL)) {
         return NULL;
     }
+    return g_hash_table_lookup(graph->actions, GINT_TO_POINTER(id));
+}
 
-    for (sIter = graph->synapses; sIter != NULL; sIter = sIter->next) {
-        GListPtr aIter = NULL;
-        synapse_t *synapse = (synapse_t *) sIter->data;
-
-        for (aIter = synapse->actions; aIter != NULL; aIter = aIter->next) {
-            crm_action_t *action = (crm_action_t *) aIter->data;
-
-            if (action->id == id) {
-                return action;
-            }
-        }
+/*!
+ * \internal
+ * \brief Find all actions in a transition graph with an operation key
+ *
+ * \param[in] graph  Graph to search
+ * \param[in] key    Operation key to find
+ *
+ * \return List of actions with \p key (owned by \p graph), or NULL if none
+ */
+GList *
+pcmk__graph_actions_by_key(crm_graph_t *graph, const char *key)
+{
+    if ((graph == NULL) || (graph->actions_by_key == NULL) || (key == NULL)) {
+        return NULL;
     }
-    return NULL;
+    return g_hash_table_lookup(graph->actions_by_key, key);
 }
 
 static void
@@ -160,7 +172,7 @@ print_synapse(unsigned int log_level, crm_graph_t * graph, synapse_t * synapse)
             } else if (input->confirmed) {
                 /* Confirmed, skip */
 
-            } else if (find_action(graph, input->id)) {
+            } else if (pcmk__graph_action(graph, input->id)) {
                 /* In-flight or pending */
                 pending = add_list_element(pending, id_string);
             }
@@ -187,7 +199,7 @@ print_synapse(unsigned int log_level, crm_graph_t * graph, synapse_t * synapse)
             const char *key = crm_element_value(input->xml, XML_LRM_ATTR_TASK_KEY);
             const char *host = crm_element_value(input->xml, XML_LRM_ATTR_TARGET);
 
-            if (find_action(graph, input->id) == NULL) {
+            if (pcmk__graph_action(graph, input->id) == NULL) {
                 if (host == NULL) {
                     do_crm_log(log_level, " * [Input %2d]: Unresolved dependency %s op %s",
                                input->id, actiontype2text(input->type), key);
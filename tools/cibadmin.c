@@ -54,6 +54,10 @@ static struct crm_option long_options[] = {
     {"-spacer-",    0, 0, '-', "\n\tThe tagname and all attributes must match in order for the element to be deleted\n"},
     {"delete-all",  0, 0, 'd', "When used with --xpath, remove all matching objects in the configuration instead of just the first one"},
     {"empty",       0, 0, 'a', "\tOutput an empty CIB"},
+    {"transaction", 0, 0, 'T', "Apply several changes atomically, supplied as a <transaction> whose children are"},
+    {"-spacer-",    0, 0, '-', "\t<create>, <modify>, <replace> or <delete> steps (each with optional scope, xpath,\n\tallow-create and delete-all attributes, and the step's XML as its child)"},
+    {"stats",       0, 0, 'S', "\tShow request counts and latencies by operation and by client name,\n"
+     "\t\t\t\tand event queue statistics of connected clients"},
     {"md5-sum",	    0, 0, '5', "\tCalculate the on-disk CIB digest"},
     {"md5-sum-versioned",  0, 0, '6', "Calculate an on-the-wire versioned CIB digest"},
     {"blank",       0, 0, '-', NULL, 1},
@@ -107,6 +111,11 @@ static struct crm_option long_options[] = {
     {"-spacer-",    0, 0, '-', "Replace the constraints section of the configuration with the contents of $HOME/constraints.xml:", pcmk_option_paragraph},
     {"-spacer-",    0, 0, '-', " cibadmin --replace --scope constraints --xml-file $HOME/constraints.xml", pcmk_option_example},
 
+    {"-spacer-",    0, 0, '-', "Show where the local CIB manager spends its time:", pcmk_option_paragraph},
+    {"-spacer-",    0, 0, '-', " cibadmin --stats", pcmk_option_example},
+    {"-spacer-",    0, 0, '-', "Move a constraint and its resource's defaults in a single update:", pcmk_option_paragraph},
+    {"-spacer-",    0, 0, '-', " cibadmin --transaction --xml-text '<transaction><delete scope=\"constraints\"><rsc_location id=\"loc1\"/></delete><create scope=\"constraints\"><rsc_location id=\"loc2\" rsc=\"rsc1\" node=\"node2\" score=\"100\"/></create></transaction>'", pcmk_option_example},
+
     {"-spacer-",    0, 0, '-', "Increase the configuration version to prevent old configurations from being loaded accidentally:", pcmk_option_paragraph},
     {"-spacer-",    0, 0, '-', " cibadmin --modify --xml-text '<cib admin_epoch=\"admin_epoch++\"/>'", pcmk_option_example},
 
@@ -244,6 +253,12 @@ main(int argc, char **argv)
             case 'D':
                 cib_action = CIB_OP_DELETE;
                 break;
+            case 'T':
+                cib_action = CIB_OP_MULTI;
+                break;
+            case 'S':
+                cib_action = CIB_OP_STATS;
+                break;
             case '5':
                 cib_action = "md5-sum";
                 break;
@@ -478,11 +493,90 @@ main(int argc, char **argv)
     crm_exit(exit_code);
 }
 
+/*!
+ * \internal
+ * \brief Convert command-line transaction XML to a CIB transaction
+ *
+ * \param[in] input  User-supplied <transaction> element
+ *
+ * \return Newly allocated transaction, or NULL if \p input is not valid
+ */
+static xmlNode *
+build_transaction(xmlNode *input)
+{
+    xmlNode *step = NULL;
+    xmlNode *transaction = NULL;
+
+    if (safe_str_eq(crm_element_name(input), F_CIB_TRANSACTION)) {
+        return copy_xml(input);
+
+    } else if (safe_str_neq(crm_element_name(input), "transaction")) {
+        fprintf(stderr, "Transaction input must be a <transaction> element\n");
+        return NULL;
+    }
+
+    transaction = cib_transaction_new();
+    for (step = __xml_first_child_element(input); step != NULL;
+         step = __xml_next_element(step)) {
+
+        int options = 0;
+        const char *op = NULL;
+        const char *name = crm_element_name(step);
+        const char *section = crm_element_value(step, "xpath");
+
+        if (safe_str_eq(name, "create")) {
+            op = CIB_OP_CREATE;
+        } else if (safe_str_eq(name, "modify")) {
+            op = CIB_OP_MODIFY;
+        } else if (safe_str_eq(name, "replace")) {
+            op = CIB_OP_REPLACE;
+        } else if (safe_str_eq(name, "delete")) {
+            op = CIB_OP_DELETE;
+        } else {
+            fprintf(stderr, "Unknown transaction step <%s>\n", name);
+            free_xml(transaction);
+            return NULL;
+        }
+
+        if (section != NULL) {
+            options |= cib_xpath;
+        } else {
+            section = crm_element_value(step, "scope");
+        }
+        if (crm_is_true(crm_element_value(step, "allow-create"))) {
+            options |= cib_can_create;
+        }
+        if (crm_is_true(crm_element_value(step, "delete-all"))) {
+            options |= cib_multiple;
+        }
+        cib_transaction_add(transaction, op, section,
+                            __xml_first_child_element(step), options);
+    }
+    return transaction;
+}
+
 int
 do_work(xmlNode * input, int call_options, xmlNode ** output)
 {
     /* construct the request */
     the_cib->call_timeout = message_timeout_ms;
+    if (safe_str_eq(cib_action, CIB_OP_MULTI)) {
+        int rc = -EINVAL;
+        xmlNode *transaction = NULL;
+
+        if (input == NULL) {
+            fprintf(stderr, "Please supply the transaction with -X, -x or -p\n");
+            return -EINVAL;
+        }
+        transaction = build_transaction(input);
+        if (transaction != NULL) {
+            rc = cib_transaction_commit(the_cib, transaction, host,
+                                        call_options, cib_user);
+            free_xml(transaction);
+        }
+        return rc;
+    }
+
     if (strcasecmp(CIB_OP_REPLACE, cib_action) == 0
         && safe_str_eq(crm_element_name(input), XML_TAG_CIB)) {
         xmlNode *status = get_object_root(XML_CIB_TAG_STATUS, input);
@@ -37,6 +37,7 @@
 #include <crm/common/output.h>
 #include <crm/common/util.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 
 #include <crm/cib/internal.h>
 #include <crm/pengine/status.h>
@@ -1447,129 +1448,28 @@ mon_trigger_refresh(gpointer user_data)
     return FALSE;
 }
 
-#define NODE_PATT "/lrm[@id="
-static char *
-get_node_from_xpath(const char *xpath)
+static void
+handle_rsc_op_cb(xmlNode *rsc_op, const char *node_id, const char *rsc_id,
+                 void *user_data)
 {
-    char *nodeid = NULL;
-    char *tmp = strstr(xpath, NODE_PATT);
-
-    if(tmp) {
-        tmp += strlen(NODE_PATT);
-        tmp += 1;
+    handle_rsc_op(rsc_op, node_id);
+}
 
-        nodeid = strdup(tmp);
-        tmp = strstr(nodeid, "\'");
-        CRM_ASSERT(tmp);
-        tmp[0] = 0;
-    }
-    return nodeid;
+static int
+handle_change(const pcmk__patch_change_t *change, void *user_data)
+{
+    crm_trace("Handling %s operation for %s %p", change->op, change->path,
+              change->result);
+    pcmk__patch_change_rsc_ops(change, handle_rsc_op_cb, NULL);
+    return 0;
 }
 
 static void
 crm_diff_update_v2(const char *event, xmlNode * msg)
 {
-    xmlNode *change = NULL;
     xmlNode *diff = get_message_xml(msg, F_CIB_UPDATE_RESULT);
 
-    for (change = __xml_first_child(diff); change != NULL; change = __xml_next(change)) {
-        const char *name = NULL;
-        const char *op = crm_element_value(change, XML_DIFF_OP);
-        const char *xpath = crm_element_value(change, XML_DIFF_PATH);
-        xmlNode *match = NULL;
-        const char *node = NULL;
-
-        if(op == NULL) {
-            continue;
-
-        } else if(strcmp(op, "create") == 0) {
-            match = change->children;
-
-        } else if(strcmp(op, "move") == 0) {
-            continue;
-
-        } else if(strcmp(op, "delete") == 0) {
-            continue;
-
-        } else if(strcmp(op, "modify") == 0) {
-            match = first_named_child(change, XML_DIFF_RESULT);
-            if(match) {
-                match = match->children;
-            }
-        }
-
-        if(match) {
-            name = (const char *)match->name;
-        }
-
-        crm_trace("Handling %s operation for %s %p, %s", op, xpath, match, name);
-        if(xpath == NULL) {
-            /* Version field, ignore */
-
-        } else if(name == NULL) {
-            crm_debug("No result for %s operation to %s", op, xpath);
-            CRM_ASSERT(strcmp(op, "delete") == 0 || strcmp(op, "move") == 0);
-
-        } else if(strcmp(name, XML_TAG_CIB) == 0) {
-            xmlNode *state = NULL;
-            xmlNode *status = first_named_child(match, XML_CIB_TAG_STATUS);
-
-            for (state = __xml_first_child_element(status); state != NULL;
-                 state = __xml_next_element(state)) {
-
-                node = crm_element_value(state, XML_ATTR_UNAME);
-                if (node == NULL) {
-                    node = ID(state);
-                }
-                handle_rsc_op(state, node);
-            }
-
-        } else if(strcmp(name, XML_CIB_TAG_STATUS) == 0) {
-            xmlNode *state = NULL;
-
-            for (state = __xml_first_child_element(match); state != NULL;
-                 state = __xml_next_element(state)) {
-
-                node = crm_element_value(state, XML_ATTR_UNAME);
-                if (node == NULL) {
-                    node = ID(state);
-                }
-                handle_rsc_op(state, node);
-            }
-
-        } else if(strcmp(name, XML_CIB_TAG_STATE) == 0) {
-            node = crm_element_value(match, XML_ATTR_UNAME);
-            if (node == NULL) {
-                node = ID(match);
-            }
-            handle_rsc_op(match, node);
-
-        } else if(strcmp(name, XML_CIB_TAG_LRM) == 0) {
-            node = ID(match);
-            handle_rsc_op(match, node);
-
-        } else if(strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
-
-            handle_rsc_op(match, local_node);
-            free(local_node);
-
-        } else if(strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
-
-            handle_rsc_op(match, local_node);
-            free(local_node);
-
-        } else if(strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
-
-            handle_rsc_op(match, local_node);
-            free(local_node);
-
-        } else {
-            crm_trace("Ignoring %s operation for %s %p, %s", op, xpath, match, name);
-        }
-    }
+    pcmk__patchset_foreach(diff, handle_change, NULL);
 }
 
 static void